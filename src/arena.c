@@ -0,0 +1,108 @@
+#include "arena.h"
+#include <string.h>
+
+#define STRING_POOL_CHUNK_SIZE (16 * 1024)
+
+FRSlab* fr_slab_new(gsize element_size, guint block_length) {
+    FRSlab *slab = g_malloc0(sizeof(FRSlab));
+    slab->element_size = element_size;
+    slab->block_length = MAX(block_length, 1);
+    slab->blocks = g_ptr_array_new_with_free_func(g_free);
+    slab->free_slots = g_array_new(FALSE, FALSE, sizeof(guint));
+    return slab;
+}
+
+void fr_slab_free(FRSlab *slab) {
+    if (!slab) return;
+    
+    g_ptr_array_unref(slab->blocks);
+    g_array_unref(slab->free_slots);
+    g_free(slab);
+}
+
+// Keeps the first block so a cleared slab doesn't immediately reallocate
+void fr_slab_clear(FRSlab *slab) {
+    if (!slab) return;
+    
+    if (slab->blocks->len > 1) {
+        g_ptr_array_set_size(slab->blocks, 1);
+    }
+    if (slab->blocks->len == 1) {
+        memset(g_ptr_array_index(slab->blocks, 0), 0, slab->element_size * slab->block_length);
+    }
+    g_array_set_size(slab->free_slots, 0);
+    slab->length = 0;
+}
+
+gpointer fr_slab_alloc(FRSlab *slab, guint *slot) {
+    if (!slab) return NULL;
+    
+    guint index;
+    if (slab->free_slots->len > 0) {
+        index = g_array_index(slab->free_slots, guint, slab->free_slots->len - 1);
+        g_array_set_size(slab->free_slots, slab->free_slots->len - 1);
+    } else {
+        index = slab->length++;
+        if (index / slab->block_length >= slab->blocks->len) {
+            g_ptr_array_add(slab->blocks, g_malloc0(slab->element_size * slab->block_length));
+        }
+    }
+    
+    if (slot) {
+        *slot = index;
+    }
+    return fr_slab_get(slab, index);
+}
+
+void fr_slab_release(FRSlab *slab, guint slot) {
+    if (!slab || slot >= slab->length) return;
+    
+    memset(fr_slab_get(slab, slot), 0, slab->element_size);
+    g_array_append_val(slab->free_slots, slot);
+}
+
+FRStringPool* fr_string_pool_new(void) {
+    FRStringPool *pool = g_malloc0(sizeof(FRStringPool));
+    pool->chunk = g_string_chunk_new(STRING_POOL_CHUNK_SIZE);
+    pool->interned = g_hash_table_new(g_str_hash, g_str_equal);
+    return pool;
+}
+
+void fr_string_pool_free(FRStringPool *pool) {
+    if (!pool) return;
+    
+    g_hash_table_destroy(pool->interned);
+    g_string_chunk_free(pool->chunk);
+    g_free(pool);
+}
+
+void fr_string_pool_clear(FRStringPool *pool) {
+    if (!pool) return;
+    
+    g_hash_table_remove_all(pool->interned);
+    g_string_chunk_clear(pool->chunk);
+    pool->size = 0;
+}
+
+const char* fr_string_pool_intern(FRStringPool *pool, const char *string) {
+    if (!pool || !string) return NULL;
+    
+    const char *interned = g_hash_table_lookup(pool->interned, string);
+    if (!interned) {
+        interned = fr_string_pool_insert(pool, string);
+        g_hash_table_add(pool->interned, (gpointer)interned);
+    }
+    return interned;
+}
+
+const char* fr_string_pool_lookup(FRStringPool *pool, const char *string) {
+    if (!pool || !string) return NULL;
+    return g_hash_table_lookup(pool->interned, string);
+}
+
+const char* fr_string_pool_insert(FRStringPool *pool, const char *string) {
+    if (!pool || !string) return NULL;
+    
+    pool->size += strlen(string) + 1;
+    return g_string_chunk_insert(pool->chunk, string);
+}
@@ -0,0 +1,54 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <glib.h>
+
+// Fixed-size records carved out of large blocks. A record is addressed by its
+// slot number and never moves, so pointers to it stay valid until it is
+// released. Released slots are reused before the slab grows.
+typedef struct {
+    gsize element_size;
+    guint block_length;     // records per block
+    GPtrArray *blocks;
+    GArray *free_slots;     // guint, reused last released first
+    guint length;           // slots ever handed out; live ones are below this
+} FRSlab;
+
+FRSlab* fr_slab_new(gsize element_size, guint block_length);
+void fr_slab_free(FRSlab *slab);
+void fr_slab_clear(FRSlab *slab);
+
+// Returns a zeroed record and stores its slot in *slot
+gpointer fr_slab_alloc(FRSlab *slab, guint *slot);
+void fr_slab_release(FRSlab *slab, guint slot);
+
+static inline gpointer fr_slab_get(FRSlab *slab, guint slot) {
+    return (char*)g_ptr_array_index(slab->blocks, slot / slab->block_length) +
+           (gsize)(slot % slab->block_length) * slab->element_size;
+}
+
+// Append-only string storage. Strings are packed into large chunks and are
+// never freed individually; callers that drop strings over time rebuild the
+// pool from the strings still in use. Interned strings are shared, so equal
+// strings can be compared by pointer.
+typedef struct {
+    GStringChunk *chunk;
+    GHashTable *interned;   // string -> itself, for fr_string_pool_intern
+    gsize size;             // bytes stored, terminators included
+} FRStringPool;
+
+FRStringPool* fr_string_pool_new(void);
+void fr_string_pool_free(FRStringPool *pool);
+void fr_string_pool_clear(FRStringPool *pool);
+
+// Returns the pool's copy of string, shared with earlier equal strings
+const char* fr_string_pool_intern(FRStringPool *pool, const char *string);
+
+// The pool's interned copy of string, or NULL if it was never interned. Lets
+// callers compare against interned fields by pointer.
+const char* fr_string_pool_lookup(FRStringPool *pool, const char *string);
+
+// Stores a private copy; for strings that are unlikely to repeat
+const char* fr_string_pool_insert(FRStringPool *pool, const char *string);
+
+#endif // ARENA_H
@@ -5,9 +5,84 @@
 #include <time.h>
 #include <json-glib/json-glib.h>
 
-FRBookmarkManager* fr_bookmark_manager_new(void) {
+#define BOOKMARK_SLAB_BLOCK_LENGTH 128
+#define BOOKMARK_IMPORT_CHUNK 256
+
+typedef struct {
+    guint id;
+    FRBookmarksChangedFunc func;
+    gpointer user_data;
+} FRBookmarkObserver;
+
+typedef enum {
+    BOOKMARK_UNDO_INSERT,
+    BOOKMARK_UNDO_REMOVE,
+    BOOKMARK_UNDO_MOVE,
+    BOOKMARK_UNDO_EDIT,
+    BOOKMARK_UNDO_FOLDER_CREATE,
+    BOOKMARK_UNDO_FOLDER_RENAME,
+    BOOKMARK_UNDO_FOLDER_MOVE
+} FRBookmarkUndoType;
+
+// One change made inside a batch, with what it takes to reverse it. Undo runs
+// newest first, so every neighbour recorded here is back in place by then.
+typedef struct {
+    FRBookmarkUndoType type;
+    FRBookmark *bookmark;
+    FRBookmarkFolder *folder;   // the changed folder, or a bookmark's old parent
+    FRBookmarkFolder *parent;   // a moved folder's old parent
+    GList *prev;                // old neighbour in manager->bookmarks
+    GList *prev_sibling;        // old neighbour in the parent's queue
+    char *title;                // old pooled title or folder name
+    char *url;                  // old pooled url
+} FRBookmarkUndo;
+
+typedef struct {
+    FRBookmarkCommitFunc done;
+    gpointer user_data;
+} FRBookmarkWaiter;
+
+// A committed batch on the storage thread. The first mark entries of the undo
+// log are what it covers; they are dropped once it is on disk.
+typedef struct {
+    FRBookmarkManager *manager;     // NULL once the manager is gone
+    guint mark;
+    GArray *waiters;                // FRBookmarkWaiter
+} FRBookmarkWrite;
+
+static void bookmark_import_cancel(gpointer load);
+static void bookmark_report(FRBookmarkManager *manager, GArray *waiters, gboolean success);
+
+static void bookmark_folder_free(FRBookmarkFolder *folder) {
+    GList *l = folder->folders.head;
+    while (l != NULL) {
+        GList *next = l->next;
+        bookmark_folder_free((FRBookmarkFolder*)l->data);
+        l = next;
+    }
+    g_free(folder);
+}
+
+FRBookmarkManager* fr_bookmark_manager_new(FRStorage *storage) {
     FRBookmarkManager *manager = g_malloc0(sizeof(FRBookmarkManager));
-    manager->bookmarks = NULL;
+    g_queue_init(&manager->bookmarks);
+    manager->bookmark_slab = fr_slab_new(sizeof(FRBookmark), BOOKMARK_SLAB_BLOCK_LENGTH);
+    manager->strings = fr_string_pool_new();
+    manager->storage = storage;
+    manager->observers = g_array_new(FALSE, FALSE, sizeof(FRBookmarkObserver));
+    manager->next_observer_id = 1;
+    manager->undo_log = g_array_new(FALSE, FALSE, sizeof(FRBookmarkUndo));
+    manager->batch_waiters = g_array_new(FALSE, FALSE, sizeof(FRBookmarkWaiter));
+    manager->writes = g_ptr_array_new();
+    manager->imports = g_ptr_array_new();
+    
+    // Keys are pooled strings owned by the bookmarks and folders themselves
+    manager->url_index = g_hash_table_new(g_str_hash, g_str_equal);
+    manager->folder_index = g_hash_table_new(g_str_hash, g_str_equal);
+    manager->root = g_malloc0(sizeof(FRBookmarkFolder));
+    manager->root->name = (char*)fr_string_pool_intern(manager->strings, "");
+    manager->root->path = manager->root->name;
+    g_hash_table_insert(manager->folder_index, manager->root->path, manager->root);
     
     char *config_dir = fr_browser_get_config_dir();
     fr_browser_ensure_directory(config_dir);
@@ -20,7 +95,28 @@ FRBookmarkManager* fr_bookmark_manager_new(void) {
 void fr_bookmark_manager_free(FRBookmarkManager *manager) {
     if (!manager) return;
     
-    g_list_free_full(manager->bookmarks, (GDestroyNotify)fr_bookmark_free);
+    while (manager->imports->len > 0) {
+        bookmark_import_cancel(g_ptr_array_index(manager->imports, manager->imports->len - 1));
+    }
+    
+    // An unfinished batch is dropped along with its changes. Writes still on
+    // the storage thread outlive us, but nobody can wait on them any more.
+    bookmark_report(manager, manager->batch_waiters, FALSE);
+    for (guint i = 0; i < manager->writes->len; i++) {
+        FRBookmarkWrite *write = g_ptr_array_index(manager->writes, i);
+        write->manager = NULL;
+        bookmark_report(manager, write->waiters, FALSE);
+        write->waiters = NULL;
+    }
+    g_ptr_array_unref(manager->writes);
+    g_ptr_array_unref(manager->imports);
+    g_array_unref(manager->undo_log);
+    g_array_unref(manager->observers);
+    g_hash_table_destroy(manager->url_index);
+    g_hash_table_destroy(manager->folder_index);
+    bookmark_folder_free(manager->root);
+    fr_slab_free(manager->bookmark_slab);
+    fr_string_pool_free(manager->strings);
     g_free(manager->bookmarks_file);
     g_free(manager);
 }
@@ -44,60 +140,475 @@ void fr_bookmark_free(FRBookmark *bookmark) {
     g_free(bookmark);
 }
 
+// Changes are kept for undo inside a batch and until a pending commit is on
+// disk, since a failed write takes back everything after the last good one
+static gboolean bookmark_logging(FRBookmarkManager *manager) {
+    return manager->batch_depth > 0 || manager->writes->len > 0;
+}
+
+static void bookmark_log(FRBookmarkManager *manager, FRBookmarkUndo *undo) {
+    if (bookmark_logging(manager)) {
+        g_array_append_vals(manager->undo_log, undo, 1);
+    }
+}
+
+static void bookmark_notify(FRBookmarkManager *manager) {
+    for (guint i = 0; i < manager->observers->len; i++) {
+        FRBookmarkObserver *observer = &g_array_index(manager->observers, FRBookmarkObserver, i);
+        observer->func(manager, observer->user_data);
+    }
+}
+
+// Ends every public mutation; inside a batch the commit does this instead
+static gboolean bookmark_changed(FRBookmarkManager *manager) {
+    if (manager->batch_depth > 0) return TRUE;
+    
+    bookmark_notify(manager);
+    return fr_bookmark_manager_save(manager);
+}
+
+// Canonical form of a folder path: no empty, leading or trailing components.
+// Bookmarks without a folder go to "Default" as they always have.
+static char* bookmark_normalize_path(const char *path) {
+    GString *normalized = g_string_new(NULL);
+    char **parts = g_strsplit(path ? path : "", "/", -1);
+    
+    for (char **part = parts; *part != NULL; part++) {
+        char *name = g_strstrip(*part);
+        if (*name == '\0') continue;
+        
+        if (normalized->len > 0) {
+            g_string_append_c(normalized, '/');
+        }
+        g_string_append(normalized, name);
+    }
+    g_strfreev(parts);
+    
+    if (normalized->len == 0) {
+        g_string_assign(normalized, "Default");
+    }
+    return g_string_free(normalized, FALSE);
+}
+
+static char* bookmark_folder_build_path(FRBookmarkFolder *parent, const char *name) {
+    if (parent->parent == NULL) return g_strdup(name);
+    return g_strconcat(parent->path, "/", name, NULL);
+}
+
+// Marks a folder's own listing as changed, for views that mirror it
+static void bookmark_folder_touch(FRBookmarkManager *manager, FRBookmarkFolder *folder) {
+    folder->serial = ++manager->serial;
+}
+
+static FRBookmarkFolder* bookmark_folder_new(FRBookmarkManager *manager, FRBookmarkFolder *parent,
+                                             const char *name, const char *path) {
+    FRBookmarkFolder *folder = g_malloc0(sizeof(FRBookmarkFolder));
+    folder->name = (char*)fr_string_pool_intern(manager->strings, name);
+    folder->path = (char*)fr_string_pool_intern(manager->strings, path);
+    folder->parent = parent;
+    folder->link.data = folder;
+    g_queue_push_tail_link(&parent->folders, &folder->link);
+    g_hash_table_insert(manager->folder_index, folder->path, folder);
+    bookmark_folder_touch(manager, parent);
+    
+    FRBookmarkUndo undo = { .type = BOOKMARK_UNDO_FOLDER_CREATE, .folder = folder };
+    bookmark_log(manager, &undo);
+    
+    return folder;
+}
+
+// Looks up a folder, creating it and any missing ancestors. The root's path
+// is empty too, so an empty path has to be normalized before any lookup.
+static FRBookmarkFolder* bookmark_ensure_folder(FRBookmarkManager *manager, const char *path) {
+    FRBookmarkFolder *folder = *path ? g_hash_table_lookup(manager->folder_index, path) : NULL;
+    if (folder) return folder;
+    
+    char *normalized = bookmark_normalize_path(path);
+    folder = g_hash_table_lookup(manager->folder_index, normalized);
+    if (folder) {
+        g_free(normalized);
+        return folder;
+    }
+    
+    // Walk down from the root, one prefix of the path per level
+    folder = manager->root;
+    for (char *end = normalized; ; end++) {
+        if (*end != '/' && *end != '\0') continue;
+        
+        char saved = *end;
+        *end = '\0';
+        FRBookmarkFolder *child = g_hash_table_lookup(manager->folder_index, normalized);
+        if (!child) {
+            const char *name = strrchr(normalized, '/');
+            child = bookmark_folder_new(manager, folder, name ? name + 1 : normalized, normalized);
+        }
+        folder = child;
+        *end = saved;
+        
+        if (saved == '\0') break;
+    }
+    
+    g_free(normalized);
+    return folder;
+}
+
+// Links a bookmark into folder after prev, or first when prev is NULL
+static void bookmark_attach_after(FRBookmarkManager *manager, FRBookmark *bookmark,
+                                  FRBookmarkFolder *folder, GList *prev) {
+    bookmark_folder_touch(manager, folder);
+    bookmark->parent = folder;
+    bookmark->folder = folder->path;
+    bookmark->sibling.data = bookmark;
+    g_queue_insert_after_link(&folder->bookmarks, prev, &bookmark->sibling);
+}
+
+static void bookmark_attach(FRBookmarkManager *manager, FRBookmark *bookmark,
+                            FRBookmarkFolder *folder) {
+    bookmark_attach_after(manager, bookmark, folder, folder->bookmarks.tail);
+}
+
+static void bookmark_detach(FRBookmarkManager *manager, FRBookmark *bookmark) {
+    bookmark_folder_touch(manager, bookmark->parent);
+    g_queue_unlink(&bookmark->parent->bookmarks, &bookmark->sibling);
+    bookmark->parent = NULL;
+}
+
+// Creates a bookmark in the manager's slab and appends it to the list
+static FRBookmark* bookmark_insert(FRBookmarkManager *manager, const char *title,
+                                   const char *url, const char *folder, time_t created) {
+    guint slot;
+    FRBookmark *bookmark = fr_slab_alloc(manager->bookmark_slab, &slot);
+    bookmark->id = slot + 1;
+    bookmark->title = (char*)fr_string_pool_intern(manager->strings, title ? title : "Untitled");
+    bookmark->url = (char*)fr_string_pool_insert(manager->strings, url);
+    bookmark->created = created;
+    bookmark->link.data = bookmark;
+    g_queue_push_tail_link(&manager->bookmarks, &bookmark->link);
+    g_hash_table_insert(manager->url_index, bookmark->url, bookmark);
+    bookmark_attach(manager, bookmark, bookmark_ensure_folder(manager, folder ? folder : "Default"));
+    
+    FRBookmarkUndo undo = { .type = BOOKMARK_UNDO_INSERT, .bookmark = bookmark };
+    bookmark_log(manager, &undo);
+    
+    return bookmark;
+}
+
 gboolean fr_bookmark_manager_add(FRBookmarkManager *manager, FRBookmark *bookmark) {
     if (!manager || !bookmark) return FALSE;
     
     // Check if bookmark already exists
-    if (fr_bookmark_manager_find(manager, bookmark->url)) {
+    if (!bookmark->url || fr_bookmark_manager_find(manager, bookmark->url)) {
+        fr_bookmark_free(bookmark);
         return FALSE; // Already exists
     }
     
-    manager->bookmarks = g_list_append(manager->bookmarks, bookmark);
-    return fr_bookmark_manager_save(manager);
+    bookmark_insert(manager, bookmark->title, bookmark->url, bookmark->folder, bookmark->created);
+    fr_bookmark_free(bookmark);
+    return bookmark_changed(manager);
+}
+
+FRBookmark* fr_bookmark_manager_insert(FRBookmarkManager *manager, const char *title,
+                                       const char *url, const char *folder, time_t created) {
+    if (!manager || !url || !*url) return NULL;
+    if (fr_bookmark_manager_find(manager, url)) return NULL;
+    
+    FRBookmark *bookmark = bookmark_insert(manager, title, url, folder, created);
+    bookmark_changed(manager);
+    return bookmark;
 }
 
 gboolean fr_bookmark_manager_remove(FRBookmarkManager *manager, const char *url) {
     if (!manager || !url) return FALSE;
     
     FRBookmark *bookmark = fr_bookmark_manager_find(manager, url);
-    if (bookmark) {
-        manager->bookmarks = g_list_remove(manager->bookmarks, bookmark);
-        fr_bookmark_free(bookmark);
-        return fr_bookmark_manager_save(manager);
+    if (!bookmark) return FALSE;
+    
+    FRBookmarkUndo undo = { .type = BOOKMARK_UNDO_REMOVE, .bookmark = bookmark,
+                            .folder = bookmark->parent, .prev = bookmark->link.prev,
+                            .prev_sibling = bookmark->sibling.prev };
+    
+    g_hash_table_remove(manager->url_index, bookmark->url);
+    g_queue_unlink(&manager->bookmarks, &bookmark->link);
+    bookmark_detach(manager, bookmark);
+    
+    // Its strings stay in the pool until the next load; removals are rare.
+    // While logged the slot is kept so a rollback can put the bookmark back.
+    if (bookmark_logging(manager)) {
+        bookmark_log(manager, &undo);
+    } else {
+        fr_slab_release(manager->bookmark_slab, bookmark->id - 1);
     }
     
-    return FALSE;
+    return bookmark_changed(manager);
 }
 
 FRBookmark* fr_bookmark_manager_find(FRBookmarkManager *manager, const char *url) {
     if (!manager || !url) return NULL;
     
-    for (GList *l = manager->bookmarks; l != NULL; l = l->next) {
-        FRBookmark *bookmark = (FRBookmark*)l->data;
-        if (bookmark && bookmark->url && strcmp(bookmark->url, url) == 0) {
-            return bookmark;
-        }
-    }
-    
-    return NULL;
+    return g_hash_table_lookup(manager->url_index, url);
 }
 
 GList* fr_bookmark_manager_get_all(FRBookmarkManager *manager) {
-    return manager ? manager->bookmarks : NULL;
+    return manager ? manager->bookmarks.head : NULL;
 }
 
 GList* fr_bookmark_manager_get_by_folder(FRBookmarkManager *manager, const char *folder) {
-    if (!manager || !folder) return NULL;
+    FRBookmarkFolder *node = fr_bookmark_manager_get_folder(manager, folder);
+    return node ? node->bookmarks.head : NULL;
+}
+
+gboolean fr_bookmark_manager_move(FRBookmarkManager *manager, const char *url, const char *folder) {
+    if (!manager || !url || !folder) return FALSE;
     
-    GList *result = NULL;
-    for (GList *l = manager->bookmarks; l != NULL; l = l->next) {
-        FRBookmark *bookmark = (FRBookmark*)l->data;
-        if (bookmark && bookmark->folder && strcmp(bookmark->folder, folder) == 0) {
-            result = g_list_append(result, bookmark);
+    FRBookmark *bookmark = fr_bookmark_manager_find(manager, url);
+    if (!bookmark) return FALSE;
+    
+    FRBookmarkFolder *target = bookmark_ensure_folder(manager, folder);
+    if (target == bookmark->parent) return TRUE;
+    
+    FRBookmarkUndo undo = { .type = BOOKMARK_UNDO_MOVE, .bookmark = bookmark,
+                            .folder = bookmark->parent, .prev_sibling = bookmark->sibling.prev };
+    bookmark_log(manager, &undo);
+    
+    bookmark_detach(manager, bookmark);
+    bookmark_attach(manager, bookmark, target);
+    return bookmark_changed(manager);
+}
+
+gboolean fr_bookmark_manager_edit(FRBookmarkManager *manager, const char *url, const char *title,
+                                  const char *new_url) {
+    if (!manager || !url) return FALSE;
+    
+    FRBookmark *bookmark = fr_bookmark_manager_find(manager, url);
+    if (!bookmark) return FALSE;
+    
+    gboolean url_changed = new_url && *new_url && strcmp(new_url, bookmark->url) != 0;
+    if (url_changed && fr_bookmark_manager_find(manager, new_url)) return FALSE;
+    
+    FRBookmarkUndo undo = { .type = BOOKMARK_UNDO_EDIT, .bookmark = bookmark,
+                            .title = bookmark->title, .url = bookmark->url };
+    bookmark_log(manager, &undo);
+    
+    bookmark_folder_touch(manager, bookmark->parent);
+    if (title) {
+        bookmark->title = (char*)fr_string_pool_intern(manager->strings, title);
+    }
+    if (url_changed) {
+        g_hash_table_remove(manager->url_index, bookmark->url);
+        bookmark->url = (char*)fr_string_pool_insert(manager->strings, new_url);
+        g_hash_table_insert(manager->url_index, bookmark->url, bookmark);
+    }
+    
+    return bookmark_changed(manager);
+}
+
+FRBookmarkFolder* fr_bookmark_manager_get_root(FRBookmarkManager *manager) {
+    return manager ? manager->root : NULL;
+}
+
+FRBookmarkFolder* fr_bookmark_manager_get_folder(FRBookmarkManager *manager, const char *path) {
+    if (!manager || !path) return NULL;
+    
+    FRBookmarkFolder *folder = g_hash_table_lookup(manager->folder_index, path);
+    if (folder) return folder;
+    
+    char *normalized = bookmark_normalize_path(path);
+    folder = g_hash_table_lookup(manager->folder_index, normalized);
+    g_free(normalized);
+    
+    return folder;
+}
+
+// Recomputes the paths of a folder's subtree after its name or parent changed
+static void bookmark_folder_update_paths(FRBookmarkManager *manager, FRBookmarkFolder *folder) {
+    char *path = bookmark_folder_build_path(folder->parent, folder->name);
+    
+    g_hash_table_remove(manager->folder_index, folder->path);
+    folder->path = (char*)fr_string_pool_intern(manager->strings, path);
+    g_hash_table_insert(manager->folder_index, folder->path, folder);
+    g_free(path);
+    
+    for (GList *l = folder->bookmarks.head; l != NULL; l = l->next) {
+        ((FRBookmark*)l->data)->folder = folder->path;
+    }
+    for (GList *l = folder->folders.head; l != NULL; l = l->next) {
+        bookmark_folder_update_paths(manager, (FRBookmarkFolder*)l->data);
+    }
+}
+
+static void bookmark_folder_reparent(FRBookmarkManager *manager, FRBookmarkFolder *folder,
+                                     FRBookmarkFolder *parent, GList *prev) {
+    bookmark_folder_touch(manager, folder->parent);
+    bookmark_folder_touch(manager, parent);
+    g_queue_unlink(&folder->parent->folders, &folder->link);
+    folder->parent = parent;
+    g_queue_insert_after_link(&parent->folders, prev, &folder->link);
+    bookmark_folder_update_paths(manager, folder);
+}
+
+gboolean fr_bookmark_manager_rename_folder(FRBookmarkManager *manager, const char *path,
+                                           const char *name) {
+    if (!manager || !path || !name) return FALSE;
+    if (*name == '\0' || strchr(name, '/')) return FALSE;
+    
+    FRBookmarkFolder *folder = fr_bookmark_manager_get_folder(manager, path);
+    if (!folder || folder == manager->root) return FALSE;
+    if (strcmp(folder->name, name) == 0) return TRUE;
+    
+    // Merging two folders is not a rename
+    char *new_path = bookmark_folder_build_path(folder->parent, name);
+    gboolean taken = g_hash_table_contains(manager->folder_index, new_path);
+    g_free(new_path);
+    if (taken) return FALSE;
+    
+    FRBookmarkUndo undo = { .type = BOOKMARK_UNDO_FOLDER_RENAME, .folder = folder,
+                            .title = folder->name };
+    bookmark_log(manager, &undo);
+    
+    folder->name = (char*)fr_string_pool_intern(manager->strings, name);
+    bookmark_folder_touch(manager, folder->parent);
+    bookmark_folder_update_paths(manager, folder);
+    return bookmark_changed(manager);
+}
+
+gboolean fr_bookmark_manager_move_folder(FRBookmarkManager *manager, const char *path,
+                                         const char *parent_path) {
+    if (!manager || !path || !parent_path) return FALSE;
+    
+    FRBookmarkFolder *folder = fr_bookmark_manager_get_folder(manager, path);
+    if (!folder || folder == manager->root) return FALSE;
+    
+    // An empty parent path means the root, unlike bookmark folders
+    char *parent_normalized = *parent_path ? bookmark_normalize_path(parent_path) : g_strdup("");
+    FRBookmarkFolder *parent = g_hash_table_lookup(manager->folder_index, parent_normalized);
+    if (parent == folder->parent) {
+        g_free(parent_normalized);
+        return TRUE;
+    }
+    
+    // Check the move on paths before creating a missing parent, so a rejected
+    // move leaves no empty folder behind
+    gsize length = strlen(folder->path);
+    gboolean into_subtree = strncmp(parent_normalized, folder->path, length) == 0 &&
+                            (parent_normalized[length] == '\0' || parent_normalized[length] == '/');
+    char *new_path = *parent_normalized ? g_strconcat(parent_normalized, "/", folder->name, NULL)
+                                        : g_strdup(folder->name);
+    gboolean taken = g_hash_table_contains(manager->folder_index, new_path);
+    g_free(new_path);
+    if (into_subtree || taken) {
+        g_free(parent_normalized);
+        return FALSE;
+    }
+    
+    if (!parent) {
+        parent = bookmark_ensure_folder(manager, parent_normalized);
+    }
+    g_free(parent_normalized);
+    
+    FRBookmarkUndo undo = { .type = BOOKMARK_UNDO_FOLDER_MOVE, .folder = folder,
+                            .parent = folder->parent, .prev_sibling = folder->link.prev };
+    bookmark_log(manager, &undo);
+    
+    bookmark_folder_reparent(manager, folder, parent, parent->folders.tail);
+    return bookmark_changed(manager);
+}
+
+static void bookmark_undo(FRBookmarkManager *manager, FRBookmarkUndo *undo) {
+    FRBookmark *bookmark = undo->bookmark;
+    FRBookmarkFolder *folder = undo->folder;
+    
+    switch (undo->type) {
+        case BOOKMARK_UNDO_INSERT:
+            g_hash_table_remove(manager->url_index, bookmark->url);
+            g_queue_unlink(&manager->bookmarks, &bookmark->link);
+            bookmark_detach(manager, bookmark);
+            fr_slab_release(manager->bookmark_slab, bookmark->id - 1);
+            break;
+        case BOOKMARK_UNDO_REMOVE:
+            g_queue_insert_after_link(&manager->bookmarks, undo->prev, &bookmark->link);
+            g_hash_table_insert(manager->url_index, bookmark->url, bookmark);
+            bookmark_attach_after(manager, bookmark, folder, undo->prev_sibling);
+            break;
+        case BOOKMARK_UNDO_MOVE:
+            bookmark_detach(manager, bookmark);
+            bookmark_attach_after(manager, bookmark, folder, undo->prev_sibling);
+            break;
+        case BOOKMARK_UNDO_EDIT:
+            bookmark_folder_touch(manager, bookmark->parent);
+            g_hash_table_remove(manager->url_index, bookmark->url);
+            bookmark->title = undo->title;
+            bookmark->url = undo->url;
+            g_hash_table_insert(manager->url_index, bookmark->url, bookmark);
+            break;
+        case BOOKMARK_UNDO_FOLDER_CREATE:
+            // Everything put in it was logged later and is already undone
+            bookmark_folder_touch(manager, folder->parent);
+            g_queue_unlink(&folder->parent->folders, &folder->link);
+            g_hash_table_remove(manager->folder_index, folder->path);
+            g_free(folder);
+            break;
+        case BOOKMARK_UNDO_FOLDER_RENAME:
+            folder->name = undo->title;
+            bookmark_folder_touch(manager, folder->parent);
+            bookmark_folder_update_paths(manager, folder);
+            break;
+        case BOOKMARK_UNDO_FOLDER_MOVE:
+            bookmark_folder_reparent(manager, folder, undo->parent, undo->prev_sibling);
+            break;
+    }
+}
+
+guint fr_bookmark_manager_connect_changed(FRBookmarkManager *manager, FRBookmarksChangedFunc func,
+                                          gpointer user_data) {
+    if (!manager || !func) return 0;
+    
+    FRBookmarkObserver observer = { manager->next_observer_id++, func, user_data };
+    g_array_append_val(manager->observers, observer);
+    return observer.id;
+}
+
+void fr_bookmark_manager_disconnect_changed(FRBookmarkManager *manager, guint handler_id) {
+    if (!manager) return;
+    
+    for (guint i = 0; i < manager->observers->len; i++) {
+        if (g_array_index(manager->observers, FRBookmarkObserver, i).id == handler_id) {
+            g_array_remove_index(manager->observers, i);
+            return;
         }
     }
+}
+
+typedef struct {
+    FRBookmarkManager *manager;
+    gboolean skip_existing;
+    guint source_id;        // the parse, then the chunks applying it
+    GPtrArray *records;     // FRBookmark*, parsed by a merge
+    guint applied;          // records inserted or skipped so far
+    gboolean applying;      // its batch is open
+    gboolean saving;        // committed, waiting for the write
+    FRJsonProgressFunc progress;
+    FRJsonDoneFunc done;
+    gpointer user_data;
+} FRBookmarkLoad;
+
+static void bookmark_load_record(FRJsonRecord *record, gpointer user_data) {
+    FRBookmarkLoad *load = (FRBookmarkLoad*)user_data;
+    const char *url = fr_json_record_get_string(record, "url");
+    
+    if (!url) return;
+    
+    if (load->records) {
+        FRBookmark *bookmark = fr_bookmark_new(fr_json_record_get_string(record, "title"), url,
+                                               fr_json_record_get_string(record, "folder"));
+        bookmark->created = (time_t)fr_json_record_get_int(record, "created", bookmark->created);
+        g_ptr_array_add(load->records, bookmark);
+        return;
+    }
+    if (load->skip_existing && fr_bookmark_manager_find(load->manager, url)) return;
     
-    return result;
+    bookmark_insert(load->manager, fr_json_record_get_string(record, "title"), url,
+                    fr_json_record_get_string(record, "folder"),
+                    (time_t)fr_json_record_get_int(record, "created", time(NULL)));
 }
 
 gboolean fr_bookmark_manager_load(FRBookmarkManager *manager) {
@@ -107,65 +618,161 @@ gboolean fr_bookmark_manager_load(FRBookmarkManager *manager) {
         return TRUE; // No file exists yet, that's OK
     }
     
-    GError *error = NULL;
-    char *contents;
-    gsize length;
+    // Bookmarks that parsed cleanly before an error are kept
+    FRBookmarkLoad load = { manager, FALSE, 0, NULL, NULL, NULL, NULL };
+    FRJsonStream *stream = fr_json_stream_new_for_records(bookmark_load_record, &load);
+    gboolean success = fr_json_stream_parse_file(stream, manager->bookmarks_file, NULL);
+    fr_json_stream_free(stream);
     
-    if (!g_file_get_contents(manager->bookmarks_file, &contents, &length, &error)) {
-        g_error_free(error);
-        return FALSE;
+    return success;
+}
+
+static void bookmark_import_progress(goffset bytes_read, goffset total, gpointer user_data) {
+    FRBookmarkLoad *load = (FRBookmarkLoad*)user_data;
+    
+    if (load->progress) {
+        load->progress(bytes_read, total, load->user_data);
     }
+}
+
+static void bookmark_import_free(FRBookmarkLoad *load) {
+    g_ptr_array_unref(load->records);
+    g_free(load);
+}
+
+static void bookmark_import_report(FRBookmarkLoad *load, gboolean success, const GError *error) {
+    g_ptr_array_remove(load->manager->imports, load);
+    if (load->done) {
+        load->done(success, error, load->user_data);
+    }
+}
+
+static void bookmark_import_saved(FRBookmarkManager *manager, gboolean success, gpointer user_data) {
+    FRBookmarkLoad *load = (FRBookmarkLoad*)user_data;
     
-    JsonParser *parser = json_parser_new();
-    if (!json_parser_load_from_data(parser, contents, length, &error)) {
-        g_free(contents);
-        g_object_unref(parser);
-        g_error_free(error);
-        return FALSE;
+    // A merge cancelled while saving has reported already
+    if (g_ptr_array_find(manager->imports, load, NULL)) {
+        GError *error = success ? NULL : g_error_new(G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                                     "Could not save bookmarks");
+        bookmark_import_report(load, success, error);
+        if (error) {
+            g_error_free(error);
+        }
+    }
+    bookmark_import_free(load);
+}
+
+static gboolean bookmark_import_apply(gpointer user_data) {
+    FRBookmarkLoad *load = (FRBookmarkLoad*)user_data;
+    guint end = MIN(load->applied + BOOKMARK_IMPORT_CHUNK, load->records->len);
+    
+    for (; load->applied < end; load->applied++) {
+        FRBookmark *bookmark = g_ptr_array_index(load->records, load->applied);
+        fr_bookmark_manager_insert(load->manager, bookmark->title, bookmark->url,
+                                   bookmark->folder, bookmark->created);
+    }
+    if (load->applied < load->records->len) {
+        return G_SOURCE_CONTINUE;
     }
     
-    JsonNode *root = json_parser_get_root(parser);
-    if (!JSON_NODE_HOLDS_ARRAY(root)) {
-        g_free(contents);
-        g_object_unref(parser);
-        return FALSE;
+    load->source_id = 0;
+    load->applying = FALSE;
+    load->saving = TRUE;
+    fr_bookmark_manager_commit_full(load->manager, bookmark_import_saved, load);
+    return G_SOURCE_REMOVE;
+}
+
+static void bookmark_import_parsed(gboolean success, const GError *error, gpointer user_data) {
+    FRBookmarkLoad *load = (FRBookmarkLoad*)user_data;
+    
+    load->source_id = 0;
+    if (!success) {
+        bookmark_import_report(load, FALSE, error);
+        bookmark_import_free(load);
+        return;
     }
     
-    JsonArray *array = json_node_get_array(root);
-    guint length_array = json_array_get_length(array);
+    // Applied in one batch only once the whole file parsed, so a damaged file
+    // leaves no trace; the batch spans the chunks so the store is written once
+    fr_bookmark_manager_begin(load->manager);
+    load->applying = TRUE;
+    load->source_id = g_idle_add(bookmark_import_apply, load);
+}
+
+// Merges a bookmarks.json file, parsing one chunk per main loop iteration and
+// then inserting a chunk of records per iteration.
+// Bookmarks whose URL is already present are skipped; done is called exactly once.
+// Nothing changes until the file is fully parsed.
+guint fr_bookmark_manager_import_json_async(FRBookmarkManager *manager, const char *path,
+                                            FRJsonProgressFunc progress, FRJsonDoneFunc done,
+                                            gpointer user_data) {
+    if (!manager || !path) return 0;
     
-    for (guint i = 0; i < length_array; i++) {
-        JsonNode *element = json_array_get_element(array, i);
-        if (!JSON_NODE_HOLDS_OBJECT(element)) continue;
-        
-        JsonObject *obj = json_node_get_object(element);
-        const char *title = json_object_get_string_member(obj, "title");
-        const char *url = json_object_get_string_member(obj, "url");
-        const char *folder = json_object_get_string_member(obj, "folder");
-        
-        if (url) {
-            FRBookmark *bookmark = fr_bookmark_new(title, url, folder);
-            if (json_object_has_member(obj, "created")) {
-                bookmark->created = (time_t)json_object_get_int_member(obj, "created");
-            }
-            manager->bookmarks = g_list_append(manager->bookmarks, bookmark);
-        }
+    FRBookmarkLoad *load = g_malloc0(sizeof(FRBookmarkLoad));
+    load->manager = manager;
+    load->skip_existing = TRUE;
+    load->progress = progress;
+    load->done = done;
+    load->user_data = user_data;
+    load->records = g_ptr_array_new_with_free_func((GDestroyNotify)fr_bookmark_free);
+    
+    g_ptr_array_add(manager->imports, load);
+    FRJsonStream *stream = fr_json_stream_new_for_records(bookmark_load_record, load);
+    
+    // A file that cannot be opened is done, and load freed, before this returns
+    guint source_id = fr_json_stream_parse_file_async(stream, path, bookmark_import_progress,
+                                                      bookmark_import_parsed, load);
+    if (source_id) {
+        load->source_id = source_id;
     }
+    return source_id;
+}
+
+// Stops a merge whose manager is going away; its caller hears it was cancelled.
+// Records applied so far are rolled back, a merge already saving is left to
+// finish and free itself.
+static void bookmark_import_cancel(gpointer data) {
+    FRBookmarkLoad *load = (FRBookmarkLoad*)data;
+    gboolean saving = load->saving;
     
-    g_free(contents);
-    g_object_unref(parser);
-    return TRUE;
+    if (load->source_id) {
+        g_source_remove(load->source_id);
+    }
+    if (load->applying) {
+        fr_bookmark_manager_rollback(load->manager);
+    }
+    
+    GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "Import cancelled");
+    bookmark_import_report(load, FALSE, error);
+    g_error_free(error);
+    
+    if (!saving) {
+        bookmark_import_free(load);
+    }
 }
 
-gboolean fr_bookmark_manager_save(FRBookmarkManager *manager) {
-    if (!manager || !manager->bookmarks_file) return FALSE;
+// Private copy of the bookmarks for the storage thread: one array of records
+// and one chunk of strings
+typedef struct {
+    GArray *bookmarks;      // FRBookmark
+    GStringChunk *strings;
+} FRBookmarkSnapshot;
+
+static void bookmark_snapshot_free(FRBookmarkSnapshot *snapshot) {
+    g_array_unref(snapshot->bookmarks);
+    g_string_chunk_free(snapshot->strings);
+    g_free(snapshot);
+}
+
+// Runs on the storage thread; the snapshot is a private copy of the bookmarks
+static char* bookmark_serialize_snapshot(gpointer snapshot, gsize *length) {
+    GArray *bookmarks = ((FRBookmarkSnapshot*)snapshot)->bookmarks;
     
     JsonBuilder *builder = json_builder_new();
     json_builder_begin_array(builder);
     
-    for (GList *l = manager->bookmarks; l != NULL; l = l->next) {
-        FRBookmark *bookmark = (FRBookmark*)l->data;
-        if (!bookmark) continue;
+    for (guint i = 0; i < bookmarks->len; i++) {
+        FRBookmark *bookmark = &g_array_index(bookmarks, FRBookmark, i);
         
         json_builder_begin_object(builder);
         
@@ -191,47 +798,417 @@ gboolean fr_bookmark_manager_save(FRBookmarkManager *manager) {
     json_generator_set_root(generator, root);
     json_generator_set_pretty(generator, TRUE);
     
-    char *json_data = json_generator_to_data(generator, NULL);
-    
-    GError *error = NULL;
-    gboolean success = g_file_set_contents(manager->bookmarks_file, json_data, -1, &error);
+    char *json_data = json_generator_to_data(generator, length);
     
-    if (error) {
-        g_error_free(error);
-        success = FALSE;
-    }
-    
-    g_free(json_data);
     json_node_free(root);
     g_object_unref(generator);
     g_object_unref(builder);
     
-    return success;
+    return json_data;
 }
 
-GtkWidget* fr_bookmark_create_menu(FRBookmarkManager *manager) {
-    GtkWidget *menu = gtk_menu_new();
+static FRBookmarkSnapshot* bookmark_snapshot_new(FRBookmarkManager *manager) {
+    FRBookmarkSnapshot *snapshot = g_malloc0(sizeof(FRBookmarkSnapshot));
+    snapshot->bookmarks = g_array_sized_new(FALSE, TRUE, sizeof(FRBookmark), manager->bookmarks.length);
+    snapshot->strings = g_string_chunk_new(16 * 1024);
     
-    if (!manager) return menu;
-    
-    for (GList *l = manager->bookmarks; l != NULL; l = l->next) {
+    for (GList *l = manager->bookmarks.head; l != NULL; l = l->next) {
         FRBookmark *bookmark = (FRBookmark*)l->data;
-        if (!bookmark) continue;
+        FRBookmark copy = { 0 };
         
-        GtkWidget *item = gtk_menu_item_new_with_label(bookmark->title);
-        g_object_set_data_full(G_OBJECT(item), "bookmark-url", 
-                              g_strdup(bookmark->url), g_free);
+        // Folders repeat, so share them in the copy too
+        copy.title = g_string_chunk_insert(snapshot->strings, bookmark->title);
+        copy.url = g_string_chunk_insert(snapshot->strings, bookmark->url);
+        copy.folder = g_string_chunk_insert_const(snapshot->strings, bookmark->folder);
+        copy.created = bookmark->created;
+        g_array_append_val(snapshot->bookmarks, copy);
+    }
+    
+    return snapshot;
+}
+
+gboolean fr_bookmark_manager_save(FRBookmarkManager *manager) {
+    if (!manager || !manager->bookmarks_file) return FALSE;
+    
+    fr_storage_write(manager->storage, manager->bookmarks_file, bookmark_snapshot_new(manager),
+                     bookmark_serialize_snapshot, (GDestroyNotify)bookmark_snapshot_free);
+    
+    return TRUE;
+}
+
+void fr_bookmark_manager_begin(FRBookmarkManager *manager) {
+    if (!manager) return;
+    
+    if (manager->batch_depth++ == 0) {
+        manager->batch_start = manager->undo_log->len;
+    }
+}
+
+// Undoes the log from index from on, newest first; returns whether anything changed
+static gboolean bookmark_undo_from(FRBookmarkManager *manager, guint from) {
+    if (manager->undo_log->len <= from) return FALSE;
+    
+    for (guint i = manager->undo_log->len; i > from; i--) {
+        bookmark_undo(manager, &g_array_index(manager->undo_log, FRBookmarkUndo, i - 1));
+    }
+    g_array_set_size(manager->undo_log, from);
+    return TRUE;
+}
+
+// The first count logged changes are on disk
+static void bookmark_confirm(FRBookmarkManager *manager, guint count) {
+    // Removed bookmarks were only held for a rollback
+    for (guint i = 0; i < count; i++) {
+        FRBookmarkUndo *undo = &g_array_index(manager->undo_log, FRBookmarkUndo, i);
+        if (undo->type == BOOKMARK_UNDO_REMOVE) {
+            fr_slab_release(manager->bookmark_slab, undo->bookmark->id - 1);
+        }
+    }
+    g_array_remove_range(manager->undo_log, 0, count);
+    
+    for (guint i = 0; i < manager->writes->len; i++) {
+        FRBookmarkWrite *write = g_ptr_array_index(manager->writes, i);
+        write->mark -= MIN(write->mark, count);
+    }
+    manager->batch_start -= MIN(manager->batch_start, count);
+}
+
+static void bookmark_report(FRBookmarkManager *manager, GArray *waiters, gboolean success) {
+    for (guint i = 0; i < waiters->len; i++) {
+        FRBookmarkWaiter *waiter = &g_array_index(waiters, FRBookmarkWaiter, i);
+        waiter->done(manager, success, waiter->user_data);
+    }
+    g_array_unref(waiters);
+}
+
+// Closes the outermost batch, undoing it
+static void bookmark_batch_abort(FRBookmarkManager *manager) {
+    gboolean changed = bookmark_undo_from(manager, manager->batch_start);
+    
+    GArray *waiters = manager->batch_waiters;
+    manager->batch_waiters = g_array_new(FALSE, FALSE, sizeof(FRBookmarkWaiter));
+    manager->batch_depth = 0;
+    manager->batch_failed = FALSE;
+    
+    // Views may have been built from the undone state mid-batch
+    if (changed) {
+        bookmark_notify(manager);
+    }
+    bookmark_report(manager, waiters, FALSE);
+}
+
+static void bookmark_write_done(gboolean success, gpointer user_data) {
+    FRBookmarkWrite *write = (FRBookmarkWrite*)user_data;
+    FRBookmarkManager *manager = write->manager;
+    
+    if (!manager) {
+        g_free(write);
+        return;
+    }
+    g_ptr_array_remove(manager->writes, write);
+    
+    if (success) {
+        // With no commit left in flight, plain edits since are as safe as they
+        // ever were; only an open batch stays logged
+        guint count = write->mark;
+        if (manager->writes->len == 0) {
+            count = manager->batch_depth > 0 ? manager->batch_start : manager->undo_log->len;
+        }
+        bookmark_confirm(manager, count);
+    } else {
+        g_warning("Rolling back bookmark changes that did not reach %s", manager->bookmarks_file);
+        
+        // Nothing after the last good write is on disk; an open batch lost
+        // its earlier changes too, so it cannot commit
+        gboolean changed = bookmark_undo_from(manager, 0);
+        for (guint i = 0; i < manager->writes->len; i++) {
+            ((FRBookmarkWrite*)g_ptr_array_index(manager->writes, i))->mark = 0;
+        }
+        manager->batch_start = 0;
+        if (manager->batch_depth > 0) {
+            manager->batch_failed = TRUE;
+        }
+        
+        if (changed) {
+            bookmark_notify(manager);
+        }
         
-        gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+        // Later writes carry the undone changes; replace them
+        if (manager->writes->len > 0) {
+            fr_bookmark_manager_save(manager);
+        }
+    }
+    
+    bookmark_report(manager, write->waiters, success);
+    g_free(write);
+}
+
+void fr_bookmark_manager_rollback(FRBookmarkManager *manager) {
+    if (!manager || manager->batch_depth == 0) return;
+    
+    // Only the outermost batch is atomic; an inner rollback dooms it
+    if (manager->batch_depth > 1) {
+        manager->batch_depth--;
+        manager->batch_failed = TRUE;
+        return;
+    }
+    bookmark_batch_abort(manager);
+}
+
+gboolean fr_bookmark_manager_commit_full(FRBookmarkManager *manager, FRBookmarkCommitFunc done,
+                                         gpointer user_data) {
+    if (!manager || manager->batch_depth == 0) return FALSE;
+    
+    // Nested commits hear how the outermost one went
+    if (done) {
+        FRBookmarkWaiter waiter = { done, user_data };
+        g_array_append_val(manager->batch_waiters, waiter);
+    }
+    if (manager->batch_depth > 1) {
+        manager->batch_depth--;
+        return TRUE;
+    }
+    if (manager->batch_failed) {
+        bookmark_batch_abort(manager);
+        return FALSE;
+    }
+    
+    GArray *waiters = manager->batch_waiters;
+    manager->batch_waiters = g_array_new(FALSE, FALSE, sizeof(FRBookmarkWaiter));
+    manager->batch_depth = 0;
+    
+    if (manager->undo_log->len == manager->batch_start) {
+        bookmark_report(manager, waiters, TRUE);
+        return TRUE;
+    }
+    
+    // The storage thread reports back on the main loop, where a failed write
+    // is rolled back
+    FRBookmarkWrite *write = g_malloc0(sizeof(FRBookmarkWrite));
+    write->manager = manager;
+    write->mark = manager->undo_log->len;
+    write->waiters = waiters;
+    
+    bookmark_notify(manager);
+    g_ptr_array_add(manager->writes, write);
+    fr_storage_write_full(manager->storage, manager->bookmarks_file, bookmark_snapshot_new(manager),
+                          bookmark_serialize_snapshot, (GDestroyNotify)bookmark_snapshot_free,
+                          bookmark_write_done, write);
+    return TRUE;
+}
+
+gboolean fr_bookmark_manager_commit(FRBookmarkManager *manager) {
+    return fr_bookmark_manager_commit_full(manager, NULL, NULL);
+}
+
+// A menu mirroring one folder: its subfolders, then its bookmarks. Items are
+// created the first time the menu is shown and afterwards only patched where
+// the folder's serial says its listing changed.
+typedef struct {
+    FRBookmarkManager *manager;
+    FRBookmarkFolder *folder;
+    GtkWidget *menu;
+    guint first;            // items before the folder's own
+    gboolean built;         // shown at least once
+    guint serial;           // folder serial the items reflect
+    GHashTable *items;      // FRBookmark* or FRBookmarkFolder* -> GtkWidget*
+    GPtrArray *shown;       // keys of items, in menu order
+    GtkWidget *empty_item;
+    FRFaviconCache *favicons;
+    GCallback activate;
+    gpointer user_data;
+    guint handler_id;       // change observer, root menu only
+} FRBookmarkMenu;
+
+static GtkWidget* bookmark_menu_attach_folder(GtkWidget *menu, FRBookmarkManager *manager,
+                                              FRBookmarkFolder *folder, FRFaviconCache *favicons,
+                                              GCallback activate, gpointer user_data);
+
+static void bookmark_menu_free(FRBookmarkMenu *state) {
+    if (state->handler_id) {
+        fr_bookmark_manager_disconnect_changed(state->manager, state->handler_id);
+    }
+    g_hash_table_destroy(state->items);
+    g_ptr_array_unref(state->shown);
+    g_free(state);
+}
+
+static GtkWidget* bookmark_menu_item_new(FRBookmarkMenu *state, gpointer key, gboolean is_folder) {
+    GtkWidget *item;
+    
+    if (is_folder) {
+        FRBookmarkFolder *folder = (FRBookmarkFolder*)key;
+        item = gtk_menu_item_new_with_label(folder->name);
+        gtk_menu_item_set_submenu(GTK_MENU_ITEM(item),
+                                  bookmark_menu_attach_folder(gtk_menu_new(), state->manager, folder,
+                                                              state->favicons, state->activate,
+                                                              state->user_data));
+    } else {
+        FRBookmark *bookmark = (FRBookmark*)key;
+        item = fr_favicon_menu_item_new(state->favicons, bookmark->url, bookmark->title);
+        g_object_set_data_full(G_OBJECT(item), "bookmark-url", g_strdup(bookmark->url), g_free);
+        if (state->activate) {
+            g_signal_connect(item, "activate", state->activate, state->user_data);
+        }
+    }
+    
+    gtk_widget_show(item);
+    return item;
+}
+
+// Puts key's item at index among the folder's items, creating or updating it
+static void bookmark_menu_place(FRBookmarkMenu *state, guint index, gpointer key,
+                                gboolean is_folder) {
+    GtkWidget *item = g_hash_table_lookup(state->items, key);
+    const char *label = is_folder ? ((FRBookmarkFolder*)key)->name : ((FRBookmark*)key)->title;
+    
+    if (!item) {
+        item = bookmark_menu_item_new(state, key, is_folder);
+        g_hash_table_insert(state->items, key, item);
+        g_ptr_array_insert(state->shown, index, key);
+        gtk_menu_shell_insert(GTK_MENU_SHELL(state->menu), item, state->first + index);
+        return;
+    }
+    
+    if (index >= state->shown->len || g_ptr_array_index(state->shown, index) != key) {
+        guint old_index;
+        g_ptr_array_find(state->shown, key, &old_index);
+        g_ptr_array_remove_index(state->shown, old_index);
+        g_ptr_array_insert(state->shown, index, key);
+        gtk_menu_reorder_child(GTK_MENU(state->menu), item, state->first + index);
+    }
+    
+    GtkLabel *label_widget = fr_favicon_menu_item_get_label(item);
+    if (g_strcmp0(gtk_label_get_text(label_widget), label) != 0) {
+        gtk_label_set_text(label_widget, label);
     }
+    if (!is_folder) {
+        const char *url = ((FRBookmark*)key)->url;
+        g_object_set_data_full(G_OBJECT(item), "bookmark-url", g_strdup(url), g_free);
+        fr_favicon_menu_item_set_url(state->favicons, item, url);
+    }
+}
+
+static void bookmark_menu_sync(FRBookmarkMenu *state) {
+    FRBookmarkFolder *folder = state->folder;
+    
+    if (state->serial != folder->serial) {
+        // Forget items whose bookmark or folder left; keys may be dangling here,
+        // so they are only compared, never followed
+        GHashTable *current = g_hash_table_new(NULL, NULL);
+        for (GList *l = folder->folders.head; l != NULL; l = l->next) {
+            g_hash_table_add(current, l->data);
+        }
+        for (GList *l = folder->bookmarks.head; l != NULL; l = l->next) {
+            g_hash_table_add(current, l->data);
+        }
+        
+        for (guint i = state->shown->len; i > 0; i--) {
+            gpointer key = g_ptr_array_index(state->shown, i - 1);
+            if (!g_hash_table_contains(current, key)) {
+                gtk_widget_destroy(GTK_WIDGET(g_hash_table_lookup(state->items, key)));
+                g_hash_table_remove(state->items, key);
+                g_ptr_array_remove_index(state->shown, i - 1);
+            }
+        }
+        g_hash_table_destroy(current);
+        
+        guint index = 0;
+        for (GList *l = folder->folders.head; l != NULL; l = l->next) {
+            bookmark_menu_place(state, index++, l->data, TRUE);
+        }
+        for (GList *l = folder->bookmarks.head; l != NULL; l = l->next) {
+            bookmark_menu_place(state, index++, l->data, FALSE);
+        }
+        
+        gtk_widget_set_visible(state->empty_item, index == 0);
+        state->serial = folder->serial;
+    }
+    
+    // Built submenus follow their folders; the rest wait for their first show
+    for (GList *l = folder->folders.head; l != NULL; l = l->next) {
+        GtkWidget *item = g_hash_table_lookup(state->items, l->data);
+        GtkWidget *submenu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(item));
+        FRBookmarkMenu *child = g_object_get_data(G_OBJECT(submenu), "bookmark-menu");
+        if (child->built) {
+            bookmark_menu_sync(child);
+        }
+    }
+}
+
+static void on_bookmark_menu_show(GtkWidget *menu, gpointer user_data) {
+    FRBookmarkMenu *state = (FRBookmarkMenu*)user_data;
+    
+    if (!state->built) {
+        state->empty_item = gtk_menu_item_new_with_label(state->folder->parent ? "(Empty)" : "No bookmarks");
+        gtk_widget_set_sensitive(state->empty_item, FALSE);
+        gtk_menu_shell_append(GTK_MENU_SHELL(state->menu), state->empty_item);
+        
+        // Any serial but the folder's own forces the first fill
+        state->built = TRUE;
+        state->serial = state->folder->serial - 1;
+        bookmark_menu_sync(state);
+    }
+}
+
+static void on_bookmarks_changed(FRBookmarkManager *manager, gpointer user_data) {
+    FRBookmarkMenu *state = (FRBookmarkMenu*)user_data;
+    
+    if (state->built) {
+        bookmark_menu_sync(state);
+    }
+}
+
+static GtkWidget* bookmark_menu_attach_folder(GtkWidget *menu, FRBookmarkManager *manager,
+                                              FRBookmarkFolder *folder, FRFaviconCache *favicons,
+                                              GCallback activate, gpointer user_data) {
+    FRBookmarkMenu *state = g_malloc0(sizeof(FRBookmarkMenu));
+    state->manager = manager;
+    state->folder = folder;
+    state->menu = menu;
+    state->favicons = favicons;
+    state->items = g_hash_table_new(NULL, NULL);
+    state->shown = g_ptr_array_new();
+    state->activate = activate;
+    state->user_data = user_data;
     
-    if (g_list_length(manager->bookmarks) == 0) {
-        GtkWidget *item = gtk_menu_item_new_with_label("No bookmarks");
-        gtk_widget_set_sensitive(item, FALSE);
-        gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+    // Folder submenus lead with an item opening every bookmark in them as tabs;
+    // it is activated like a bookmark, with the folder in "bookmark-folder"
+    if (folder->parent && activate) {
+        GtkWidget *open_all_item = gtk_menu_item_new_with_label("Open All in Tabs");
+        g_object_set_data(G_OBJECT(open_all_item), "bookmark-folder", folder);
+        g_signal_connect(open_all_item, "activate", activate, user_data);
+        gtk_widget_show(open_all_item);
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), open_all_item);
+        
+        GtkWidget *separator = gtk_separator_menu_item_new();
+        gtk_widget_show(separator);
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), separator);
     }
     
-    gtk_widget_show_all(menu);
+    GList *children = gtk_container_get_children(GTK_CONTAINER(menu));
+    state->first = g_list_length(children);
+    g_list_free(children);
+    
+    g_object_set_data_full(G_OBJECT(menu), "bookmark-menu", state, (GDestroyNotify)bookmark_menu_free);
+    g_signal_connect(menu, "show", G_CALLBACK(on_bookmark_menu_show), state);
+    
+    return menu;
+}
+
+void fr_bookmark_menu_attach(GtkWidget *menu, FRBookmarkManager *manager, FRFaviconCache *favicons,
+                             GCallback activate, gpointer user_data) {
+    if (!menu || !manager) return;
+    
+    bookmark_menu_attach_folder(menu, manager, manager->root, favicons, activate, user_data);
+    FRBookmarkMenu *state = g_object_get_data(G_OBJECT(menu), "bookmark-menu");
+    state->handler_id = fr_bookmark_manager_connect_changed(manager, on_bookmarks_changed, state);
+}
+
+GtkWidget* fr_bookmark_create_menu(FRBookmarkManager *manager) {
+    GtkWidget *menu = gtk_menu_new();
+    
+    fr_bookmark_menu_attach(menu, manager, NULL, NULL, NULL);
     return menu;
 }
 
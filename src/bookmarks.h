@@ -3,35 +3,133 @@
 
 #include <gtk/gtk.h>
 #include <glib.h>
+#include "arena.h"
+#include "jsonstream.h"
+#include "storage.h"
+#include "favicon.h"
 
+typedef struct _FRBookmarkFolder FRBookmarkFolder;
+
+// Bookmarks owned by a manager live in its slab and their strings in its
+// string pool; only bookmarks from fr_bookmark_new own their strings.
 typedef struct {
     char *title;
     char *url;
-    char *folder;
+    char *folder;           // path of parent while in a manager
     time_t created;
+    guint id;               // slab slot + 1 while the bookmark is in a manager, else 0
+    GList link;             // node in the manager's bookmarks queue, data is the bookmark
+    GList sibling;          // node in parent's bookmarks queue
+    FRBookmarkFolder *parent;
 } FRBookmark;
 
-typedef struct {
-    GList *bookmarks;
+// A node of the folder tree. Paths are '/'-separated names below the
+// unnamed root, e.g. "Work/Docs", and are interned in the manager.
+struct _FRBookmarkFolder {
+    char *name;
+    char *path;
+    FRBookmarkFolder *parent;
+    GQueue folders;         // FRBookmarkFolder*, child folders in order
+    GQueue bookmarks;       // FRBookmark*, linked through their sibling node
+    GList link;             // node in parent's folders queue
+    guint serial;           // changes whenever the two queues or their titles do
+};
+
+typedef struct _FRBookmarkManager FRBookmarkManager;
+
+// Called once per change outside a batch, once per committed batch, and
+// again when a batch or a failed write is rolled back
+typedef void (*FRBookmarksChangedFunc)(FRBookmarkManager *manager, gpointer user_data);
+// Reports whether a committed batch reached the disk; if not, it was undone
+typedef void (*FRBookmarkCommitFunc)(FRBookmarkManager *manager, gboolean success,
+                                     gpointer user_data);
+
+struct _FRBookmarkManager {
+    GQueue bookmarks;       // FRBookmark*, in insertion order
+    GHashTable *url_index;  // url -> FRBookmark*
+    GHashTable *folder_index; // path -> FRBookmarkFolder*
+    FRBookmarkFolder *root;
+    guint serial;           // last folder serial handed out
+    FRSlab *bookmark_slab;
+    FRStringPool *strings;
     char *bookmarks_file;
-} FRBookmarkManager;
+    FRStorage *storage;
+    GArray *observers;      // FRBookmarkObserver
+    guint next_observer_id;
+    guint batch_depth;
+    gboolean batch_failed;  // a nested batch rolled back, or a write under it failed
+    guint batch_start;      // undo_log length when the open batch began
+    GArray *batch_waiters;  // FRBookmarkWaiter, commits of the open batch's nested batches
+    GArray *undo_log;       // FRBookmarkUndo, changes not known to be on disk yet
+    GPtrArray *writes;      // FRBookmarkWrite*, committed batches on their way to disk
+    GPtrArray *imports;     // merges from fr_bookmark_manager_import_json_async still running
+};
 
 // Bookmark manager functions
-FRBookmarkManager* fr_bookmark_manager_new(void);
+FRBookmarkManager* fr_bookmark_manager_new(FRStorage *storage);
 void fr_bookmark_manager_free(FRBookmarkManager *manager);
 gboolean fr_bookmark_manager_load(FRBookmarkManager *manager);
 gboolean fr_bookmark_manager_save(FRBookmarkManager *manager);
+guint fr_bookmark_manager_import_json_async(FRBookmarkManager *manager, const char *path,
+                                            FRJsonProgressFunc progress, FRJsonDoneFunc done,
+                                            gpointer user_data);
 
 // Bookmark operations
 FRBookmark* fr_bookmark_new(const char *title, const char *url, const char *folder);
 void fr_bookmark_free(FRBookmark *bookmark);
+// Takes ownership of bookmark, which is copied into the manager's storage and
+// freed, also when an equal URL is already bookmarked
 gboolean fr_bookmark_manager_add(FRBookmarkManager *manager, FRBookmark *bookmark);
+// Like add without the FRBookmark copy. Returns NULL when the URL is
+// already bookmarked.
+FRBookmark* fr_bookmark_manager_insert(FRBookmarkManager *manager, const char *title,
+                                       const char *url, const char *folder, time_t created);
 gboolean fr_bookmark_manager_remove(FRBookmarkManager *manager, const char *url);
 FRBookmark* fr_bookmark_manager_find(FRBookmarkManager *manager, const char *url);
 GList* fr_bookmark_manager_get_all(FRBookmarkManager *manager);
+// Returns the folder's own queue; the list belongs to the manager
 GList* fr_bookmark_manager_get_by_folder(FRBookmarkManager *manager, const char *folder);
+gboolean fr_bookmark_manager_move(FRBookmarkManager *manager, const char *url, const char *folder);
+// NULL title or new_url keeps the current one
+gboolean fr_bookmark_manager_edit(FRBookmarkManager *manager, const char *url, const char *title,
+                                  const char *new_url);
+
+// Batches. Changes between begin and commit are applied in memory at once,
+// queued for one write by the outermost commit and reported to observers once.
+// If any batch in it was rolled back, everything since the outermost begin
+// is undone and commit returns FALSE. If the write fails, everything changed
+// since the last write that made it is undone and observers are told.
+// A batch may stay open across main loop iterations, as an import applying
+// records in chunks does; edits made meanwhile become part of it.
+void fr_bookmark_manager_begin(FRBookmarkManager *manager);
+gboolean fr_bookmark_manager_commit(FRBookmarkManager *manager);
+// Like commit, but done hears whether the outermost batch reached the disk.
+// It is called exactly once, immediately if the batch is rolled back.
+gboolean fr_bookmark_manager_commit_full(FRBookmarkManager *manager, FRBookmarkCommitFunc done,
+                                         gpointer user_data);
+void fr_bookmark_manager_rollback(FRBookmarkManager *manager);
+
+guint fr_bookmark_manager_connect_changed(FRBookmarkManager *manager, FRBookmarksChangedFunc func,
+                                          gpointer user_data);
+void fr_bookmark_manager_disconnect_changed(FRBookmarkManager *manager, guint handler_id);
+
+// Folder operations
+FRBookmarkFolder* fr_bookmark_manager_get_root(FRBookmarkManager *manager);
+FRBookmarkFolder* fr_bookmark_manager_get_folder(FRBookmarkManager *manager, const char *path);
+gboolean fr_bookmark_manager_rename_folder(FRBookmarkManager *manager, const char *path,
+                                           const char *name);
+gboolean fr_bookmark_manager_move_folder(FRBookmarkManager *manager, const char *path,
+                                         const char *parent_path);
 
 // UI functions
+// Appends the bookmark tree to menu after its current items. Folder submenus
+// are filled when first shown and then kept in step with the manager;
+// activate is connected to each bookmark item, whose url is in "bookmark-url",
+// and to each folder's "Open All in Tabs" item, whose FRBookmarkFolder* is in
+// "bookmark-folder".
+// favicons, if not NULL, supplies the icons shown before bookmark titles.
+void fr_bookmark_menu_attach(GtkWidget *menu, FRBookmarkManager *manager, FRFaviconCache *favicons,
+                             GCallback activate, gpointer user_data);
 GtkWidget* fr_bookmark_create_menu(FRBookmarkManager *manager);
 void fr_bookmark_show_dialog(GtkWindow *parent, FRBookmarkManager *manager, const char *url, const char *title);
 
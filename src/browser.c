@@ -5,74 +5,102 @@
 #include <string.h>
 #include <stdlib.h>
 
+static void browser_materialize_tab(FRTab *tab, gpointer user_data);
+
 FRBrowser* fr_browser_new(void) {
     FRBrowser *browser = g_malloc0(sizeof(FRBrowser));
-    browser->current_tab = -1;
-    browser->tab_count = 0;
+    browser->tabs = fr_tab_model_new();
+    
+    browser->settings = fr_settings_new();
+    fr_settings_load(browser->settings);
+    
+    browser->storage = fr_storage_new(browser->settings->storage_flush_delay_ms);
+    browser->web_context = fr_web_context_new(browser->settings);
+    browser->web_view_pool = fr_web_view_pool_new(browser->web_context, browser->settings->spare_web_views,
+                                                  browser->settings->spare_memory_limit_mb);
+    
+    browser->history_manager = fr_history_manager_new(browser->storage);
+    fr_history_manager_load(browser->history_manager);
+    
+    browser->bookmark_manager = fr_bookmark_manager_new(browser->storage);
+    fr_bookmark_manager_load(browser->bookmark_manager);
+    
+    browser->thumbnails = fr_thumbnail_cache_new((gsize)browser->settings->thumbnail_cache_mb * 1024 * 1024);
+    browser->closed_tabs = fr_closed_tabs_new(browser->settings->closed_tabs,
+                                              browser->settings->closed_tab_keep_alive_sec);
+    browser->tab_loader = fr_tab_loader_new(browser->settings->max_background_loads,
+                                            browser_materialize_tab, browser);
+    
     return browser;
 }
 
 void fr_browser_free(FRBrowser *browser) {
     if (browser) {
+        // Fold the visit journal into the snapshot on the way out, then wait
+        // for the storage thread to write everything that is still queued
+        fr_history_manager_compact(browser->history_manager);
+        fr_storage_free(browser->storage);
+        
+        fr_ui_updater_free(browser->ui_updater);
+        fr_omnibox_free(browser->omnibox);
+        fr_favicon_cache_free(browser->favicons);
+        fr_session_free(browser->session);
+        fr_tab_discarder_free(browser->tab_discarder);
+        fr_tab_throttler_free(browser->tab_throttler);
+        fr_tab_loader_free(browser->tab_loader);
+        fr_tab_model_free(browser->tabs);
+        fr_closed_tabs_free(browser->closed_tabs);
+        fr_thumbnail_cache_free(browser->thumbnails);
+        fr_tab_overview_free(browser->tab_overview);
+        if (browser->tab_preview) {
+            g_object_unref(browser->tab_preview);
+        }
+        fr_web_view_pool_free(browser->web_view_pool);
+        g_object_unref(browser->web_context);
+        fr_history_manager_free(browser->history_manager);
+        fr_bookmark_manager_free(browser->bookmark_manager);
+        fr_settings_free(browser->settings);
         g_free(browser);
     }
 }
 
 void fr_browser_navigate_to(FRBrowser *browser, const char *url) {
-    if (!browser || !url || browser->current_tab < 0) return;
+    FRTab *tab = browser ? browser->tabs->current : NULL;
+    if (!tab || !url) return;
     
     char *sanitized_url = fr_browser_sanitize_url(url);
     
-    GtkWidget *current_page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(browser->notebook), browser->current_tab);
-    if (current_page && GTK_IS_SCROLLED_WINDOW(current_page)) {
-        GtkWidget *child = gtk_bin_get_child(GTK_BIN(current_page));
-        if (child && WEBKIT_IS_WEB_VIEW(child)) {
-            WebKitWebView *web_view = WEBKIT_WEB_VIEW(child);
-            webkit_web_view_load_uri(web_view, sanitized_url);
-        }
+    if (tab->web_view) {
+        webkit_web_view_load_uri(tab->web_view, sanitized_url);
+    } else {
+        // Still a placeholder; load the new address instead of the old one
+        fr_tab_set_url(tab, sanitized_url);
+        fr_tab_loader_request(browser->tab_loader, tab, FR_TAB_PRIORITY_FOREGROUND);
     }
     
-    gtk_entry_set_text(GTK_ENTRY(browser->url_entry), sanitized_url);
+    fr_omnibox_set_text(browser->omnibox, sanitized_url);
     g_free(sanitized_url);
 }
 
 void fr_browser_go_back(FRBrowser *browser) {
-    if (!browser || browser->current_tab < 0) return;
-    
-    GtkWidget *current_page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(browser->notebook), browser->current_tab);
-    if (current_page && GTK_IS_SCROLLED_WINDOW(current_page)) {
-        GtkWidget *child = gtk_bin_get_child(GTK_BIN(current_page));
-        if (child && WEBKIT_IS_WEB_VIEW(child)) {
-            WebKitWebView *web_view = WEBKIT_WEB_VIEW(child);
-            webkit_web_view_go_back(web_view);
-        }
-    }
+    FRTab *tab = browser ? browser->tabs->current : NULL;
+    if (!tab || !tab->web_view) return;
+    
+    webkit_web_view_go_back(tab->web_view);
 }
 
 void fr_browser_go_forward(FRBrowser *browser) {
-    if (!browser || browser->current_tab < 0) return;
-    
-    GtkWidget *current_page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(browser->notebook), browser->current_tab);
-    if (current_page && GTK_IS_SCROLLED_WINDOW(current_page)) {
-        GtkWidget *child = gtk_bin_get_child(GTK_BIN(current_page));
-        if (child && WEBKIT_IS_WEB_VIEW(child)) {
-            WebKitWebView *web_view = WEBKIT_WEB_VIEW(child);
-            webkit_web_view_go_forward(web_view);
-        }
-    }
+    FRTab *tab = browser ? browser->tabs->current : NULL;
+    if (!tab || !tab->web_view) return;
+    
+    webkit_web_view_go_forward(tab->web_view);
 }
 
 void fr_browser_refresh(FRBrowser *browser) {
-    if (!browser || browser->current_tab < 0) return;
-    
-    GtkWidget *current_page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(browser->notebook), browser->current_tab);
-    if (current_page && GTK_IS_SCROLLED_WINDOW(current_page)) {
-        GtkWidget *child = gtk_bin_get_child(GTK_BIN(current_page));
-        if (child && WEBKIT_IS_WEB_VIEW(child)) {
-            WebKitWebView *web_view = WEBKIT_WEB_VIEW(child);
-            webkit_web_view_reload(web_view);
-        }
-    }
+    FRTab *tab = browser ? browser->tabs->current : NULL;
+    if (!tab || !tab->web_view) return;
+    
+    webkit_web_view_reload(tab->web_view);
 }
 
 void fr_browser_go_home(FRBrowser *browser) {
@@ -80,52 +108,143 @@ void fr_browser_go_home(FRBrowser *browser) {
 }
 
 
-void fr_browser_new_tab(FRBrowser *browser, const char *url) {
-    if (!browser) return;
+// Keeps the view lookup from outliving the view, whether its tab closed or
+// was discarded
+static void on_tab_web_view_destroy(GtkWidget *web_view, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    fr_tab_model_forget_web_view(browser->tabs, WEBKIT_WEB_VIEW(web_view));
+}
+
+// Puts web_view into tab and starts following it
+static void browser_attach_web_view(FRBrowser *browser, FRTab *tab, WebKitWebView *web_view) {
+    gtk_container_add(GTK_CONTAINER(tab->page), GTK_WIDGET(web_view));
     
-    const char *target_url = url ? url : DEFAULT_HOME_PAGE;
+    // Connect web view signals
+    g_signal_connect(web_view, "load-changed", G_CALLBACK(on_load_changed), browser);
+    g_signal_connect(web_view, "notify::title", G_CALLBACK(on_title_changed), browser);
+    g_signal_connect(web_view, "notify::uri", G_CALLBACK(on_uri_changed), browser);
+    g_signal_connect(web_view, "notify::favicon", G_CALLBACK(on_favicon_changed), browser);
+    g_signal_connect(web_view, "web-process-terminated", G_CALLBACK(on_web_process_terminated), browser);
+    g_signal_connect(web_view, "create", G_CALLBACK(on_web_view_create), browser);
+    g_signal_connect(web_view, "close", G_CALLBACK(on_web_view_close), browser);
+    g_signal_connect(web_view, "destroy", G_CALLBACK(on_tab_web_view_destroy), browser);
+    
+    gtk_widget_show(GTK_WIDGET(web_view));
+    fr_tab_model_set_web_view(browser->tabs, tab, web_view);
+}
+
+// Creates the web view of a placeholder tab when the loader starts it
+static void browser_materialize_tab(FRTab *tab, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    
+    // A spare has its web process running already; a saved back/forward list
+    // has to go into a view that never loaded, which a spare also is
+    WebKitWebView *web_view = fr_web_view_pool_take(browser->web_view_pool);
+    browser_attach_web_view(browser, tab, web_view);
+}
+
+// Drops a closed tab from the model and the loader, also when the window goes away
+static void on_tab_page_destroy(GtkWidget *page, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    FRTab *tab = fr_tab_get(page);
+    
+    fr_tab_loader_finished(browser->tab_loader, tab);
+    fr_ui_updater_forget(browser->ui_updater, tab);
+    fr_thumbnail_cache_remove(browser->thumbnails, tab->id);
+    fr_tab_model_remove(browser->tabs, tab);
+}
+
+// Appends a placeholder tab showing what is known about url so far; id is
+// the one it had last session, or 0
+static FRTab* browser_add_tab(FRBrowser *browser, guint id, const char *url, const char *title) {
+    FRTab *tab = fr_tab_new(url);
+    fr_tab_set_title(tab, title);
+    fr_tab_model_add(browser->tabs, tab, id);
     
     // Create scrolled window for the web view
-    GtkWidget *scrolled_window = gtk_scrolled_window_new(NULL, NULL);
-    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
+    tab->page = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(tab->page),
                                    GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    g_object_set_data_full(G_OBJECT(tab->page), "tab", tab, (GDestroyNotify)fr_tab_free);
+    g_signal_connect(tab->page, "destroy", G_CALLBACK(on_tab_page_destroy), browser);
     
-    // Create web view
-    WebKitWebView *web_view = WEBKIT_WEB_VIEW(webkit_web_view_new());
-    gtk_container_add(GTK_CONTAINER(scrolled_window), GTK_WIDGET(web_view));
-    
-    // Create tab label with close button
+    // Create tab label with favicon and close button
     GtkWidget *tab_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
-    GtkWidget *tab_label = gtk_label_new("New Tab");
+    tab->tab_icon = gtk_image_new();
+    tab->tab_label = gtk_label_new(NULL);
     GtkWidget *close_button = gtk_button_new_from_icon_name("window-close", GTK_ICON_SIZE_MENU);
     gtk_button_set_relief(GTK_BUTTON(close_button), GTK_RELIEF_NONE);
     
-    gtk_box_pack_start(GTK_BOX(tab_box), tab_label, TRUE, TRUE, 0);
+    gtk_widget_set_size_request(tab->tab_icon, FR_FAVICON_SIZE, FR_FAVICON_SIZE);
+    fr_favicon_cache_set_image(browser->favicons, GTK_IMAGE(tab->tab_icon), url);
+    fr_tab_update_label(tab, title && *title ? title : "New Tab");
+    
+    gtk_box_pack_start(GTK_BOX(tab_box), tab->tab_icon, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(tab_box), tab->tab_label, TRUE, TRUE, 0);
     gtk_box_pack_start(GTK_BOX(tab_box), close_button, FALSE, FALSE, 0);
     gtk_widget_show_all(tab_box);
     
-    // Add tab to notebook
-    int page_num = gtk_notebook_append_page(GTK_NOTEBOOK(browser->notebook), scrolled_window, tab_box);
-    gtk_notebook_set_tab_reorderable(GTK_NOTEBOOK(browser->notebook), scrolled_window, TRUE);
+    // Hovering shows how the page last looked
+    gtk_widget_set_has_tooltip(tab_box, TRUE);
+    g_object_set_data(G_OBJECT(tab_box), "page-widget", tab->page);
+    g_signal_connect(tab_box, "query-tooltip", G_CALLBACK(on_tab_query_tooltip), browser);
     
-    // Connect web view signals
-    g_signal_connect(web_view, "load-changed", G_CALLBACK(on_load_changed), browser);
-    g_signal_connect(web_view, "notify::title", G_CALLBACK(on_title_changed), browser);
-    g_signal_connect(web_view, "notify::uri", G_CALLBACK(on_uri_changed), browser);
+    // Add tab to notebook
+    gtk_widget_show(tab->page);
+    gtk_notebook_append_page(GTK_NOTEBOOK(browser->notebook), tab->page, tab_box);
+    gtk_notebook_set_tab_reorderable(GTK_NOTEBOOK(browser->notebook), tab->page, TRUE);
     
     // Connect close button signal
     g_signal_connect(close_button, "clicked", G_CALLBACK(on_tab_close_clicked), browser);
-    g_object_set_data(G_OBJECT(close_button), "page-widget", scrolled_window);
+    g_object_set_data(G_OBJECT(close_button), "page-widget", tab->page);
+    
+    return tab;
+}
+
+void fr_browser_new_tab(FRBrowser *browser, const char *url) {
+    if (!browser) return;
+    
+    FRTab *tab = browser_add_tab(browser, 0, url ? url : DEFAULT_HOME_PAGE, NULL);
+    fr_tab_loader_request(browser->tab_loader, tab, FR_TAB_PRIORITY_FOREGROUND);
     
     // Switch to new tab
+    int page_num = gtk_notebook_page_num(GTK_NOTEBOOK(browser->notebook), tab->page);
     gtk_notebook_set_current_page(GTK_NOTEBOOK(browser->notebook), page_num);
-    browser->current_tab = page_num;
-    browser->tab_count++;
+    browser->tabs->current = tab;
+}
+
+FRTab* fr_browser_add_background_tab(FRBrowser *browser, guint id, const char *url,
+                                     const char *title, gboolean load) {
+    if (!browser || !url) return NULL;
     
-    // Load URL
-    webkit_web_view_load_uri(web_view, target_url);
+    FRTab *tab = browser_add_tab(browser, id, url, title);
+    if (load) {
+        fr_tab_loader_request(browser->tab_loader, tab, FR_TAB_PRIORITY_BACKGROUND);
+    }
+    return tab;
+}
+
+// Shows the popup's tab once WebKit has it ready
+static void on_popup_ready_to_show(WebKitWebView *web_view, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    FRTab *tab = fr_tab_model_lookup_view(browser->tabs, web_view);
+    if (!tab) return;
+    
+    fr_browser_switch_tab(browser, gtk_notebook_page_num(GTK_NOTEBOOK(browser->notebook), tab->page));
+}
+
+WebKitWebView* fr_browser_open_popup(FRBrowser *browser, WebKitWebView *opener, const char *url) {
+    if (!browser || !opener) return NULL;
     
-    gtk_widget_show_all(scrolled_window);
+    // WebKit loads the popup itself and needs it related to its opener, so
+    // it cannot be a spare; it runs in the opener's process, which is running
+    WebKitWebView *web_view = WEBKIT_WEB_VIEW(g_object_new(WEBKIT_TYPE_WEB_VIEW, "related-view", opener, NULL));
+    
+    FRTab *tab = browser_add_tab(browser, 0, url ? url : "about:blank", NULL);
+    browser_attach_web_view(browser, tab, web_view);
+    g_signal_connect(web_view, "ready-to-show", G_CALLBACK(on_popup_ready_to_show), browser);
+    
+    return web_view;
 }
 
 void fr_browser_close_tab(FRBrowser *browser, int tab_index) {
@@ -133,51 +252,102 @@ void fr_browser_close_tab(FRBrowser *browser, int tab_index) {
     
     GtkWidget *page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(browser->notebook), tab_index);
     if (page) {
+        FRTab *tab = fr_tab_get(page);
+        FRClosedTab *closed = fr_closed_tabs_push(browser->closed_tabs, tab, tab_index,
+                                                  fr_thumbnail_cache_lookup(browser->thumbnails, tab->id));
+        
+        // A web view kept for reopening must not reach the closed tab
+        if (closed && closed->web_view) {
+            g_signal_handlers_disconnect_by_data(closed->web_view, browser);
+            fr_tab_model_set_web_view(browser->tabs, tab, NULL);
+        }
+        
         gtk_notebook_remove_page(GTK_NOTEBOOK(browser->notebook), tab_index);
-        browser->tab_count--;
         
-        if (browser->tab_count == 0) {
+        if (gtk_notebook_get_n_pages(GTK_NOTEBOOK(browser->notebook)) == 0) {
             // Create a new tab if all tabs are closed
             fr_browser_new_tab(browser, DEFAULT_HOME_PAGE);
         } else {
-            // Update current tab index
-            int current = gtk_notebook_get_current_page(GTK_NOTEBOOK(browser->notebook));
-            browser->current_tab = current;
             fr_browser_update_ui(browser);
         }
     }
 }
 
+gboolean fr_browser_reopen_closed_tab(FRBrowser *browser) {
+    FRClosedTab *closed = browser ? fr_closed_tabs_pop(browser->closed_tabs) : NULL;
+    if (!closed) return FALSE;
+    
+    FRTab *tab = browser_add_tab(browser, closed->id, closed->url, closed->title);
+    gtk_notebook_reorder_child(GTK_NOTEBOOK(browser->notebook), tab->page, closed->position);
+    fr_thumbnail_cache_insert(browser->thumbnails, tab->id, closed->thumbnail);
+    
+    if (closed->web_view) {
+        // Still alive: it comes back exactly as it was, without loading anything
+        WebKitWebView *web_view = closed->web_view;
+        closed->web_view = NULL;
+        
+        browser_attach_web_view(browser, tab, web_view);
+        g_object_unref(web_view);
+        webkit_web_view_set_is_muted(web_view, closed->was_muted);
+        
+        // Media the throttler paused plays again now that the tab is shown
+        tab->throttled = closed->throttled;
+        fr_tab_throttler_resume(browser->tab_throttler, tab);
+        tab->can_go_back = webkit_web_view_can_go_back(web_view);
+        tab->can_go_forward = webkit_web_view_can_go_forward(web_view);
+    } else if (closed->session_state) {
+        // The loader restores the back/forward list and scroll position
+        tab->session_state = webkit_web_view_session_state_ref(closed->session_state);
+    }
+    
+    fr_closed_tab_free(closed);
+    fr_browser_switch_tab(browser, gtk_notebook_page_num(GTK_NOTEBOOK(browser->notebook), tab->page));
+    return TRUE;
+}
+
 void fr_browser_switch_tab(FRBrowser *browser, int tab_index) {
     if (!browser || tab_index < 0) return;
     
+    GtkWidget *page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(browser->notebook), tab_index);
+    FRTab *tab = fr_tab_get(page);
+    if (!tab) return;
+    
     gtk_notebook_set_current_page(GTK_NOTEBOOK(browser->notebook), tab_index);
-    browser->current_tab = tab_index;
+    browser->tabs->current = tab;
+    
+    // Also covers a restored tab that was selected before switches were watched
+    fr_tab_loader_request(browser->tab_loader, tab, FR_TAB_PRIORITY_FOREGROUND);
     fr_browser_update_ui(browser);
 }
 
 void fr_browser_update_ui(FRBrowser *browser) {
-    if (!browser || browser->current_tab < 0) return;
-    
-    GtkWidget *current_page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(browser->notebook), browser->current_tab);
-    if (current_page && GTK_IS_SCROLLED_WINDOW(current_page)) {
-        GtkWidget *child = gtk_bin_get_child(GTK_BIN(current_page));
-        if (child && WEBKIT_IS_WEB_VIEW(child)) {
-            WebKitWebView *web_view = WEBKIT_WEB_VIEW(child);
-            
-            // Update URL entry
-            const char *uri = webkit_web_view_get_uri(web_view);
-            if (uri) {
-                gtk_entry_set_text(GTK_ENTRY(browser->url_entry), uri);
-            }
-            
-            // Update navigation buttons
-            gboolean can_go_back = webkit_web_view_can_go_back(web_view);
-            gboolean can_go_forward = webkit_web_view_can_go_forward(web_view);
-            
-            gtk_widget_set_sensitive(browser->back_button, can_go_back);
-            gtk_widget_set_sensitive(browser->forward_button, can_go_forward);
-        }
+    FRTab *tab = browser ? browser->tabs->current : NULL;
+    if (!tab) return;
+    
+    // A placeholder shows where it will go
+    if (tab->url) {
+        fr_omnibox_set_text(browser->omnibox, tab->url);
     }
+    
+    // Update navigation buttons
+    gtk_widget_set_sensitive(browser->back_button, tab->can_go_back);
+    gtk_widget_set_sensitive(browser->forward_button, tab->can_go_forward);
 }
 
+void fr_browser_flush_ui(FRTab *tab, FRUiUpdate updates, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    
+    if (updates & FR_UI_UPDATE_LABEL) {
+        fr_tab_update_label(tab, tab->title);
+    }
+    
+    // Another tab may have been selected since
+    if (tab != browser->tabs->current) return;
+    
+    if (updates & FR_UI_UPDATE_TOOLBAR) {
+        fr_browser_update_ui(browser);
+    }
+    if (updates & FR_UI_UPDATE_WINDOW_TITLE) {
+        fr_window_update_title(browser, tab->title);
+    }
+}
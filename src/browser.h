@@ -3,6 +3,22 @@
 
 #include <gtk/gtk.h>
 #include <webkit2/webkit2.h>
+#include "bookmarks.h"
+#include "closedtabs.h"
+#include "discard.h"
+#include "favicon.h"
+#include "history.h"
+#include "omnibox.h"
+#include "overview.h"
+#include "session.h"
+#include "settings.h"
+#include "storage.h"
+#include "tabs.h"
+#include "thumbnail.h"
+#include "throttle.h"
+#include "uiupdate.h"
+#include "viewpool.h"
+#include "webcontext.h"
 
 #define FR_BROWSER_NAME "FR Browser"
 #define FR_BROWSER_VERSION "1.0.0"
@@ -19,24 +35,34 @@ typedef struct {
     GtkWidget *home_button;
     GtkWidget *new_tab_button;
     GtkWidget *menu_button;
+    FROmnibox *omnibox;
     
     // Menu items
     GtkWidget *bookmarks_menu;
     GtkWidget *history_menu;
     
-    // Current tab info
-    int current_tab;
-    int tab_count;
+    // Persistent data
+    FRSettings *settings;
+    FRStorage *storage;
+    FRHistoryManager *history_manager;
+    FRBookmarkManager *bookmark_manager;
+    FRFaviconCache *favicons;
+    FRThumbnailCache *thumbnails;
+    FRClosedTabs *closed_tabs;
+    GtkWidget *tab_preview;         // reused by every tab's hover preview
+    FRTabOverview *tab_overview;
+    FRTabLoader *tab_loader;
+    FRTabDiscarder *tab_discarder;
+    FRTabThrottler *tab_throttler;
+    FRSession *session;
+    WebKitWebContext *web_context;  // shared by every tab
+    FRWebViewPool *web_view_pool;
+    FRUiUpdater *ui_updater;
+    
+    // Open tabs and which one is selected
+    FRTabModel *tabs;
 } FRBrowser;
 
-typedef struct {
-    WebKitWebView *web_view;
-    GtkWidget *tab_label;
-    char *title;
-    char *url;
-    gboolean loading;
-} FRTab;
-
 // Function declarations
 FRBrowser* fr_browser_new(void);
 void fr_browser_free(FRBrowser *browser);
@@ -51,11 +77,24 @@ void fr_browser_go_home(FRBrowser *browser);
 
 // Tab management
 void fr_browser_new_tab(FRBrowser *browser, const char *url);
+// Adds a tab without selecting it; it stays a placeholder until selected
+// unless load is set, in which case it joins the background load queue.
+// id restores a saved tab's id; pass 0 for a new tab.
+FRTab* fr_browser_add_background_tab(FRBrowser *browser, guint id, const char *url,
+                                     const char *title, gboolean load);
+// Adds a tab for a page opened by opener and returns its web view for WebKit
+// to load; the tab is selected when the popup is ready to show
+WebKitWebView* fr_browser_open_popup(FRBrowser *browser, WebKitWebView *opener, const char *url);
+// Closing keeps the tab on the closed tabs stack
 void fr_browser_close_tab(FRBrowser *browser, int tab_index);
+// Reopens the most recently closed tab where it was; FALSE if there is none
+gboolean fr_browser_reopen_closed_tab(FRBrowser *browser);
 void fr_browser_switch_tab(FRBrowser *browser, int tab_index);
 
 // Utility functions
 char* fr_browser_sanitize_url(const char *input);
 void fr_browser_update_ui(FRBrowser *browser);
+// FRUiFlushFunc applying what the web view signals queued for tab
+void fr_browser_flush_ui(FRTab *tab, FRUiUpdate updates, gpointer user_data);
 
 #endif // BROWSER_H
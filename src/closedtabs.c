@@ -0,0 +1,97 @@
+#include "closedtabs.h"
+
+void fr_closed_tab_free(FRClosedTab *tab) {
+    if (!tab) return;
+    
+    if (tab->expire_source) {
+        g_source_remove(tab->expire_source);
+    }
+    if (tab->web_view) {
+        gtk_widget_destroy(GTK_WIDGET(tab->web_view));
+        g_object_unref(tab->web_view);
+    }
+    if (tab->session_state) {
+        webkit_web_view_session_state_unref(tab->session_state);
+    }
+    if (tab->thumbnail) {
+        cairo_surface_destroy(tab->thumbnail);
+    }
+    g_free(tab->url);
+    g_free(tab->title);
+    g_free(tab);
+}
+
+FRClosedTabs* fr_closed_tabs_new(guint max_tabs, guint keep_alive_sec) {
+    FRClosedTabs *closed = g_malloc0(sizeof(FRClosedTabs));
+    g_queue_init(&closed->tabs);
+    closed->max_tabs = max_tabs;
+    closed->keep_alive_sec = keep_alive_sec;
+    return closed;
+}
+
+void fr_closed_tabs_free(FRClosedTabs *closed) {
+    if (!closed) return;
+    
+    FRClosedTab *tab;
+    while ((tab = fr_closed_tabs_pop(closed)) != NULL) {
+        fr_closed_tab_free(tab);
+    }
+    g_free(closed);
+}
+
+// The session state is enough to come back from; the process can go
+static gboolean on_closed_tab_expire(gpointer user_data) {
+    FRClosedTab *tab = (FRClosedTab*)user_data;
+    
+    tab->expire_source = 0;
+    gtk_widget_destroy(GTK_WIDGET(tab->web_view));
+    g_object_unref(tab->web_view);
+    tab->web_view = NULL;
+    return G_SOURCE_REMOVE;
+}
+
+FRClosedTab* fr_closed_tabs_push(FRClosedTabs *closed, FRTab *tab, int position,
+                                 cairo_surface_t *thumbnail) {
+    if (!closed || !tab || !tab->url || closed->max_tabs == 0) return NULL;
+    
+    FRClosedTab *entry = g_malloc0(sizeof(FRClosedTab));
+    entry->id = tab->id;
+    entry->url = g_strdup(tab->url);
+    entry->title = g_strdup(tab->title);
+    entry->position = position;
+    entry->thumbnail = thumbnail ? cairo_surface_reference(thumbnail) : NULL;
+    entry->link.data = entry;
+    
+    // Discarded tabs still hold the state they had
+    if (tab->web_view) {
+        entry->session_state = webkit_web_view_get_session_state(tab->web_view);
+    } else if (tab->session_state) {
+        entry->session_state = webkit_web_view_session_state_ref(tab->session_state);
+    }
+    
+    if (tab->web_view && closed->keep_alive_sec > 0) {
+        entry->web_view = g_object_ref(tab->web_view);
+        entry->throttled = tab->throttled;
+        entry->was_muted = webkit_web_view_get_is_muted(tab->web_view);
+        gtk_container_remove(GTK_CONTAINER(tab->page), GTK_WIDGET(tab->web_view));
+        webkit_web_view_set_is_muted(entry->web_view, TRUE);
+        entry->expire_source = g_timeout_add_seconds(closed->keep_alive_sec, on_closed_tab_expire, entry);
+    }
+    
+    g_queue_push_head_link(&closed->tabs, &entry->link);
+    while (closed->tabs.length > closed->max_tabs) {
+        FRClosedTab *oldest = (FRClosedTab*)closed->tabs.tail->data;
+        g_queue_unlink(&closed->tabs, &oldest->link);
+        fr_closed_tab_free(oldest);
+    }
+    
+    return entry;
+}
+
+FRClosedTab* fr_closed_tabs_pop(FRClosedTabs *closed) {
+    if (!closed || !closed->tabs.head) return NULL;
+    
+    FRClosedTab *tab = (FRClosedTab*)closed->tabs.head->data;
+    g_queue_unlink(&closed->tabs, &tab->link);
+    return tab;
+}
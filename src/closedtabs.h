@@ -0,0 +1,44 @@
+#ifndef CLOSEDTABS_H
+#define CLOSEDTABS_H
+
+#include <gtk/gtk.h>
+#include <webkit2/webkit2.h>
+#include "tabs.h"
+
+// What is left of a closed tab. The session state is its back/forward list,
+// each entry with its scroll position, so a reopened tab comes back where
+// it was. For a while after closing, the web view itself is kept, muted and
+// out of the window, so undoing an accidental close loads nothing at all.
+typedef struct {
+    guint id;
+    char *url;
+    char *title;
+    int position;               // notebook page it had
+    WebKitWebViewSessionState *session_state;   // NULL if it never loaded
+    cairo_surface_t *thumbnail;
+    WebKitWebView *web_view;    // still alive, or NULL once the grace period is over
+    gboolean throttled;         // web_view's media was paused by the throttler
+    gboolean was_muted;         // web_view was muted before it was kept
+    guint expire_source;
+    GList link;                 // node in the stack, data is the closed tab
+} FRClosedTab;
+
+// The most recently closed tabs, newest first, at most max_tabs of them
+typedef struct {
+    GQueue tabs;                // FRClosedTab*
+    guint max_tabs;
+    guint keep_alive_sec;       // 0: web views are not kept
+} FRClosedTabs;
+
+FRClosedTabs* fr_closed_tabs_new(guint max_tabs, guint keep_alive_sec);
+void fr_closed_tabs_free(FRClosedTabs *closed);
+
+// Remembers tab, which is about to be closed; a web view that is kept is
+// taken out of the tab's page. Returns the entry, or NULL if none are kept.
+FRClosedTab* fr_closed_tabs_push(FRClosedTabs *closed, FRTab *tab, int position,
+                                 cairo_surface_t *thumbnail);
+// Takes the most recently closed tab off the stack; free it with fr_closed_tab_free
+FRClosedTab* fr_closed_tabs_pop(FRClosedTabs *closed);
+void fr_closed_tab_free(FRClosedTab *tab);
+
+#endif // CLOSEDTABS_H
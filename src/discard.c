@@ -0,0 +1,115 @@
+#include "discard.h"
+
+static gboolean tab_is_selected(FRTab *tab) {
+    GtkWidget *notebook = gtk_widget_get_parent(tab->page);
+    if (!notebook || !GTK_IS_NOTEBOOK(notebook)) return FALSE;
+    
+    return gtk_notebook_get_current_page(GTK_NOTEBOOK(notebook)) ==
+           gtk_notebook_page_num(GTK_NOTEBOOK(notebook), tab->page);
+}
+
+static gboolean tab_is_discardable(FRTab *tab) {
+    // Losing a page that is still loading or making sound would be noticed
+    if (!tab->web_view || tab->loading || tab_is_selected(tab)) return FALSE;
+    
+    return !webkit_web_view_is_playing_audio(tab->web_view);
+}
+
+static void tab_drop_web_view(FRTab *tab) {
+    if (tab->session_state) {
+        webkit_web_view_session_state_unref(tab->session_state);
+    }
+    tab->session_state = webkit_web_view_get_session_state(tab->web_view);
+    
+    gtk_widget_destroy(GTK_WIDGET(tab->web_view));
+    tab->web_view = NULL;
+    tab->discarded = TRUE;
+}
+
+// The thumbnail stands in for the page until the tab is selected again
+static void on_discard_thumbnail(FRTab *tab, cairo_surface_t *thumbnail, gpointer user_data) {
+    tab->discarding = FALSE;
+    
+    // The tab may have been selected or navigated since
+    if (tab_is_discardable(tab)) {
+        tab_drop_web_view(tab);
+    }
+}
+
+gboolean fr_tab_discard(FRTabDiscarder *discarder, FRTab *tab) {
+    if (!discarder || !tab || tab->discarding || !tab_is_discardable(tab)) return FALSE;
+    
+    tab->discarding = TRUE;
+    fr_thumbnail_cache_capture(discarder->thumbnails, tab, on_discard_thumbnail, NULL);
+    return TRUE;
+}
+
+static gint discard_compare_idle(gconstpointer a, gconstpointer b) {
+    const FRTab *tab_a = *(const FRTab**)a;
+    const FRTab *tab_b = *(const FRTab**)b;
+    
+    return (tab_a->last_active > tab_b->last_active) - (tab_a->last_active < tab_b->last_active);
+}
+
+guint fr_tab_discarder_discard_idle(FRTabDiscarder *discarder, gint64 min_idle_usec) {
+    if (!discarder) return 0;
+    
+    gint64 now = g_get_monotonic_time();
+    GPtrArray *candidates = g_ptr_array_new();
+    
+    int pages = gtk_notebook_get_n_pages(discarder->notebook);
+    for (int i = 0; i < pages; i++) {
+        FRTab *tab = fr_tab_get(gtk_notebook_get_nth_page(discarder->notebook, i));
+        if (tab && now - tab->last_active >= min_idle_usec && tab_is_discardable(tab)) {
+            g_ptr_array_add(candidates, tab);
+        }
+    }
+    g_ptr_array_sort(candidates, discard_compare_idle);
+    
+    guint discarded = 0;
+    for (guint i = 0; i < candidates->len; i++) {
+        if (fr_tab_discard(discarder, g_ptr_array_index(candidates, i))) {
+            discarded++;
+        }
+    }
+    
+    g_ptr_array_unref(candidates);
+    return discarded;
+}
+
+static void on_low_memory_warning(GMemoryMonitor *monitor, GMemoryMonitorWarningLevel level,
+                                  gpointer user_data) {
+    FRTabDiscarder *discarder = (FRTabDiscarder*)user_data;
+    gint64 min_idle_usec = FR_DISCARD_IDLE_LOW_USEC;
+    
+    if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL) {
+        min_idle_usec = FR_DISCARD_IDLE_CRITICAL_USEC;
+    } else if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM) {
+        min_idle_usec = FR_DISCARD_IDLE_MEDIUM_USEC;
+    }
+    
+    guint discarded = fr_tab_discarder_discard_idle(discarder, min_idle_usec);
+    if (discarded > 0) {
+        g_message("Memory pressure level %d: discarding %u background tabs", (int)level, discarded);
+    }
+}
+
+FRTabDiscarder* fr_tab_discarder_new(GtkNotebook *notebook, FRThumbnailCache *thumbnails) {
+    if (!notebook) return NULL;
+    
+    FRTabDiscarder *discarder = g_malloc0(sizeof(FRTabDiscarder));
+    discarder->notebook = notebook;
+    discarder->thumbnails = thumbnails;
+    discarder->monitor = g_memory_monitor_dup_default();
+    discarder->warning_handler = g_signal_connect(discarder->monitor, "low-memory-warning",
+                                                  G_CALLBACK(on_low_memory_warning), discarder);
+    return discarder;
+}
+
+void fr_tab_discarder_free(FRTabDiscarder *discarder) {
+    if (!discarder) return;
+    
+    g_signal_handler_disconnect(discarder->monitor, discarder->warning_handler);
+    g_object_unref(discarder->monitor);
+    g_free(discarder);
+}
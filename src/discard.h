@@ -0,0 +1,37 @@
+#ifndef DISCARD_H
+#define DISCARD_H
+
+#include <gtk/gtk.h>
+#include <glib.h>
+#include "tabs.h"
+#include "thumbnail.h"
+
+// How long a background tab must have been left alone before each memory
+// pressure level discards it
+#define FR_DISCARD_IDLE_LOW_USEC (10 * 60 * G_USEC_PER_SEC)
+#define FR_DISCARD_IDLE_MEDIUM_USEC (60 * G_USEC_PER_SEC)
+#define FR_DISCARD_IDLE_CRITICAL_USEC 0
+
+// Frees the web content of background tabs when the system runs short of
+// memory. GMemoryMonitor reports the pressure (from PSI on Linux); the
+// longer-unused tabs go first, and higher levels reach more recent ones.
+// A discarded tab keeps its session state, title, favicon and a fresh
+// thumbnail and is a placeholder again; the tab loader restores it, back/forward
+// list included, when it is next selected.
+typedef struct {
+    GtkNotebook *notebook;
+    FRThumbnailCache *thumbnails;
+    GMemoryMonitor *monitor;
+    gulong warning_handler;
+} FRTabDiscarder;
+
+FRTabDiscarder* fr_tab_discarder_new(GtkNotebook *notebook, FRThumbnailCache *thumbnails);
+void fr_tab_discarder_free(FRTabDiscarder *discarder);
+
+// Discards every background tab idle for at least min_idle_usec, oldest first;
+// returns how many were started
+guint fr_tab_discarder_discard_idle(FRTabDiscarder *discarder, gint64 min_idle_usec);
+// Captures tab's thumbnail, then drops its web view; FALSE if it cannot be discarded now
+gboolean fr_tab_discard(FRTabDiscarder *discarder, FRTab *tab);
+
+#endif // DISCARD_H
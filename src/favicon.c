@@ -0,0 +1,250 @@
+#include "favicon.h"
+#include <string.h>
+
+typedef struct {
+    FRFaviconReadyFunc func;
+    gpointer user_data;
+} FRFaviconWaiter;
+
+// One database lookup, shared by everyone asking for the same page meanwhile
+typedef struct {
+    FRFaviconCache *cache;
+    char *url;
+    GArray *waiters;        // FRFaviconWaiter
+} FRFaviconRequest;
+
+static void favicon_entry_free(FRFaviconEntry *entry) {
+    g_free(entry->url);
+    if (entry->icon) {
+        g_object_unref(entry->icon);
+    }
+    g_free(entry);
+}
+
+static void on_favicon_database_changed(WebKitFaviconDatabase *database, const char *page_uri,
+                                        const char *favicon_uri, gpointer user_data) {
+    FRFaviconCache *cache = (FRFaviconCache*)user_data;
+    FRFaviconEntry *entry = g_hash_table_lookup(cache->entries, page_uri);
+    
+    // Forget it; the next lookup fetches the new icon
+    if (entry) {
+        g_queue_unlink(&cache->lru, &entry->link);
+        g_hash_table_remove(cache->entries, page_uri);
+    }
+}
+
+FRFaviconCache* fr_favicon_cache_new(WebKitWebContext *context, guint capacity) {
+    if (!context) return NULL;
+    
+    FRFaviconCache *cache = g_malloc0(sizeof(FRFaviconCache));
+    cache->database = webkit_web_context_get_favicon_database(context);
+    cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                           (GDestroyNotify)favicon_entry_free);
+    g_queue_init(&cache->lru);
+    cache->capacity = capacity > 0 ? capacity : FR_FAVICON_CACHE_CAPACITY;
+    cache->pending = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->cancellable = g_cancellable_new();
+    cache->changed_handler = g_signal_connect(cache->database, "favicon-changed",
+                                              G_CALLBACK(on_favicon_database_changed), cache);
+    
+    return cache;
+}
+
+void fr_favicon_cache_free(FRFaviconCache *cache) {
+    if (!cache) return;
+    
+    // Lookups still in flight complete with no icon and free themselves
+    g_signal_handler_disconnect(cache->database, cache->changed_handler);
+    g_cancellable_cancel(cache->cancellable);
+    g_object_unref(cache->cancellable);
+    g_hash_table_destroy(cache->pending);
+    g_hash_table_destroy(cache->entries);
+    g_free(cache);
+}
+
+// Takes ownership of icon, which may be NULL to remember that there is none
+static GdkPixbuf* favicon_store(FRFaviconCache *cache, const char *url, GdkPixbuf *icon) {
+    FRFaviconEntry *entry = g_hash_table_lookup(cache->entries, url);
+    
+    if (entry) {
+        g_queue_unlink(&cache->lru, &entry->link);
+        if (entry->icon) {
+            g_object_unref(entry->icon);
+        }
+    } else {
+        entry = g_malloc0(sizeof(FRFaviconEntry));
+        entry->url = g_strdup(url);
+        entry->link.data = entry;
+        g_hash_table_insert(cache->entries, entry->url, entry);
+    }
+    entry->icon = icon;
+    g_queue_push_head_link(&cache->lru, &entry->link);
+    
+    while (cache->lru.length > cache->capacity) {
+        FRFaviconEntry *oldest = (FRFaviconEntry*)cache->lru.tail->data;
+        g_queue_unlink(&cache->lru, &oldest->link);
+        g_hash_table_remove(cache->entries, oldest->url);
+    }
+    
+    return icon;
+}
+
+static GdkPixbuf* favicon_scale_surface(cairo_surface_t *surface) {
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+    if (width <= 0 || height <= 0) return NULL;
+    
+    GdkPixbuf *pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, width, height);
+    if (!pixbuf || (width == FR_FAVICON_SIZE && height == FR_FAVICON_SIZE)) return pixbuf;
+    
+    GdkPixbuf *scaled = gdk_pixbuf_scale_simple(pixbuf, FR_FAVICON_SIZE, FR_FAVICON_SIZE,
+                                                GDK_INTERP_BILINEAR);
+    g_object_unref(pixbuf);
+    return scaled;
+}
+
+gboolean fr_favicon_cache_lookup(FRFaviconCache *cache, const char *url, GdkPixbuf **icon) {
+    if (!cache || !url) return FALSE;
+    
+    FRFaviconEntry *entry = g_hash_table_lookup(cache->entries, url);
+    if (!entry) return FALSE;
+    
+    g_queue_unlink(&cache->lru, &entry->link);
+    g_queue_push_head_link(&cache->lru, &entry->link);
+    
+    if (icon) {
+        *icon = entry->icon;
+    }
+    return TRUE;
+}
+
+GdkPixbuf* fr_favicon_cache_set_surface(FRFaviconCache *cache, const char *url,
+                                        cairo_surface_t *surface) {
+    if (!cache || !url) return NULL;
+    
+    return favicon_store(cache, url, surface ? favicon_scale_surface(surface) : NULL);
+}
+
+static void on_favicon_ready(GObject *source, GAsyncResult *result, gpointer user_data) {
+    FRFaviconRequest *request = (FRFaviconRequest*)user_data;
+    GError *error = NULL;
+    GdkPixbuf *icon = NULL;
+    
+    cairo_surface_t *surface = webkit_favicon_database_get_favicon_finish(
+        WEBKIT_FAVICON_DATABASE(source), result, &error);
+    
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        // The cache is gone; only the waiters are left to tell
+    } else {
+        g_hash_table_remove(request->cache->pending, request->url);
+        
+        // No icon is an answer too, so pages without one are not asked again
+        icon = favicon_store(request->cache, request->url,
+                             surface ? favicon_scale_surface(surface) : NULL);
+    }
+    
+    for (guint i = 0; i < request->waiters->len; i++) {
+        FRFaviconWaiter *waiter = &g_array_index(request->waiters, FRFaviconWaiter, i);
+        waiter->func(request->url, icon, waiter->user_data);
+    }
+    
+    if (surface) {
+        cairo_surface_destroy(surface);
+    }
+    g_clear_error(&error);
+    g_array_unref(request->waiters);
+    g_free(request->url);
+    g_free(request);
+}
+
+void fr_favicon_cache_load(FRFaviconCache *cache, const char *url, FRFaviconReadyFunc func,
+                           gpointer user_data) {
+    if (!func) return;
+    
+    GdkPixbuf *icon = NULL;
+    if (!cache || !url || fr_favicon_cache_lookup(cache, url, &icon)) {
+        func(url, icon, user_data);
+        return;
+    }
+    
+    FRFaviconWaiter waiter = { func, user_data };
+    FRFaviconRequest *request = g_hash_table_lookup(cache->pending, url);
+    if (request) {
+        g_array_append_val(request->waiters, waiter);
+        return;
+    }
+    
+    request = g_malloc0(sizeof(FRFaviconRequest));
+    request->cache = cache;
+    request->url = g_strdup(url);
+    request->waiters = g_array_new(FALSE, FALSE, sizeof(FRFaviconWaiter));
+    g_array_append_val(request->waiters, waiter);
+    g_hash_table_insert(cache->pending, request->url, request);
+    
+    webkit_favicon_database_get_favicon(cache->database, url, cache->cancellable,
+                                        on_favicon_ready, request);
+}
+
+static void on_favicon_image_ready(const char *url, GdkPixbuf *icon, gpointer user_data) {
+    GtkImage *image = GTK_IMAGE(user_data);
+    
+    // The image may have been pointed at another page meanwhile
+    if (g_strcmp0(g_object_get_data(G_OBJECT(image), "favicon-url"), url) == 0) {
+        gtk_image_set_from_pixbuf(image, icon);
+    }
+    g_object_unref(image);
+}
+
+void fr_favicon_cache_set_image(FRFaviconCache *cache, GtkImage *image, const char *url) {
+    if (!image) return;
+    
+    g_object_set_data_full(G_OBJECT(image), "favicon-url", g_strdup(url), g_free);
+    
+    GdkPixbuf *icon = NULL;
+    if (!cache || !url || fr_favicon_cache_lookup(cache, url, &icon)) {
+        gtk_image_set_from_pixbuf(image, icon);
+        return;
+    }
+    
+    gtk_image_clear(image);
+    fr_favicon_cache_load(cache, url, on_favicon_image_ready, g_object_ref(image));
+}
+
+GtkWidget* fr_favicon_menu_item_new(FRFaviconCache *cache, const char *url, const char *label) {
+    GtkWidget *item = gtk_menu_item_new();
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget *image = gtk_image_new();
+    GtkWidget *label_widget = gtk_label_new(label);
+    
+    // Keep labels aligned while icons are still being looked up
+    gtk_widget_set_size_request(image, FR_FAVICON_SIZE, FR_FAVICON_SIZE);
+    gtk_label_set_xalign(GTK_LABEL(label_widget), 0.0);
+    
+    gtk_box_pack_start(GTK_BOX(box), image, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(box), label_widget, TRUE, TRUE, 0);
+    gtk_container_add(GTK_CONTAINER(item), box);
+    gtk_widget_show_all(box);
+    
+    g_object_set_data(G_OBJECT(item), "icon", image);
+    g_object_set_data(G_OBJECT(item), "label", label_widget);
+    fr_favicon_cache_set_image(cache, GTK_IMAGE(image), url);
+    
+    return item;
+}
+
+void fr_favicon_menu_item_set_url(FRFaviconCache *cache, GtkWidget *item, const char *url) {
+    GtkWidget *image = g_object_get_data(G_OBJECT(item), "icon");
+    
+    if (image && g_strcmp0(g_object_get_data(G_OBJECT(image), "favicon-url"), url) != 0) {
+        fr_favicon_cache_set_image(cache, GTK_IMAGE(image), url);
+    }
+}
+
+GtkLabel* fr_favicon_menu_item_get_label(GtkWidget *item) {
+    GtkWidget *label = g_object_get_data(G_OBJECT(item), "label");
+    if (!label) {
+        label = gtk_bin_get_child(GTK_BIN(item));
+    }
+    
+    return GTK_IS_LABEL(label) ? GTK_LABEL(label) : NULL;
+}
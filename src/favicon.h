@@ -0,0 +1,55 @@
+#ifndef FAVICON_H
+#define FAVICON_H
+
+#include <gtk/gtk.h>
+#include <webkit2/webkit2.h>
+#include <glib.h>
+
+#define FR_FAVICON_SIZE 16
+#define FR_FAVICON_CACHE_CAPACITY 512
+
+// Called once per request; icon is NULL when the page has none (transfer none)
+typedef void (*FRFaviconReadyFunc)(const char *url, GdkPixbuf *icon, gpointer user_data);
+
+typedef struct {
+    char *url;
+    GdkPixbuf *icon;        // FR_FAVICON_SIZE square, NULL when the page has no favicon
+    GList link;             // node in the cache's lru, data is the entry
+} FRFaviconEntry;
+
+// Favicons by page URL, decoded and scaled to FR_FAVICON_SIZE once and then
+// shared by tabs, menus and suggestions. WebKit's favicon database under the
+// cache directory backs it; the most recently used icons stay in memory.
+typedef struct {
+    WebKitFaviconDatabase *database;
+    GHashTable *entries;    // page url -> FRFaviconEntry*
+    GQueue lru;             // FRFaviconEntry*, most recently used first
+    guint capacity;
+    GHashTable *pending;    // page url -> FRFaviconRequest*, database lookups in flight
+    GCancellable *cancellable;
+    gulong changed_handler;
+} FRFaviconCache;
+
+// Reads from context's favicon database, which fr_web_context_new enables
+FRFaviconCache* fr_favicon_cache_new(WebKitWebContext *context, guint capacity);
+void fr_favicon_cache_free(FRFaviconCache *cache);
+
+// Sets *icon and returns TRUE if url's icon, or its absence, is in memory
+gboolean fr_favicon_cache_lookup(FRFaviconCache *cache, const char *url, GdkPixbuf **icon);
+// Calls func right away from memory or else after a database lookup
+void fr_favicon_cache_load(FRFaviconCache *cache, const char *url, FRFaviconReadyFunc func,
+                           gpointer user_data);
+// Remembers the icon a web view reports for url and returns it scaled
+GdkPixbuf* fr_favicon_cache_set_surface(FRFaviconCache *cache, const char *url,
+                                        cairo_surface_t *surface);
+
+// Shows url's icon in image, now or once it has been looked up
+void fr_favicon_cache_set_image(FRFaviconCache *cache, GtkImage *image, const char *url);
+
+// Menu item with url's icon before label; the label is in "label"
+GtkWidget* fr_favicon_menu_item_new(FRFaviconCache *cache, const char *url, const char *label);
+void fr_favicon_menu_item_set_url(FRFaviconCache *cache, GtkWidget *item, const char *url);
+// The label of any menu item, plain or from fr_favicon_menu_item_new
+GtkLabel* fr_favicon_menu_item_get_label(GtkWidget *item);
+
+#endif // FAVICON_H
@@ -1,19 +1,111 @@
 #include "history.h"
 #include "utils.h"
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <json-glib/json-glib.h>
 
 #define MAX_HISTORY_ENTRIES 1000
+#define HISTORY_JOURNAL_COMPACT_SIZE (256 * 1024)
+#define HISTORY_SLAB_BLOCK_LENGTH 256
+// Snapshot or journal records loaded per idle iteration at startup
+#define HISTORY_LOAD_CHUNK 128
+// Entries added to the search index per idle iteration once loaded
+#define HISTORY_INDEX_CHUNK 256
+// Bytes of dropped titles and urls tolerated in the string pool before a save rebuilds it
+#define HISTORY_STRING_POOL_SLACK (256 * 1024)
 
-FRHistoryManager* fr_history_manager_new(void) {
+// Frecency: every visit adds a weight of 1 that halves each half-life. The sum
+// is kept as log(sum(exp(DECAY * visit_time))), which only grows with new
+// visits, so the ordering never goes stale and nothing needs rescoring as
+// time passes.
+#define FRECENCY_HALF_LIFE_DAYS 30.0
+#define FRECENCY_DECAY (M_LN2 / (FRECENCY_HALF_LIFE_DAYS * 24 * 60 * 60))
+
+static void history_ensure_loaded(FRHistoryManager *manager);
+
+static double frecency_add_visit(double frecency, time_t visited) {
+    double visit = FRECENCY_DECAY * (double)visited;
+    if (isinf(frecency)) return visit;
+    
+    // log(exp(a) + exp(b)) without overflowing
+    double high = MAX(frecency, visit);
+    double low = MIN(frecency, visit);
+    return high + log1p(exp(low - high));
+}
+
+// Seed for entries known only by their last visit and visit count
+static double frecency_estimate(time_t visited, int visit_count) {
+    return FRECENCY_DECAY * (double)visited + log(MAX(visit_count, 1));
+}
+
+double fr_history_entry_get_frecency(const FRHistoryEntry *entry, time_t now) {
+    if (!entry) return 0.0;
+    return exp(entry->frecency - FRECENCY_DECAY * (double)now);
+}
+
+typedef struct {
+    guint id;
+    FRHistoryChangedFunc func;
+    gpointer user_data;
+} FRHistoryObserver;
+
+// A visit made before the history finished loading
+typedef struct {
+    char *title;
+    char *url;
+    time_t visited;
+} FRHistoryVisit;
+
+static void history_visit_clear(gpointer data) {
+    FRHistoryVisit *visit = (FRHistoryVisit*)data;
+    g_free(visit->title);
+    g_free(visit->url);
+}
+
+// Most recent visit first; ids break ties so the order is stable
+static gint history_compare_recency(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const FRHistoryEntry *ea = (const FRHistoryEntry*)a;
+    const FRHistoryEntry *eb = (const FRHistoryEntry*)b;
+    
+    if (ea->visited != eb->visited) {
+        return ea->visited > eb->visited ? -1 : 1;
+    }
+    return (ea->id < eb->id) - (ea->id > eb->id);
+}
+
+// Highest frecency first; ids break ties so the order is stable
+static gint history_compare_rank(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const FRHistoryEntry *ea = (const FRHistoryEntry*)a;
+    const FRHistoryEntry *eb = (const FRHistoryEntry*)b;
+    
+    if (ea->frecency != eb->frecency) {
+        return ea->frecency > eb->frecency ? -1 : 1;
+    }
+    return (ea->id < eb->id) - (ea->id > eb->id);
+}
+
+FRHistoryManager* fr_history_manager_new(FRStorage *storage) {
     FRHistoryManager *manager = g_malloc0(sizeof(FRHistoryManager));
-    manager->entries = NULL;
+    manager->storage = storage;
+    manager->timeline = g_sequence_new(NULL);
+    manager->entry_slab = fr_slab_new(sizeof(FRHistoryEntry), HISTORY_SLAB_BLOCK_LENGTH);
+    manager->strings = fr_string_pool_new();
+    manager->url_index = g_hash_table_new(g_str_hash, g_str_equal);
+    manager->search_index = fr_trigram_index_new();
+    manager->ranking = g_sequence_new(NULL);
     manager->max_entries = MAX_HISTORY_ENTRIES;
+    manager->observers = g_array_new(FALSE, FALSE, sizeof(FRHistoryObserver));
+    manager->next_observer_id = 1;
+    manager->deferred = g_array_new(FALSE, FALSE, sizeof(FRHistoryVisit));
+    g_array_set_clear_func(manager->deferred, history_visit_clear);
     
     char *config_dir = fr_browser_get_config_dir();
     fr_browser_ensure_directory(config_dir);
-    manager->history_file = g_build_filename(config_dir, "history.json", NULL);
+    manager->history_file = g_build_filename(config_dir, "history.bin", NULL);
+    manager->legacy_file = g_build_filename(config_dir, "history.json", NULL);
+    manager->journal_file = g_build_filename(config_dir, "history.journal", NULL);
     g_free(config_dir);
     
     return manager;
@@ -22,8 +114,27 @@ FRHistoryManager* fr_history_manager_new(void) {
 void fr_history_manager_free(FRHistoryManager *manager) {
     if (!manager) return;
     
-    g_list_free_full(manager->entries, (GDestroyNotify)fr_history_entry_free);
+    if (manager->load_source) {
+        g_source_remove(manager->load_source);
+    }
+    if (manager->search_source) {
+        g_source_remove(manager->search_source);
+    }
+    g_free(manager->journal_data);
+    g_array_unref(manager->deferred);
+    g_hash_table_destroy(manager->url_index);
+    fr_trigram_index_free(manager->search_index);
+    g_sequence_free(manager->ranking);
+    g_sequence_free(manager->timeline);
+    g_array_unref(manager->observers);
+    fr_slab_free(manager->entry_slab);
+    fr_string_pool_free(manager->strings);
+    if (manager->snapshot) {
+        g_mapped_file_unref(manager->snapshot);
+    }
     g_free(manager->history_file);
+    g_free(manager->legacy_file);
+    g_free(manager->journal_file);
     g_free(manager);
 }
 
@@ -33,6 +144,7 @@ FRHistoryEntry* fr_history_entry_new(const char *title, const char *url) {
     entry->url = url ? g_strdup(url) : NULL;
     entry->visited = time(NULL);
     entry->visit_count = 1;
+    entry->frecency = frecency_estimate(entry->visited, entry->visit_count);
     
     return entry;
 }
@@ -42,166 +154,751 @@ void fr_history_entry_free(FRHistoryEntry *entry) {
     
     g_free(entry->title);
     g_free(entry->url);
+    g_free(entry->search_text);
     g_free(entry);
 }
 
-void fr_history_manager_add(FRHistoryManager *manager, const char *title, const char *url) {
-    if (!manager || !url) return;
+// A zeroed entry in the manager's slab; the caller fills it in and indexes it
+static FRHistoryEntry* history_alloc_entry(FRHistoryManager *manager) {
+    guint slot;
+    FRHistoryEntry *entry = fr_slab_alloc(manager->entry_slab, &slot);
+    entry->id = slot + 1;
+    return entry;
+}
+
+static FRHistoryEntry* history_new_entry(FRHistoryManager *manager, const char *title,
+                                         const char *url, time_t visited) {
+    FRHistoryEntry *entry = history_alloc_entry(manager);
+    entry->title = (char*)fr_string_pool_intern(manager->strings, title ? title : "Untitled");
+    entry->url = (char*)fr_string_pool_insert(manager->strings, url);
+    entry->visited = visited;
+    entry->visit_count = 1;
+    return entry;
+}
+
+static FRHistoryEntry* history_get_entry(FRHistoryManager *manager, guint id) {
+    if (id == 0 || id > manager->entry_slab->length) return NULL;
     
-    // Check if entry already exists
-    for (GList *l = manager->entries; l != NULL; l = l->next) {
-        FRHistoryEntry *entry = (FRHistoryEntry*)l->data;
-        if (entry && entry->url && strcmp(entry->url, url) == 0) {
-            // Update existing entry
-            entry->visited = time(NULL);
-            entry->visit_count++;
-            if (title && strcmp(entry->title, title) != 0) {
-                g_free(entry->title);
-                entry->title = g_strdup(title);
-            }
-            fr_history_manager_save(manager);
-            return;
+    FRHistoryEntry *entry = fr_slab_get(manager->entry_slab, id - 1);
+    return entry->url ? entry : NULL;
+}
+
+// Whether the index builder has passed the entry's slot. Slots allocated
+// after it finished are past search_next but indexed all the same.
+static gboolean history_is_searchable(FRHistoryManager *manager, FRHistoryEntry *entry) {
+    return manager->search_ready || entry->id <= manager->search_next;
+}
+
+// Entries materialized from the snapshot already carry their folded text
+static void history_index_text(FRHistoryManager *manager, FRHistoryEntry *entry) {
+    if (!entry->search_text) {
+        char *text = g_strconcat(entry->title ? entry->title : "", "\n", entry->url, NULL);
+        char *folded = fr_trigram_fold(text);
+        entry->search_text = (char*)fr_string_pool_insert(manager->strings, folded);
+        g_free(folded);
+        g_free(text);
+    }
+    
+    if (history_is_searchable(manager, entry)) {
+        fr_trigram_index_add(manager->search_index, entry->id, entry->search_text);
+    }
+}
+
+static void history_unindex_text(FRHistoryManager *manager, FRHistoryEntry *entry) {
+    if (history_is_searchable(manager, entry)) {
+        fr_trigram_index_remove(manager->search_index, entry->id, entry->search_text);
+    }
+    entry->search_text = NULL;
+}
+
+// Builds the trigram index a chunk of slots at a time once the history is
+// loaded. Slots below search_next are kept up to date as entries change; the
+// rest are picked up when the builder gets to them. Walking the slab rather
+// than the queue means slot order is id order, so every posting list is built
+// by appending.
+static gboolean on_history_index_idle(gpointer user_data) {
+    FRHistoryManager *manager = (FRHistoryManager*)user_data;
+    guint end = MIN(manager->search_next + HISTORY_INDEX_CHUNK, manager->entry_slab->length);
+    
+    for (; manager->search_next < end; manager->search_next++) {
+        FRHistoryEntry *entry = fr_slab_get(manager->entry_slab, manager->search_next);
+        if (entry->url) {
+            fr_trigram_index_add(manager->search_index, entry->id, entry->search_text);
         }
     }
+    if (manager->search_next < manager->entry_slab->length) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    manager->search_ready = TRUE;
+    manager->search_source = 0;
+    return G_SOURCE_REMOVE;
+}
+
+static void history_notify(FRHistoryManager *manager, FRHistoryChange change,
+                           FRHistoryEntry *entry, int old_position) {
+    for (guint i = 0; i < manager->observers->len; i++) {
+        FRHistoryObserver *observer = &g_array_index(manager->observers, FRHistoryObserver, i);
+        observer->func(manager, change, entry, old_position, observer->user_data);
+    }
+}
+
+// Positions cost a tree walk, so only look them up for observers
+static int history_position(FRHistoryManager *manager, FRHistoryEntry *entry) {
+    return manager->observers->len > 0 ? g_sequence_iter_get_position(entry->recency) : -1;
+}
+
+// Adds a filled-in entry to the timeline and every index
+static void history_index_entry(FRHistoryManager *manager, FRHistoryEntry *entry) {
+    manager->serial++;
+    g_hash_table_replace(manager->url_index, entry->url, entry);
+    history_index_text(manager, entry);
+    entry->rank = g_sequence_insert_sorted(manager->ranking, entry, history_compare_rank, NULL);
+    entry->recency = g_sequence_insert_sorted(manager->timeline, entry, history_compare_recency, NULL);
+    history_notify(manager, FR_HISTORY_CHANGE_INSERTED, entry, -1);
+}
+
+static void history_unindex_entry(FRHistoryManager *manager, FRHistoryEntry *entry) {
+    int position = history_position(manager, entry);
+    
+    manager->serial++;
+    g_sequence_remove(entry->recency);
+    entry->recency = NULL;
+    g_sequence_remove(entry->rank);
+    entry->rank = NULL;
+    history_unindex_text(manager, entry);
+    g_hash_table_remove(manager->url_index, entry->url);
+    history_notify(manager, FR_HISTORY_CHANGE_REMOVED, entry, position);
+}
+
+static void history_evict_oldest(FRHistoryManager *manager) {
+    while (g_sequence_get_length(manager->timeline) > manager->max_entries) {
+        GSequenceIter *last = g_sequence_iter_prev(g_sequence_get_end_iter(manager->timeline));
+        FRHistoryEntry *oldest = (FRHistoryEntry*)g_sequence_get(last);
+        history_unindex_entry(manager, oldest);
+        fr_slab_release(manager->entry_slab, oldest->id - 1);
+    }
+}
+
+FRHistoryEntry* fr_history_manager_lookup(FRHistoryManager *manager, const char *url) {
+    if (!manager || !url) return NULL;
+    
+    history_ensure_loaded(manager);
+    return g_hash_table_lookup(manager->url_index, url);
+}
+
+// Applies one visit to the in-memory history without touching disk. Shared by
+// live navigation and journal replay.
+static FRHistoryEntry* history_record_visit(FRHistoryManager *manager, const char *title,
+                                            const char *url, time_t visited) {
+    FRHistoryEntry *entry = g_hash_table_lookup(manager->url_index, url);
+    if (entry) {
+        // Update existing entry and move it to the front
+        int position = history_position(manager, entry);
+        entry->visited = visited;
+        entry->visit_count++;
+        entry->frecency = frecency_add_visit(entry->frecency, visited);
+        g_sequence_sort_changed(entry->rank, history_compare_rank, NULL);
+        manager->serial++;
+        if (title && strcmp(entry->title, title) != 0) {
+            history_unindex_text(manager, entry);
+            entry->title = (char*)fr_string_pool_intern(manager->strings, title);
+            history_index_text(manager, entry);
+        }
+        g_sequence_sort_changed(entry->recency, history_compare_recency, NULL);
+        history_notify(manager, FR_HISTORY_CHANGE_MOVED, entry, position);
+        return entry;
+    }
     
     // Add new entry
-    FRHistoryEntry *entry = fr_history_entry_new(title, url);
-    manager->entries = g_list_prepend(manager->entries, entry);
+    entry = history_new_entry(manager, title, url, visited);
+    entry->frecency = frecency_add_visit(-INFINITY, visited);
+    history_index_entry(manager, entry);
     
     // Limit history size
-    if (g_list_length(manager->entries) > manager->max_entries) {
-        GList *last = g_list_last(manager->entries);
-        if (last) {
-            fr_history_entry_free((FRHistoryEntry*)last->data);
-            manager->entries = g_list_delete_link(manager->entries, last);
-        }
+    history_evict_oldest(manager);
+    
+    return entry;
+}
+
+static void history_journal_append(FRHistoryManager *manager, const char *title, const char *url,
+                                   time_t visited) {
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "title");
+    json_builder_add_string_value(builder, title ? title : "");
+    json_builder_set_member_name(builder, "url");
+    json_builder_add_string_value(builder, url);
+    json_builder_set_member_name(builder, "visited");
+    json_builder_add_int_value(builder, (gint64)visited);
+    json_builder_set_member_name(builder, "seq");
+    json_builder_add_int_value(builder, (gint64)++manager->journal_seq);
+    json_builder_end_object(builder);
+    
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    
+    // One record per line; a record is only complete once its newline is out
+    GString *line = g_string_new(NULL);
+    char *record = json_generator_to_data(generator, NULL);
+    g_string_append(line, record);
+    g_string_append_c(line, '\n');
+    
+    fr_storage_append(manager->storage, manager->journal_file, line->str, line->len);
+    manager->journal_size += line->len;
+    
+    g_string_free(line, TRUE);
+    g_free(record);
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+    
+    if (manager->journal_size > HISTORY_JOURNAL_COMPACT_SIZE) {
+        fr_history_manager_save(manager);
     }
+}
+
+void fr_history_manager_add(FRHistoryManager *manager, const char *title, const char *url) {
+    if (!manager || !url) return;
     
-    fr_history_manager_save(manager);
+    time_t visited = time(NULL);
+    if (!manager->loaded) {
+        // Applied once loading catches up; the journal has it right away
+        FRHistoryVisit visit = { g_strdup(title), g_strdup(url), visited };
+        g_array_append_val(manager->deferred, visit);
+        history_journal_append(manager, title, url, visited);
+        return;
+    }
+    
+    FRHistoryEntry *entry = history_record_visit(manager, title, url, visited);
+    history_journal_append(manager, entry->title, entry->url, entry->visited);
 }
 
 void fr_history_manager_clear(FRHistoryManager *manager) {
     if (!manager) return;
     
-    g_list_free_full(manager->entries, (GDestroyNotify)fr_history_entry_free);
-    manager->entries = NULL;
+    history_ensure_loaded(manager);
+    g_hash_table_remove_all(manager->url_index);
+    fr_trigram_index_clear(manager->search_index);
+    g_sequence_remove_range(g_sequence_get_begin_iter(manager->ranking),
+                            g_sequence_get_end_iter(manager->ranking));
+    g_sequence_remove_range(g_sequence_get_begin_iter(manager->timeline),
+                            g_sequence_get_end_iter(manager->timeline));
+    manager->serial++;
+    fr_slab_clear(manager->entry_slab);
+    fr_string_pool_clear(manager->strings);
+    manager->strings_live = 0;
+    
+    // The empty index covers the empty slab, so a builder still running is done
+    if (manager->search_source) {
+        g_source_remove(manager->search_source);
+        manager->search_source = 0;
+    }
+    manager->search_next = 0;
+    manager->search_ready = TRUE;
+    history_notify(manager, FR_HISTORY_CHANGE_CLEARED, NULL, -1);
     fr_history_manager_save(manager);
 }
 
+GArray* fr_history_manager_find_candidates(FRHistoryManager *manager, const char *folded_query) {
+    if (!manager || !folded_query) return NULL;
+    
+    // Until the index is complete callers walk the ranking, as for short queries
+    history_ensure_loaded(manager);
+    if (!manager->search_ready) return NULL;
+    return fr_trigram_index_query(manager->search_index, folded_query);
+}
+
+FRHistoryEntry* fr_history_manager_get_entry(FRHistoryManager *manager, guint id) {
+    if (!manager) return NULL;
+    return history_get_entry(manager, id);
+}
+
+GSequence* fr_history_manager_get_timeline(FRHistoryManager *manager) {
+    if (!manager) return NULL;
+    
+    history_ensure_loaded(manager);
+    return manager->timeline;
+}
+
+guint fr_history_manager_connect_changed(FRHistoryManager *manager, FRHistoryChangedFunc func,
+                                         gpointer user_data) {
+    if (!manager || !func) return 0;
+    
+    FRHistoryObserver observer = { manager->next_observer_id++, func, user_data };
+    g_array_append_val(manager->observers, observer);
+    return observer.id;
+}
+
+void fr_history_manager_disconnect_changed(FRHistoryManager *manager, guint handler_id) {
+    if (!manager) return;
+    
+    for (guint i = 0; i < manager->observers->len; i++) {
+        if (g_array_index(manager->observers, FRHistoryObserver, i).id == handler_id) {
+            g_array_remove_index(manager->observers, i);
+            return;
+        }
+    }
+}
+
+static gint history_compare_rank_ptr(gconstpointer a, gconstpointer b) {
+    return history_compare_rank(*(FRHistoryEntry* const*)a, *(FRHistoryEntry* const*)b, NULL);
+}
+
 GList* fr_history_manager_search(FRHistoryManager *manager, const char *query) {
     if (!manager || !query) return NULL;
     
-    GList *results = NULL;
-    char *lower_query = g_utf8_strdown(query, -1);
+    char *folded_query = fr_trigram_fold(query);
+    GPtrArray *matches = g_ptr_array_new();
+    GArray *candidates = fr_history_manager_find_candidates(manager, folded_query);
     
-    for (GList *l = manager->entries; l != NULL; l = l->next) {
-        FRHistoryEntry *entry = (FRHistoryEntry*)l->data;
-        if (!entry) continue;
-        
-        char *lower_title = entry->title ? g_utf8_strdown(entry->title, -1) : NULL;
-        char *lower_url = entry->url ? g_utf8_strdown(entry->url, -1) : NULL;
-        
-        gboolean match = FALSE;
-        if (lower_title && strstr(lower_title, lower_query)) {
-            match = TRUE;
-        } else if (lower_url && strstr(lower_url, lower_query)) {
-            match = TRUE;
+    if (candidates) {
+        for (guint i = 0; i < candidates->len; i++) {
+            FRHistoryEntry *entry = history_get_entry(manager, g_array_index(candidates, guint, i));
+            if (entry && strstr(entry->search_text, folded_query)) {
+                g_ptr_array_add(matches, entry);
+            }
         }
-        
-        if (match) {
-            results = g_list_append(results, entry);
+        g_array_unref(candidates);
+        g_ptr_array_sort(matches, history_compare_rank_ptr);
+    } else {
+        // Too short for trigrams, or the index is still being built; walk the
+        // ranking so the result is already ordered. The folded text is cached
+        // so this stays allocation free.
+        for (GSequenceIter *iter = g_sequence_get_begin_iter(manager->ranking);
+             !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter)) {
+            FRHistoryEntry *entry = (FRHistoryEntry*)g_sequence_get(iter);
+            if (strstr(entry->search_text, folded_query)) {
+                g_ptr_array_add(matches, entry);
+            }
         }
-        
-        g_free(lower_title);
-        g_free(lower_url);
     }
     
-    g_free(lower_query);
+    GList *results = NULL;
+    for (guint i = matches->len; i > 0; i--) {
+        results = g_list_prepend(results, g_ptr_array_index(matches, i - 1));
+    }
+    
+    g_ptr_array_unref(matches);
+    g_free(folded_query);
     return results;
 }
 
 GList* fr_history_manager_get_recent(FRHistoryManager *manager, int count) {
     if (!manager) return NULL;
     
+    history_ensure_loaded(manager);
     GList *recent = NULL;
     int added = 0;
     
-    for (GList *l = manager->entries; l != NULL && added < count; l = l->next) {
-        recent = g_list_append(recent, l->data);
+    for (GSequenceIter *iter = g_sequence_get_begin_iter(manager->timeline);
+         !g_sequence_iter_is_end(iter) && added < count;
+         iter = g_sequence_iter_next(iter)) {
+        recent = g_list_prepend(recent, g_sequence_get(iter));
         added++;
     }
     
-    return recent;
+    return g_list_reverse(recent);
 }
 
-gboolean fr_history_manager_load(FRHistoryManager *manager) {
-    if (!manager || !manager->history_file) return FALSE;
+GList* fr_history_manager_get_top(FRHistoryManager *manager, int count) {
+    if (!manager) return NULL;
+    
+    history_ensure_loaded(manager);
+    GList *top = NULL;
+    int added = 0;
     
-    if (!g_file_test(manager->history_file, G_FILE_TEST_EXISTS)) {
+    for (GSequenceIter *iter = g_sequence_get_begin_iter(manager->ranking);
+         !g_sequence_iter_is_end(iter) && added < count;
+         iter = g_sequence_iter_next(iter)) {
+        top = g_list_prepend(top, g_sequence_get(iter));
+        added++;
+    }
+    
+    return g_list_reverse(top);
+}
+
+// Each element of the array is materialized as soon as its object closes, so
+// peak memory is one record plus the entries themselves
+static void history_load_record(FRJsonRecord *record, gpointer user_data) {
+    FRHistoryManager *manager = (FRHistoryManager*)user_data;
+    const char *title = fr_json_record_get_string(record, "title");
+    const char *url = fr_json_record_get_string(record, "url");
+    
+    if (!url || g_hash_table_contains(manager->url_index, url)) return;
+    
+    FRHistoryEntry *entry = history_new_entry(manager, title, url, time(NULL));
+    entry->visited = (time_t)fr_json_record_get_int(record, "visited", entry->visited);
+    entry->visit_count = (int)fr_json_record_get_int(record, "visit_count", entry->visit_count);
+    entry->frecency = fr_json_record_has(record, "frecency")
+        ? fr_json_record_get_double(record, "frecency", 0)
+        : frecency_estimate(entry->visited, entry->visit_count);
+    history_index_entry(manager, entry);
+}
+
+static gboolean history_load_json(FRHistoryManager *manager, const char *path) {
+    if (!g_file_test(path, G_FILE_TEST_EXISTS)) {
         return TRUE; // No file exists yet, that's OK
     }
     
-    GError *error = NULL;
+    FRJsonStream *stream = fr_json_stream_new_for_records(history_load_record, manager);
+    gboolean success = fr_json_stream_parse_file(stream, path, NULL);
+    fr_json_stream_free(stream);
+    
+    history_evict_oldest(manager);
+    return success;
+}
+
+static JsonObject* history_parse_journal_line(JsonParser *parser, const char *line, gsize length) {
+    if (length == 0 || !json_parser_load_from_data(parser, line, length, NULL)) return NULL;
+    
+    JsonNode *root = json_parser_get_root(parser);
+    return JSON_NODE_HOLDS_OBJECT(root) ? json_node_get_object(root) : NULL;
+}
+
+// Reads the journal at startup, before anything is appended to it. A final
+// line without its newline is a torn write and is cut off so later appends
+// start on a clean record. Only the last record is parsed here, for the
+// sequence number new visits continue from; the rest is replayed once the
+// snapshot is in memory.
+static void history_read_journal(FRHistoryManager *manager) {
     char *contents;
     gsize length;
     
-    if (!g_file_get_contents(manager->history_file, &contents, &length, &error)) {
-        g_error_free(error);
-        return FALSE;
+    if (!g_file_get_contents(manager->journal_file, &contents, &length, NULL)) {
+        return; // No journal yet
+    }
+    
+    gsize complete = length;
+    while (complete > 0 && contents[complete - 1] != '\n') {
+        complete--;
     }
+    if (complete < length && truncate(manager->journal_file, complete) != 0) {
+        g_warning("Could not drop torn record from %s", manager->journal_file);
+    }
+    
+    manager->journal_data = contents;
+    manager->journal_length = complete;
+    manager->journal_offset = 0;
+    manager->journal_size = complete;
     
+    // Records are appended in sequence, so the last readable one has the
+    // highest number, or none if the journal predates them
     JsonParser *parser = json_parser_new();
-    if (!json_parser_load_from_data(parser, contents, length, &error)) {
-        g_free(contents);
-        g_object_unref(parser);
-        g_error_free(error);
-        return FALSE;
+    gsize end = complete;
+    while (end > 0) {
+        gsize start = end - 1;
+        while (start > 0 && contents[start - 1] != '\n') {
+            start--;
+        }
+        
+        JsonObject *record = history_parse_journal_line(parser, contents + start, end - 1 - start);
+        if (record) {
+            guint64 seq = (guint64)json_object_get_int_member_with_default(record, "seq", 0);
+            manager->journal_seq = MAX(manager->journal_seq, seq);
+            break;
+        }
+        end = start;
     }
+    g_object_unref(parser);
+}
+
+// The journal is truncated right after a snapshot is written, so a crash in
+// between leaves records behind that the snapshot already counts; their
+// sequence numbers are not above the snapshot's. Records from before sequence
+// numbers fall back to comparing visit times.
+static void history_replay_record(FRHistoryManager *manager, JsonObject *record) {
+    const char *title = json_object_get_string_member_with_default(record, "title", NULL);
+    const char *url = json_object_get_string_member_with_default(record, "url", NULL);
+    time_t visited = (time_t)json_object_get_int_member_with_default(record, "visited", 0);
+    guint64 seq = (guint64)json_object_get_int_member_with_default(record, "seq", 0);
     
-    JsonNode *root = json_parser_get_root(parser);
-    if (!JSON_NODE_HOLDS_ARRAY(root)) {
-        g_free(contents);
-        g_object_unref(parser);
+    if (!url) return;
+    
+    gboolean replay;
+    if (seq > 0) {
+        replay = seq > manager->snapshot_seq;
+    } else {
+        FRHistoryEntry *existing = g_hash_table_lookup(manager->url_index, url);
+        replay = !existing || visited > existing->visited;
+    }
+    
+    if (replay) {
+        history_record_visit(manager, title, url, visited);
+    }
+}
+
+// Replays up to budget journal records read at startup; TRUE once all are in
+static gboolean history_replay_journal(FRHistoryManager *manager, guint budget) {
+    if (!manager->journal_data) return TRUE;
+    
+    JsonParser *parser = json_parser_new();
+    while (manager->journal_offset < manager->journal_length && budget-- > 0) {
+        const char *line = manager->journal_data + manager->journal_offset;
+        const char *newline = memchr(line, '\n', manager->journal_length - manager->journal_offset);
+        gsize line_length = newline - line;
+        
+        JsonObject *record = history_parse_journal_line(parser, line, line_length);
+        if (record) {
+            history_replay_record(manager, record);
+        }
+        manager->journal_offset += line_length + 1;
+    }
+    g_object_unref(parser);
+    
+    if (manager->journal_offset < manager->journal_length) return FALSE;
+    
+    g_free(manager->journal_data);
+    manager->journal_data = NULL;
+    return TRUE;
+}
+
+// Binary snapshot layout, native byte order:
+//   FRHistoryFileHeader
+//   FRHistoryFileRecord[record_count], most recently visited first
+//   string blob of NUL terminated titles, urls and folded search text
+// Version 1 headers end before journal_seq.
+#define HISTORY_FILE_MAGIC "FRHS"
+#define HISTORY_FILE_VERSION 2
+#define HISTORY_FILE_BYTE_ORDER 0x01020304
+
+typedef struct {
+    char magic[4];
+    guint32 version;
+    guint32 byte_order;
+    guint32 record_count;
+    guint64 blob_offset;
+    guint64 blob_size;
+    guint64 journal_seq;    // last journal record the snapshot includes
+} FRHistoryFileHeader;
+
+#define HISTORY_FILE_HEADER_V1_SIZE ((gsize)G_STRUCT_OFFSET(FRHistoryFileHeader, journal_seq))
+
+typedef struct {
+    guint32 title_offset;
+    guint32 url_offset;
+    guint32 search_text_offset;
+    gint32 visit_count;
+    gint64 visited;
+    double frecency;
+} FRHistoryFileRecord;
+
+// Maps the snapshot and checks its header; nothing is materialized yet
+static gboolean history_map_snapshot(FRHistoryManager *manager) {
+    GMappedFile *mapped = g_mapped_file_new(manager->history_file, FALSE, NULL);
+    if (!mapped) return FALSE;
+    
+    gsize size = g_mapped_file_get_length(mapped);
+    const char *data = g_mapped_file_get_contents(mapped);
+    const FRHistoryFileHeader *header = (const FRHistoryFileHeader*)data;
+    
+    gsize header_size = size >= HISTORY_FILE_HEADER_V1_SIZE && header->version == 1
+                        ? HISTORY_FILE_HEADER_V1_SIZE : sizeof(FRHistoryFileHeader);
+    
+    gboolean valid = size >= header_size &&
+                     memcmp(header->magic, HISTORY_FILE_MAGIC, 4) == 0 &&
+                     (header->version == 1 || header->version == HISTORY_FILE_VERSION) &&
+                     header->byte_order == HISTORY_FILE_BYTE_ORDER &&
+                     header->blob_offset == header_size +
+                                            (guint64)header->record_count * sizeof(FRHistoryFileRecord) &&
+                     header->blob_offset + header->blob_size == size &&
+                     (header->blob_size == 0 || data[size - 1] == '\0');
+    
+    if (!valid) {
+        g_warning("Ignoring damaged history snapshot %s", manager->history_file);
+        g_mapped_file_unref(mapped);
         return FALSE;
     }
     
-    JsonArray *array = json_node_get_array(root);
-    guint length_array = json_array_get_length(array);
+    manager->snapshot = mapped;
+    manager->snapshot_seq = header->version >= 2 ? header->journal_seq : 0;
+    manager->journal_seq = manager->snapshot_seq;
+    return TRUE;
+}
+
+// Creates entries for up to budget snapshot records; TRUE once all are in.
+// Strings are borrowed from the mapping, folded search text included, so this
+// is a slab slot per entry and no parsing.
+static gboolean history_materialize_snapshot(FRHistoryManager *manager, guint budget) {
+    if (!manager->snapshot) return TRUE;
+    
+    const char *data = g_mapped_file_get_contents(manager->snapshot);
+    const FRHistoryFileHeader *header = (const FRHistoryFileHeader*)data;
+    const char *blob = data + header->blob_offset;
+    const FRHistoryFileRecord *records = (const FRHistoryFileRecord*)blob - header->record_count;
     
-    for (guint i = 0; i < length_array; i++) {
-        JsonNode *element = json_array_get_element(array, i);
-        if (!JSON_NODE_HOLDS_OBJECT(element)) continue;
+    for (; manager->load_next < header->record_count && budget > 0; manager->load_next++, budget--) {
+        const FRHistoryFileRecord *record = &records[manager->load_next];
+        if (record->title_offset >= header->blob_size ||
+            record->url_offset >= header->blob_size ||
+            record->search_text_offset >= header->blob_size) {
+            continue;
+        }
         
-        JsonObject *obj = json_node_get_object(element);
-        const char *title = json_object_get_string_member(obj, "title");
-        const char *url = json_object_get_string_member(obj, "url");
+        const char *url = blob + record->url_offset;
+        if (*url == '\0' || g_hash_table_contains(manager->url_index, url)) continue;
         
-        if (url) {
-            FRHistoryEntry *entry = fr_history_entry_new(title, url);
-            if (json_object_has_member(obj, "visited")) {
-                entry->visited = (time_t)json_object_get_int_member(obj, "visited");
-            }
-            if (json_object_has_member(obj, "visit_count")) {
-                entry->visit_count = json_object_get_int_member(obj, "visit_count");
-            }
-            manager->entries = g_list_append(manager->entries, entry);
-        }
+        FRHistoryEntry *entry = history_alloc_entry(manager);
+        entry->title = (char*)(blob + record->title_offset);
+        entry->url = (char*)url;
+        entry->search_text = (char*)(blob + record->search_text_offset);
+        entry->visited = (time_t)record->visited;
+        entry->visit_count = record->visit_count;
+        entry->frecency = record->frecency;
+        history_index_entry(manager, entry);
     }
     
-    g_free(contents);
-    g_object_unref(parser);
+    if (manager->load_next < header->record_count) return FALSE;
+    
+    history_evict_oldest(manager);
     return TRUE;
 }
 
-gboolean fr_history_manager_save(FRHistoryManager *manager) {
+// Loads up to budget snapshot records and journal records, in that order.
+// Once both are in, the visits made meanwhile are applied on top.
+static gboolean history_load_step(FRHistoryManager *manager, guint budget) {
+    if (!history_materialize_snapshot(manager, budget) || !history_replay_journal(manager, budget)) {
+        return FALSE;
+    }
+    
+    manager->loaded = TRUE;
+    for (guint i = 0; i < manager->deferred->len; i++) {
+        FRHistoryVisit *visit = &g_array_index(manager->deferred, FRHistoryVisit, i);
+        history_record_visit(manager, visit->title, visit->url, visit->visited);
+    }
+    g_array_set_size(manager->deferred, 0);
+    
+    manager->search_source = g_idle_add_full(G_PRIORITY_LOW, on_history_index_idle, manager, NULL);
+    return TRUE;
+}
+
+static gboolean on_history_load_idle(gpointer user_data) {
+    FRHistoryManager *manager = (FRHistoryManager*)user_data;
+    
+    if (!history_load_step(manager, HISTORY_LOAD_CHUNK)) {
+        return G_SOURCE_CONTINUE;
+    }
+    manager->load_source = 0;
+    return G_SOURCE_REMOVE;
+}
+
+// Startup only maps the snapshot and reads the journal; entries are loaded a
+// chunk at a time when the main loop is idle. A query that comes first
+// finishes whatever is left.
+static void history_ensure_loaded(FRHistoryManager *manager) {
+    if (manager->loaded) return;
+    
+    if (manager->load_source) {
+        g_source_remove(manager->load_source);
+        manager->load_source = 0;
+    }
+    history_load_step(manager, G_MAXUINT);
+}
+
+gboolean fr_history_manager_load(FRHistoryManager *manager) {
     if (!manager || !manager->history_file) return FALSE;
     
+    gboolean mapped = history_map_snapshot(manager);
+    history_read_journal(manager);
+    
+    // No usable binary snapshot: migrate history.json from older versions
+    if (!mapped && g_file_test(manager->legacy_file, G_FILE_TEST_EXISTS)) {
+        gboolean success = history_load_json(manager, manager->legacy_file);
+        history_ensure_loaded(manager);
+        if (success) {
+            fr_history_manager_save(manager);
+        }
+        return success;
+    }
+    
+    manager->load_source = g_idle_add_full(G_PRIORITY_LOW, on_history_load_idle, manager, NULL);
+    return TRUE;
+}
+
+gboolean fr_history_manager_import_json(FRHistoryManager *manager, const char *path) {
+    if (!manager || !path) return FALSE;
+    
+    history_ensure_loaded(manager);
+    if (!history_load_json(manager, path)) {
+        return FALSE;
+    }
+    
+    return fr_history_manager_save(manager);
+}
+
+typedef struct {
+    FRHistoryManager *manager;
+    FRJsonProgressFunc progress;
+    FRJsonDoneFunc done;
+    gpointer user_data;
+} FRHistoryImportJob;
+
+static void history_import_progress(goffset bytes_read, goffset total, gpointer user_data) {
+    FRHistoryImportJob *job = (FRHistoryImportJob*)user_data;
+    
+    if (job->progress) {
+        job->progress(bytes_read, total, job->user_data);
+    }
+}
+
+static void history_import_done(gboolean success, const GError *error, gpointer user_data) {
+    FRHistoryImportJob *job = (FRHistoryImportJob*)user_data;
+    
+    history_evict_oldest(job->manager);
+    if (success) {
+        success = fr_history_manager_save(job->manager);
+    }
+    if (job->done) {
+        job->done(success, error, job->user_data);
+    }
+    g_free(job);
+}
+
+// Parses the file a chunk at a time from the main loop so large imports don't
+// stall the UI. done is called exactly once.
+guint fr_history_manager_import_json_async(FRHistoryManager *manager, const char *path,
+                                           FRJsonProgressFunc progress,
+                                           FRJsonDoneFunc done,
+                                           gpointer user_data) {
+    if (!manager || !path) return 0;
+    
+    history_ensure_loaded(manager);
+    
+    FRHistoryImportJob *job = g_malloc0(sizeof(FRHistoryImportJob));
+    job->manager = manager;
+    job->progress = progress;
+    job->done = done;
+    job->user_data = user_data;
+    
+    FRJsonStream *stream = fr_json_stream_new_for_records(history_load_record, manager);
+    return fr_json_stream_parse_file_async(stream, path, history_import_progress,
+                                           history_import_done, job);
+}
+
+// Private copy of the entries for the storage thread: one array of records
+// and one chunk of strings, whatever the number of entries
+typedef struct {
+    GArray *entries;        // FRHistoryEntry, most recently visited first
+    GStringChunk *strings;
+    guint64 journal_seq;
+} FRHistorySnapshot;
+
+static void history_snapshot_free(FRHistorySnapshot *snapshot) {
+    g_array_unref(snapshot->entries);
+    g_string_chunk_free(snapshot->strings);
+    g_free(snapshot);
+}
+
+// Serializers run on the storage thread; the snapshot is a private copy of the entries
+static char* history_serialize_json(gpointer snapshot, gsize *length) {
+    GArray *entries = ((FRHistorySnapshot*)snapshot)->entries;
+    
     JsonBuilder *builder = json_builder_new();
     json_builder_begin_array(builder);
     
-    for (GList *l = manager->entries; l != NULL; l = l->next) {
-        FRHistoryEntry *entry = (FRHistoryEntry*)l->data;
-        if (!entry) continue;
+    for (guint i = 0; i < entries->len; i++) {
+        FRHistoryEntry *entry = &g_array_index(entries, FRHistoryEntry, i);
         
         json_builder_begin_object(builder);
         
@@ -217,6 +914,9 @@ gboolean fr_history_manager_save(FRHistoryManager *manager) {
         json_builder_set_member_name(builder, "visit_count");
         json_builder_add_int_value(builder, entry->visit_count);
         
+        json_builder_set_member_name(builder, "frecency");
+        json_builder_add_double_value(builder, entry->frecency);
+        
         json_builder_end_object(builder);
     }
     
@@ -227,122 +927,307 @@ gboolean fr_history_manager_save(FRHistoryManager *manager) {
     json_generator_set_root(generator, root);
     json_generator_set_pretty(generator, TRUE);
     
-    char *json_data = json_generator_to_data(generator, NULL);
-    
-    GError *error = NULL;
-    gboolean success = g_file_set_contents(manager->history_file, json_data, -1, &error);
+    char *json_data = json_generator_to_data(generator, length);
     
-    if (error) {
-        g_error_free(error);
-        success = FALSE;
-    }
-    
-    g_free(json_data);
     json_node_free(root);
     g_object_unref(generator);
     g_object_unref(builder);
     
-    return success;
+    return json_data;
 }
 
-GtkWidget* fr_history_create_menu(FRHistoryManager *manager) {
-    GtkWidget *menu = gtk_menu_new();
+static guint32 history_blob_add(GString *blob, const char *text) {
+    guint32 offset = (guint32)blob->len;
+    g_string_append_len(blob, text ? text : "", text ? strlen(text) + 1 : 1);
+    return offset;
+}
+
+static char* history_serialize_binary(gpointer data, gsize *length) {
+    FRHistorySnapshot *snapshot = (FRHistorySnapshot*)data;
+    GArray *entries = snapshot->entries;
+    GString *blob = g_string_new(NULL);
+    gsize records_size = entries->len * sizeof(FRHistoryFileRecord);
+    FRHistoryFileRecord *records = g_malloc0(records_size);
+    
+    for (guint i = 0; i < entries->len; i++) {
+        FRHistoryEntry *entry = &g_array_index(entries, FRHistoryEntry, i);
+        FRHistoryFileRecord *record = &records[i];
+        
+        record->title_offset = history_blob_add(blob, entry->title);
+        record->url_offset = history_blob_add(blob, entry->url);
+        record->search_text_offset = history_blob_add(blob, entry->search_text);
+        record->visit_count = entry->visit_count;
+        record->visited = (gint64)entry->visited;
+        record->frecency = entry->frecency;
+    }
     
-    if (!manager) return menu;
+    FRHistoryFileHeader header = { 0 };
+    memcpy(header.magic, HISTORY_FILE_MAGIC, 4);
+    header.version = HISTORY_FILE_VERSION;
+    header.byte_order = HISTORY_FILE_BYTE_ORDER;
+    header.record_count = entries->len;
+    header.blob_offset = sizeof(header) + records_size;
+    header.blob_size = blob->len;
+    header.journal_seq = snapshot->journal_seq;
     
-    GList *recent = fr_history_manager_get_recent(manager, 10);
+    *length = sizeof(header) + records_size + blob->len;
+    char *file = g_malloc(*length);
+    memcpy(file, &header, sizeof(header));
+    memcpy(file + sizeof(header), records, records_size);
+    memcpy(file + header.blob_offset, blob->str, blob->len);
     
-    for (GList *l = recent; l != NULL; l = l->next) {
-        FRHistoryEntry *entry = (FRHistoryEntry*)l->data;
-        if (!entry) continue;
+    g_free(records);
+    g_string_free(blob, TRUE);
+    return file;
+}
+
+static FRHistorySnapshot* history_copy_entries(FRHistoryManager *manager) {
+    FRHistorySnapshot *snapshot = g_malloc0(sizeof(FRHistorySnapshot));
+    snapshot->entries = g_array_sized_new(FALSE, TRUE, sizeof(FRHistoryEntry),
+                                          g_sequence_get_length(manager->timeline));
+    snapshot->strings = g_string_chunk_new(64 * 1024);
+    snapshot->journal_seq = manager->journal_seq;
+    
+    for (GSequenceIter *iter = g_sequence_get_begin_iter(manager->timeline);
+         !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter)) {
+        FRHistoryEntry *entry = (FRHistoryEntry*)g_sequence_get(iter);
+        FRHistoryEntry copy = { 0 };
         
-        GtkWidget *item = gtk_menu_item_new_with_label(entry->title);
-        g_object_set_data_full(G_OBJECT(item), "history-url", 
-                              g_strdup(entry->url), g_free);
+        copy.title = g_string_chunk_insert(snapshot->strings, entry->title ? entry->title : "");
+        copy.url = g_string_chunk_insert(snapshot->strings, entry->url);
+        copy.search_text = entry->search_text ? g_string_chunk_insert(snapshot->strings, entry->search_text) : NULL;
+        copy.visited = entry->visited;
+        copy.visit_count = entry->visit_count;
+        copy.frecency = entry->frecency;
+        g_array_append_val(snapshot->entries, copy);
+    }
+    
+    return snapshot;
+}
+
+static gboolean history_is_mapped(FRHistoryManager *manager, const char *string) {
+    if (!manager->snapshot) return FALSE;
+    
+    const char *data = g_mapped_file_get_contents(manager->snapshot);
+    return string >= data && string < data + g_mapped_file_get_length(manager->snapshot);
+}
+
+// Titles and urls dropped by eviction or renames stay in the pool until it is
+// rebuilt from the live entries. Strings borrowed from the mapping stay put.
+static void history_rebuild_strings(FRHistoryManager *manager) {
+    FRStringPool *old = manager->strings;
+    manager->strings = fr_string_pool_new();
+    g_hash_table_remove_all(manager->url_index);
+    
+    for (GSequenceIter *iter = g_sequence_get_begin_iter(manager->timeline);
+         !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter)) {
+        FRHistoryEntry *entry = (FRHistoryEntry*)g_sequence_get(iter);
         
-        gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+        if (!history_is_mapped(manager, entry->title)) {
+            entry->title = (char*)fr_string_pool_intern(manager->strings, entry->title);
+        }
+        if (!history_is_mapped(manager, entry->url)) {
+            entry->url = (char*)fr_string_pool_insert(manager->strings, entry->url);
+        }
+        if (entry->search_text && !history_is_mapped(manager, entry->search_text)) {
+            entry->search_text = (char*)fr_string_pool_insert(manager->strings, entry->search_text);
+        }
+        g_hash_table_insert(manager->url_index, entry->url, entry);
+    }
+    
+    fr_string_pool_free(old);
+    manager->strings_live = manager->strings->size;
+}
+
+gboolean fr_history_manager_save(FRHistoryManager *manager) {
+    if (!manager || !manager->history_file) return FALSE;
+    
+    // Never overwrite the snapshot before its records are in memory
+    history_ensure_loaded(manager);
+    
+    fr_storage_write(manager->storage, manager->history_file, history_copy_entries(manager),
+                     history_serialize_binary, (GDestroyNotify)history_snapshot_free);
+    
+    if (manager->strings->size > manager->strings_live * 2 + HISTORY_STRING_POOL_SLACK) {
+        history_rebuild_strings(manager);
     }
     
-    if (g_list_length(recent) == 0) {
-        GtkWidget *item = gtk_menu_item_new_with_label("No history");
-        gtk_widget_set_sensitive(item, FALSE);
-        gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+    // The snapshot covers everything in the journal; the storage thread keeps
+    // the two writes in this order
+    if (manager->journal_size > 0) {
+        fr_storage_write(manager->storage, manager->journal_file, NULL, NULL, NULL);
+        manager->journal_size = 0;
     }
     
-    g_list_free(recent);
-    gtk_widget_show_all(menu);
-    return menu;
+    return TRUE;
 }
 
-void fr_history_show_dialog(GtkWindow *parent, FRHistoryManager *manager) {
-    GtkWidget *dialog = gtk_dialog_new_with_buttons("History",
-                                                    parent,
-                                                    GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
-                                                    "Close", GTK_RESPONSE_CLOSE,
-                                                    "Clear All", GTK_RESPONSE_REJECT,
-                                                    NULL);
+gboolean fr_history_manager_compact(FRHistoryManager *manager) {
+    if (!manager) return FALSE;
     
-    gtk_window_set_default_size(GTK_WINDOW(dialog), 600, 400);
+    if (manager->journal_size == 0) {
+        return TRUE; // Snapshot is already current
+    }
     
-    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    return fr_history_manager_save(manager);
+}
+
+gboolean fr_history_manager_export_json(FRHistoryManager *manager, const char *path) {
+    if (!manager || !path) return FALSE;
     
-    // Create scrolled window
-    GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
-    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
-                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    history_ensure_loaded(manager);
+    fr_storage_write(manager->storage, path, history_copy_entries(manager),
+                     history_serialize_json, (GDestroyNotify)history_snapshot_free);
     
-    // Create list store and tree view
-    GtkListStore *store = gtk_list_store_new(3, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
-    GtkWidget *tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+    return TRUE;
+}
+
+#define HISTORY_MENU_LENGTH 10
+
+// The most frecent visits, from the top of the ranking. Items are created the
+// first time the menu is shown, which is also when the history gets loaded,
+// and afterwards patched one change at a time from the manager's
+// notifications. Those carry timeline positions, so the menu finds entries
+// among the ones it shows and places them by their rank instead.
+typedef struct {
+    FRHistoryManager *manager;
+    GtkWidget *menu;
+    guint first;            // items before the history entries
+    gboolean built;
+    GPtrArray *items;       // GtkWidget*, one per shown entry in ranking order
+    GPtrArray *entries;     // FRHistoryEntry*, the entry of each item
+    GtkWidget *empty_item;
+    FRFaviconCache *favicons;
+    GCallback activate;
+    gpointer user_data;
+    guint handler_id;
+} FRHistoryMenu;
+
+static void history_menu_free(FRHistoryMenu *state) {
+    fr_history_manager_disconnect_changed(state->manager, state->handler_id);
+    g_ptr_array_unref(state->items);
+    g_ptr_array_unref(state->entries);
+    g_free(state);
+}
+
+static void history_menu_insert(FRHistoryMenu *state, guint index, FRHistoryEntry *entry) {
+    GtkWidget *item = fr_favicon_menu_item_new(state->favicons, entry->url,
+                                               entry->title && *entry->title ? entry->title
+                                                                             : entry->url);
+    g_object_set_data_full(G_OBJECT(item), "history-url", g_strdup(entry->url), g_free);
+    if (state->activate) {
+        g_signal_connect(item, "activate", state->activate, state->user_data);
+    }
+    gtk_widget_show(item);
     
-    // Add columns
-    GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
-    gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tree_view),
-                                                -1, "Title", renderer,
-                                                "text", 0, NULL);
+    g_ptr_array_insert(state->items, index, item);
+    g_ptr_array_insert(state->entries, index, entry);
+    gtk_menu_shell_insert(GTK_MENU_SHELL(state->menu), item, state->first + index);
+}
+
+static void history_menu_remove(FRHistoryMenu *state, guint index) {
+    gtk_widget_destroy(GTK_WIDGET(g_ptr_array_index(state->items, index)));
+    g_ptr_array_remove_index(state->items, index);
+    g_ptr_array_remove_index(state->entries, index);
+}
+
+static void history_menu_forget(FRHistoryMenu *state, FRHistoryEntry *entry) {
+    guint index;
+    if (g_ptr_array_find(state->entries, entry, &index)) {
+        history_menu_remove(state, index);
+    }
+}
+
+// Trims to the menu length or tops up from the ranking after a change
+static void history_menu_settle(FRHistoryMenu *state) {
+    while (state->items->len > HISTORY_MENU_LENGTH) {
+        history_menu_remove(state, state->items->len - 1);
+    }
     
-    gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tree_view),
-                                                -1, "URL", renderer,
-                                                "text", 1, NULL);
+    GSequence *ranking = state->manager->ranking;
+    while (state->items->len < HISTORY_MENU_LENGTH) {
+        GSequenceIter *iter = g_sequence_get_iter_at_pos(ranking, state->items->len);
+        if (g_sequence_iter_is_end(iter)) break;
+        history_menu_insert(state, state->items->len, (FRHistoryEntry*)g_sequence_get(iter));
+    }
     
-    gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tree_view),
-                                                -1, "Visited", renderer,
-                                                "text", 2, NULL);
+    gtk_widget_set_visible(state->empty_item, state->items->len == 0);
+}
+
+static void on_history_menu_changed(FRHistoryManager *manager, FRHistoryChange change,
+                                    FRHistoryEntry *entry, int old_position, gpointer user_data) {
+    FRHistoryMenu *state = (FRHistoryMenu*)user_data;
     
-    // Populate with history entries
-    for (GList *l = manager->entries; l != NULL; l = l->next) {
-        FRHistoryEntry *entry = (FRHistoryEntry*)l->data;
-        if (!entry) continue;
-        
-        char *time_str = g_strdup(ctime(&entry->visited));
-        if (time_str) {
-            // Remove newline from ctime
-            char *newline = strchr(time_str, '\n');
-            if (newline) *newline = '\0';
+    if (!state->built) return;
+    
+    switch (change) {
+        case FR_HISTORY_CHANGE_CLEARED:
+            while (state->items->len > 0) {
+                history_menu_remove(state, state->items->len - 1);
+            }
+            break;
+        case FR_HISTORY_CHANGE_REMOVED:
+            history_menu_forget(state, entry);
+            break;
+        case FR_HISTORY_CHANGE_MOVED:
+            history_menu_forget(state, entry);
+            // Fall through to show it at its new rank, with its new title
+        case FR_HISTORY_CHANGE_INSERTED: {
+            gint position = g_sequence_iter_get_position(entry->rank);
+            if ((guint)position <= state->items->len && position < HISTORY_MENU_LENGTH) {
+                history_menu_insert(state, position, entry);
+            }
+            break;
         }
-        
-        GtkTreeIter iter;
-        gtk_list_store_append(store, &iter);
-        gtk_list_store_set(store, &iter,
-                          0, entry->title ? entry->title : "",
-                          1, entry->url ? entry->url : "",
-                          2, time_str ? time_str : "",
-                          -1);
-        
-        g_free(time_str);
     }
     
-    gtk_container_add(GTK_CONTAINER(scrolled), tree_view);
-    gtk_container_add(GTK_CONTAINER(content_area), scrolled);
+    history_menu_settle(state);
+}
+
+static void on_history_menu_show(GtkWidget *menu, gpointer user_data) {
+    FRHistoryMenu *state = (FRHistoryMenu*)user_data;
     
-    gtk_widget_show_all(dialog);
+    if (state->built) return;
     
-    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    state->empty_item = gtk_menu_item_new_with_label("No history");
+    gtk_widget_set_sensitive(state->empty_item, FALSE);
+    gtk_menu_shell_append(GTK_MENU_SHELL(state->menu), state->empty_item);
     
-    if (response == GTK_RESPONSE_REJECT) {
-        // Clear history
-        fr_history_manager_clear(manager);
+    GList *top = fr_history_manager_get_top(state->manager, HISTORY_MENU_LENGTH);
+    for (GList *l = top; l != NULL; l = l->next) {
+        history_menu_insert(state, state->items->len, (FRHistoryEntry*)l->data);
     }
+    g_list_free(top);
+    
+    state->built = TRUE;
+    history_menu_settle(state);
+}
+
+void fr_history_menu_attach(GtkWidget *menu, FRHistoryManager *manager, FRFaviconCache *favicons,
+                            GCallback activate, gpointer user_data) {
+    if (!menu || !manager) return;
+    
+    FRHistoryMenu *state = g_malloc0(sizeof(FRHistoryMenu));
+    state->manager = manager;
+    state->menu = menu;
+    state->items = g_ptr_array_new();
+    state->entries = g_ptr_array_new();
+    state->favicons = favicons;
+    state->activate = activate;
+    state->user_data = user_data;
+    
+    GList *children = gtk_container_get_children(GTK_CONTAINER(menu));
+    state->first = g_list_length(children);
+    g_list_free(children);
+    
+    state->handler_id = fr_history_manager_connect_changed(manager, on_history_menu_changed, state);
+    g_object_set_data_full(G_OBJECT(menu), "history-menu", state, (GDestroyNotify)history_menu_free);
+    g_signal_connect(menu, "show", G_CALLBACK(on_history_menu_show), state);
+}
+
+GtkWidget* fr_history_create_menu(FRHistoryManager *manager) {
+    GtkWidget *menu = gtk_menu_new();
     
-    gtk_widget_destroy(dialog);
+    fr_history_menu_attach(menu, manager, NULL, NULL, NULL);
+    return menu;
 }
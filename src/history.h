@@ -4,36 +4,118 @@
 #include <gtk/gtk.h>
 #include <glib.h>
 #include <time.h>
+#include "arena.h"
+#include "jsonstream.h"
+#include "storage.h"
+#include "trigram.h"
+#include "favicon.h"
 
+// Entries owned by a manager live in its slab and never own their strings:
+// those point into the manager's string pool or the snapshot mapping, and may
+// move when the manager saves, so copy them to keep them. Only entries from
+// fr_history_entry_new own their strings.
 typedef struct {
     char *title;
     char *url;
     time_t visited;
     int visit_count;
+    guint id;               // slab slot + 1 while the entry is in a manager, else 0
+    char *search_text;      // folded "title\nurl" used by the search index
+    double frecency;        // log-domain score, see fr_history_entry_get_frecency
+    GSequenceIter *rank;    // position in the manager's ranking
+    GSequenceIter *recency; // position in the manager's timeline
 } FRHistoryEntry;
 
-typedef struct {
-    GList *entries;
-    char *history_file;
+typedef enum {
+    FR_HISTORY_CHANGE_INSERTED,     // entry is at its new position
+    FR_HISTORY_CHANGE_REMOVED,      // entry was at old_position and is about to be freed
+    FR_HISTORY_CHANGE_MOVED,        // entry moved from old_position after a visit
+    FR_HISTORY_CHANGE_CLEARED       // every entry is gone; entry is NULL
+} FRHistoryChange;
+
+typedef struct _FRHistoryManager FRHistoryManager;
+
+// Called after the change is applied. Positions are in the timeline.
+typedef void (*FRHistoryChangedFunc)(FRHistoryManager *manager, FRHistoryChange change,
+                                     FRHistoryEntry *entry, int old_position, gpointer user_data);
+
+struct _FRHistoryManager {
+    GSequence *timeline;    // FRHistoryEntry*, most recently visited first
+    FRSlab *entry_slab;     // storage for every FRHistoryEntry in timeline
+    FRStringPool *strings;  // titles (interned), urls and search text
+    gsize strings_live;     // pool size after its last rebuild
+    GHashTable *url_index;  // url -> FRHistoryEntry*
+    FRTrigramIndex *search_index;
+    GSequence *ranking;     // FRHistoryEntry*, highest frecency first
+    guint serial;           // bumped whenever entries are added, removed or reordered
+    char *history_file;     // binary snapshot, rewritten only on compaction
+    char *legacy_file;      // history.json from older versions, imported once
+    GMappedFile *snapshot;  // read-only mapping entries borrow their strings from
+    gboolean loaded;        // snapshot materialized and journal replayed
+    guint load_source;      // idle loader, while loading
+    guint32 load_next;      // next snapshot record to materialize
+    guint64 snapshot_seq;   // last journal record the snapshot includes
+    GArray *deferred;       // visits made while loading, applied after it
+    gboolean search_ready;  // search_index covers every entry
+    guint search_next;      // slots below this are in search_index
+    guint search_source;    // idle index builder, while building
+    char *journal_file;     // append-only log of visits since the snapshot
+    gsize journal_size;
+    char *journal_data;     // journal as read at startup, until it is replayed
+    gsize journal_length;
+    gsize journal_offset;   // how much of journal_data is replayed
+    guint64 journal_seq;    // sequence number of the last visit in the journal or snapshot
+    FRStorage *storage;
     int max_entries;
-} FRHistoryManager;
+    GArray *observers;      // FRHistoryObserver
+    guint next_observer_id;
+};
 
 // History manager functions
-FRHistoryManager* fr_history_manager_new(void);
+FRHistoryManager* fr_history_manager_new(FRStorage *storage);
 void fr_history_manager_free(FRHistoryManager *manager);
 gboolean fr_history_manager_load(FRHistoryManager *manager);
 gboolean fr_history_manager_save(FRHistoryManager *manager);
+gboolean fr_history_manager_compact(FRHistoryManager *manager);
+gboolean fr_history_manager_import_json(FRHistoryManager *manager, const char *path);
+guint fr_history_manager_import_json_async(FRHistoryManager *manager, const char *path,
+                                           FRJsonProgressFunc progress, FRJsonDoneFunc done,
+                                           gpointer user_data);
+gboolean fr_history_manager_export_json(FRHistoryManager *manager, const char *path);
 
 // History operations
 FRHistoryEntry* fr_history_entry_new(const char *title, const char *url);
 void fr_history_entry_free(FRHistoryEntry *entry);
 void fr_history_manager_add(FRHistoryManager *manager, const char *title, const char *url);
 void fr_history_manager_clear(FRHistoryManager *manager);
+FRHistoryEntry* fr_history_manager_lookup(FRHistoryManager *manager, const char *url);
 GList* fr_history_manager_search(FRHistoryManager *manager, const char *query);
+
+// Building blocks for incremental matching. Candidates are the ids of entries
+// whose search text may contain the folded query, ascending; NULL when the
+// query is too short to narrow anything down or the index is still being
+// built, in which case callers walk the ranking. Callers verify each candidate
+// against search_text and must not keep ids across a change of serial.
+GArray* fr_history_manager_find_candidates(FRHistoryManager *manager, const char *folded_query);
+FRHistoryEntry* fr_history_manager_get_entry(FRHistoryManager *manager, guint id);
+
+// The timeline, loading the history first if needed
+GSequence* fr_history_manager_get_timeline(FRHistoryManager *manager);
+
+guint fr_history_manager_connect_changed(FRHistoryManager *manager, FRHistoryChangedFunc func,
+                                         gpointer user_data);
+void fr_history_manager_disconnect_changed(FRHistoryManager *manager, guint handler_id);
 GList* fr_history_manager_get_recent(FRHistoryManager *manager, int count);
+GList* fr_history_manager_get_top(FRHistoryManager *manager, int count);
+double fr_history_entry_get_frecency(const FRHistoryEntry *entry, time_t now);
 
 // UI functions
+// Appends the most frecent visits to menu after its current items. They are
+// filled in when the menu is first shown and patched per change after that;
+// activate is connected to each item, whose url is in "history-url", and
+// favicons, if not NULL, supplies the icons shown before the titles.
+void fr_history_menu_attach(GtkWidget *menu, FRHistoryManager *manager, FRFaviconCache *favicons,
+                            GCallback activate, gpointer user_data);
 GtkWidget* fr_history_create_menu(FRHistoryManager *manager);
-void fr_history_show_dialog(GtkWindow *parent, FRHistoryManager *manager);
 
 #endif // HISTORY_H
@@ -0,0 +1,395 @@
+#include "historymodel.h"
+#include <string.h>
+
+struct _FRHistoryModel {
+    GObject parent_instance;
+    FRHistoryManager *manager;
+    guint changed_handler;
+    gint stamp;
+    gint length;            // rows the view knows about
+    char *folded_filter;    // NULL when showing the whole timeline
+    GPtrArray *rows;        // FRHistoryEntry* matching the filter; NULL when unfiltered
+};
+
+static void fr_history_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(FRHistoryModel, fr_history_model, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, fr_history_model_tree_model_init))
+
+// Unfiltered iters hold the entry's GSequenceIter, which stays valid until
+// the entry is removed; filtered iters hold a row index
+static gboolean history_model_set_iter(FRHistoryModel *model, GtkTreeIter *iter, gint index) {
+    if (index < 0 || index >= model->length) {
+        iter->stamp = 0;
+        return FALSE;
+    }
+    
+    iter->stamp = model->stamp;
+    if (model->rows) {
+        iter->user_data = GINT_TO_POINTER(index);
+    } else {
+        iter->user_data = g_sequence_get_iter_at_pos(model->manager->timeline, index);
+    }
+    return TRUE;
+}
+
+static gint history_model_get_index(FRHistoryModel *model, GtkTreeIter *iter) {
+    if (model->rows) {
+        return GPOINTER_TO_INT(iter->user_data);
+    }
+    return g_sequence_iter_get_position((GSequenceIter*)iter->user_data);
+}
+
+FRHistoryEntry* fr_history_model_get_entry(FRHistoryModel *model, GtkTreeIter *iter) {
+    if (!model || !iter || iter->stamp != model->stamp) return NULL;
+    
+    if (model->rows) {
+        return g_ptr_array_index(model->rows, GPOINTER_TO_INT(iter->user_data));
+    }
+    return (FRHistoryEntry*)g_sequence_get((GSequenceIter*)iter->user_data);
+}
+
+static GtkTreeModelFlags history_model_get_flags(GtkTreeModel *tree_model) {
+    FRHistoryModel *model = FR_HISTORY_MODEL(tree_model);
+    return GTK_TREE_MODEL_LIST_ONLY | (model->rows ? 0 : GTK_TREE_MODEL_ITERS_PERSIST);
+}
+
+static gint history_model_get_n_columns(GtkTreeModel *tree_model) {
+    return FR_HISTORY_MODEL_N_COLUMNS;
+}
+
+static GType history_model_get_column_type(GtkTreeModel *tree_model, gint column) {
+    return G_TYPE_STRING;
+}
+
+static gboolean history_model_get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path) {
+    if (gtk_tree_path_get_depth(path) != 1) return FALSE;
+    return history_model_set_iter(FR_HISTORY_MODEL(tree_model), iter, gtk_tree_path_get_indices(path)[0]);
+}
+
+static GtkTreePath* history_model_get_path(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+    FRHistoryModel *model = FR_HISTORY_MODEL(tree_model);
+    g_return_val_if_fail(iter->stamp == model->stamp, NULL);
+    
+    return gtk_tree_path_new_from_indices(history_model_get_index(model, iter), -1);
+}
+
+static void history_model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value) {
+    FRHistoryEntry *entry = fr_history_model_get_entry(FR_HISTORY_MODEL(tree_model), iter);
+    g_value_init(value, G_TYPE_STRING);
+    if (!entry) return;
+    
+    switch (column) {
+        case FR_HISTORY_MODEL_COLUMN_TITLE:
+            g_value_set_string(value, entry->title);
+            break;
+        case FR_HISTORY_MODEL_COLUMN_URL:
+            g_value_set_string(value, entry->url);
+            break;
+        case FR_HISTORY_MODEL_COLUMN_VISITED: {
+            // Formatted per request; only visible rows are ever asked for
+            GDateTime *visited = g_date_time_new_from_unix_local((gint64)entry->visited);
+            if (visited) {
+                g_value_take_string(value, g_date_time_format(visited, "%Y-%m-%d %H:%M"));
+                g_date_time_unref(visited);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static gboolean history_model_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+    FRHistoryModel *model = FR_HISTORY_MODEL(tree_model);
+    
+    if (model->rows) {
+        return history_model_set_iter(model, iter, GPOINTER_TO_INT(iter->user_data) + 1);
+    }
+    
+    GSequenceIter *next = g_sequence_iter_next((GSequenceIter*)iter->user_data);
+    if (g_sequence_iter_is_end(next)) {
+        iter->stamp = 0;
+        return FALSE;
+    }
+    iter->user_data = next;
+    return TRUE;
+}
+
+static gboolean history_model_iter_children(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent) {
+    if (parent) return FALSE;
+    return history_model_set_iter(FR_HISTORY_MODEL(tree_model), iter, 0);
+}
+
+static gboolean history_model_iter_has_child(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+    return FALSE;
+}
+
+static gint history_model_iter_n_children(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+    return iter ? 0 : FR_HISTORY_MODEL(tree_model)->length;
+}
+
+static gboolean history_model_iter_nth_child(GtkTreeModel *tree_model, GtkTreeIter *iter,
+                                             GtkTreeIter *parent, gint n) {
+    if (parent) return FALSE;
+    return history_model_set_iter(FR_HISTORY_MODEL(tree_model), iter, n);
+}
+
+static gboolean history_model_iter_parent(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child) {
+    return FALSE;
+}
+
+static void fr_history_model_tree_model_init(GtkTreeModelIface *iface) {
+    iface->get_flags = history_model_get_flags;
+    iface->get_n_columns = history_model_get_n_columns;
+    iface->get_column_type = history_model_get_column_type;
+    iface->get_iter = history_model_get_iter;
+    iface->get_path = history_model_get_path;
+    iface->get_value = history_model_get_value;
+    iface->iter_next = history_model_iter_next;
+    iface->iter_children = history_model_iter_children;
+    iface->iter_has_child = history_model_iter_has_child;
+    iface->iter_n_children = history_model_iter_n_children;
+    iface->iter_nth_child = history_model_iter_nth_child;
+    iface->iter_parent = history_model_iter_parent;
+}
+
+static void history_model_row_deleted(FRHistoryModel *model, gint index) {
+    model->length--;
+    GtkTreePath *path = gtk_tree_path_new_from_indices(index, -1);
+    gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), path);
+    gtk_tree_path_free(path);
+}
+
+static void history_model_row_inserted(FRHistoryModel *model, gint index) {
+    GtkTreeIter iter;
+    model->length++;
+    history_model_set_iter(model, &iter, index);
+    
+    GtkTreePath *path = gtk_tree_path_new_from_indices(index, -1);
+    gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), path, &iter);
+    gtk_tree_path_free(path);
+}
+
+static void history_model_row_changed(FRHistoryModel *model, gint index) {
+    GtkTreeIter iter;
+    if (!history_model_set_iter(model, &iter, index)) return;
+    
+    GtkTreePath *path = gtk_tree_path_new_from_indices(index, -1);
+    gtk_tree_model_row_changed(GTK_TREE_MODEL(model), path, &iter);
+    gtk_tree_path_free(path);
+}
+
+static void history_model_clear(FRHistoryModel *model) {
+    while (model->length > 0) {
+        history_model_row_deleted(model, model->length - 1);
+    }
+    if (model->rows) {
+        g_ptr_array_set_size(model->rows, 0);
+    }
+    model->stamp++;
+}
+
+// A filtered model is a snapshot of one query: new visits don't join it, but
+// rows that leave the history leave the model and updated rows repaint
+static void history_model_filtered_changed(FRHistoryModel *model, FRHistoryChange change,
+                                           FRHistoryEntry *entry) {
+    guint index;
+    if (!entry || !g_ptr_array_find(model->rows, entry, &index)) return;
+    
+    if (change == FR_HISTORY_CHANGE_REMOVED) {
+        g_ptr_array_remove_index(model->rows, index);
+        history_model_row_deleted(model, (gint)index);
+    } else {
+        history_model_row_changed(model, (gint)index);
+    }
+}
+
+static void history_model_changed(FRHistoryManager *manager, FRHistoryChange change,
+                                  FRHistoryEntry *entry, int old_position, gpointer user_data) {
+    FRHistoryModel *model = (FRHistoryModel*)user_data;
+    
+    if (change == FR_HISTORY_CHANGE_CLEARED) {
+        history_model_clear(model);
+        return;
+    }
+    if (model->rows) {
+        history_model_filtered_changed(model, change, entry);
+        return;
+    }
+    
+    switch (change) {
+        case FR_HISTORY_CHANGE_INSERTED:
+            history_model_row_inserted(model, g_sequence_iter_get_position(entry->recency));
+            break;
+        case FR_HISTORY_CHANGE_REMOVED:
+            history_model_row_deleted(model, old_position);
+            break;
+        case FR_HISTORY_CHANGE_MOVED: {
+            gint position = g_sequence_iter_get_position(entry->recency);
+            if (position == old_position) {
+                history_model_row_changed(model, position);
+            } else {
+                history_model_row_deleted(model, old_position);
+                history_model_row_inserted(model, position);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void fr_history_model_dispose(GObject *object) {
+    FRHistoryModel *model = FR_HISTORY_MODEL(object);
+    
+    if (model->changed_handler) {
+        fr_history_manager_disconnect_changed(model->manager, model->changed_handler);
+        model->changed_handler = 0;
+    }
+    
+    G_OBJECT_CLASS(fr_history_model_parent_class)->dispose(object);
+}
+
+static void fr_history_model_finalize(GObject *object) {
+    FRHistoryModel *model = FR_HISTORY_MODEL(object);
+    
+    if (model->rows) {
+        g_ptr_array_unref(model->rows);
+    }
+    g_free(model->folded_filter);
+    
+    G_OBJECT_CLASS(fr_history_model_parent_class)->finalize(object);
+}
+
+static void fr_history_model_class_init(FRHistoryModelClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    object_class->dispose = fr_history_model_dispose;
+    object_class->finalize = fr_history_model_finalize;
+}
+
+static void fr_history_model_init(FRHistoryModel *model) {
+    model->stamp = g_random_int();
+}
+
+static FRHistoryModel* history_model_create(FRHistoryManager *manager) {
+    FRHistoryModel *model = g_object_new(FR_TYPE_HISTORY_MODEL, NULL);
+    model->manager = manager;
+    model->changed_handler = fr_history_manager_connect_changed(manager, history_model_changed, model);
+    return model;
+}
+
+FRHistoryModel* fr_history_model_new(FRHistoryManager *manager) {
+    if (!manager) return NULL;
+    
+    GSequence *timeline = fr_history_manager_get_timeline(manager);
+    FRHistoryModel *model = history_model_create(manager);
+    model->length = g_sequence_get_length(timeline);
+    return model;
+}
+
+FRHistoryModel* fr_history_model_new_filtered(FRHistoryManager *manager, const char *query,
+                                              FRHistoryModel *previous) {
+    if (!manager) return NULL;
+    if (!query || *query == '\0') return fr_history_model_new(manager);
+    
+    FRHistoryModel *model = history_model_create(manager);
+    model->folded_filter = fr_trigram_fold(query);
+    model->rows = g_ptr_array_new();
+    
+    if (previous && previous->folded_filter && g_str_has_prefix(model->folded_filter, previous->folded_filter)) {
+        for (guint i = 0; i < previous->rows->len; i++) {
+            FRHistoryEntry *entry = g_ptr_array_index(previous->rows, i);
+            if (strstr(entry->search_text, model->folded_filter)) {
+                g_ptr_array_add(model->rows, entry);
+            }
+        }
+    } else {
+        GList *results = fr_history_manager_search(manager, query);
+        for (GList *l = results; l != NULL; l = l->next) {
+            g_ptr_array_add(model->rows, l->data);
+        }
+        g_list_free(results);
+    }
+    
+    model->length = (gint)model->rows->len;
+    return model;
+}
+
+static GtkTreeViewColumn* history_dialog_column(const char *title, int column, int width) {
+    GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+    g_object_set(renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+    
+    GtkTreeViewColumn *tree_column = gtk_tree_view_column_new_with_attributes(title, renderer,
+                                                                              "text", column, NULL);
+    gtk_tree_view_column_set_sizing(tree_column, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width(tree_column, width);
+    gtk_tree_view_column_set_resizable(tree_column, TRUE);
+    return tree_column;
+}
+
+static void on_history_filter_changed(GtkSearchEntry *entry, gpointer user_data) {
+    GtkTreeView *tree_view = GTK_TREE_VIEW(user_data);
+    FRHistoryManager *manager = g_object_get_data(G_OBJECT(tree_view), "history-manager");
+    FRHistoryModel *previous = FR_HISTORY_MODEL(gtk_tree_view_get_model(tree_view));
+    
+    FRHistoryModel *model = fr_history_model_new_filtered(manager, gtk_entry_get_text(GTK_ENTRY(entry)),
+                                                          previous);
+    gtk_tree_view_set_model(tree_view, GTK_TREE_MODEL(model));
+    g_object_unref(model);
+}
+
+void fr_history_show_dialog(GtkWindow *parent, FRHistoryManager *manager) {
+    GtkWidget *dialog = gtk_dialog_new_with_buttons("History",
+                                                    parent,
+                                                    GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                                    "Close", GTK_RESPONSE_CLOSE,
+                                                    "Clear All", GTK_RESPONSE_REJECT,
+                                                    NULL);
+    
+    gtk_window_set_default_size(GTK_WINDOW(dialog), 600, 400);
+    
+    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    
+    // Search entry
+    GtkWidget *search_entry = gtk_search_entry_new();
+    gtk_box_pack_start(GTK_BOX(content_area), search_entry, FALSE, FALSE, 0);
+    
+    // Create scrolled window
+    GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
+                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    
+    // The model reads straight from the history; with fixed row heights the
+    // view only asks for the rows it shows
+    FRHistoryModel *model = fr_history_model_new(manager);
+    GtkWidget *tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(model));
+    g_object_unref(model);
+    g_object_set_data(G_OBJECT(tree_view), "history-manager", manager);
+    
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view),
+                                history_dialog_column("Title", FR_HISTORY_MODEL_COLUMN_TITLE, 240));
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view),
+                                history_dialog_column("URL", FR_HISTORY_MODEL_COLUMN_URL, 220));
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view),
+                                history_dialog_column("Visited", FR_HISTORY_MODEL_COLUMN_VISITED, 120));
+    gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(tree_view), TRUE);
+    
+    g_signal_connect(search_entry, "search-changed", G_CALLBACK(on_history_filter_changed), tree_view);
+    
+    gtk_container_add(GTK_CONTAINER(scrolled), tree_view);
+    gtk_box_pack_start(GTK_BOX(content_area), scrolled, TRUE, TRUE, 0);
+    
+    gtk_widget_show_all(dialog);
+    
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    
+    if (response == GTK_RESPONSE_REJECT) {
+        // Drop the model first so the view isn't told about every row going away
+        gtk_tree_view_set_model(GTK_TREE_VIEW(tree_view), NULL);
+        fr_history_manager_clear(manager);
+    }
+    
+    gtk_widget_destroy(dialog);
+}
@@ -0,0 +1,34 @@
+#ifndef HISTORYMODEL_H
+#define HISTORYMODEL_H
+
+#include <gtk/gtk.h>
+#include "history.h"
+
+enum {
+    FR_HISTORY_MODEL_COLUMN_TITLE,
+    FR_HISTORY_MODEL_COLUMN_URL,
+    FR_HISTORY_MODEL_COLUMN_VISITED,
+    FR_HISTORY_MODEL_N_COLUMNS
+};
+
+// GtkTreeModel over a history manager's entries. Nothing is copied: rows are
+// looked up in the timeline on demand and cells are formatted only when the
+// view asks for them, so creating the model costs the same for any history
+// size. The model follows history changes while it is alive.
+#define FR_TYPE_HISTORY_MODEL (fr_history_model_get_type())
+G_DECLARE_FINAL_TYPE(FRHistoryModel, fr_history_model, FR, HISTORY_MODEL, GObject)
+
+// Every entry, most recently visited first
+FRHistoryModel* fr_history_model_new(FRHistoryManager *manager);
+
+// Entries matching query, best first. When query extends the filter of
+// previous, previous's rows are narrowed down instead of searching again.
+FRHistoryModel* fr_history_model_new_filtered(FRHistoryManager *manager, const char *query,
+                                              FRHistoryModel *previous);
+
+FRHistoryEntry* fr_history_model_get_entry(FRHistoryModel *model, GtkTreeIter *iter);
+
+// History dialog listing the manager's entries through a model, with a filter
+void fr_history_show_dialog(GtkWindow *parent, FRHistoryManager *manager);
+
+#endif // HISTORYMODEL_H
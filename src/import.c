@@ -0,0 +1,717 @@
+#include "import.h"
+#include "jsonstream.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define IMPORT_CHUNK_SIZE (64 * 1024)
+#define IMPORT_APPLY_CHUNK 256
+
+// Seconds between 1601-01-01, where Chromium timestamps start, and 1970-01-01
+#define CHROMIUM_EPOCH_OFFSET G_GINT64_CONSTANT(11644473600)
+
+typedef enum {
+    IMPORT_FORMAT_UNKNOWN,  // only whitespace so far
+    IMPORT_FORMAT_INVALID,
+    IMPORT_FORMAT_HTML,
+    IMPORT_FORMAT_JSON
+} FRImportFormat;
+
+// One open JSON object. Firefox and Chromium both nest bookmarks in
+// "children" arrays, so objects in such an array are the tree's nodes and
+// everything else (metadata, Chromium's "roots") is only tracked for depth.
+typedef struct {
+    char *name;
+    char *url;
+    gint64 created;
+    char *member;           // member being read
+    guint depth;
+    gboolean in_children;   // element of the enclosing object's children
+    GPtrArray *pending;     // FRBookmark*, waiting for this folder's name
+} FRImportNode;
+
+struct _FRBookmarkImport {
+    FRBookmarkManager *manager;
+    FRImportFormat format;
+    FILE *file;
+    char *chunk;
+    FRBookmarkImportProgress progress;
+    gint64 started;
+    guint source_id;        // reading, then applying
+    gboolean cancelled;     // stopped before the end of the file
+    FRBookmarkImportProgressFunc progress_func;
+    FRBookmarkImportDoneFunc done_func;
+    gpointer user_data;
+    GPtrArray *records;     // FRBookmark*, applied in one batch when reading ends
+    guint applied;          // records inserted or skipped so far
+    
+    // JSON exports
+    FRJsonStream *stream;
+    GPtrArray *nodes;       // FRImportNode*, innermost last
+    
+    // Netscape HTML
+    gboolean in_tag;
+    char quote;
+    GString *tag;
+    GString *text;
+    gboolean capture;       // inside <A> or <H3>
+    char *href;
+    gint64 add_date;
+    char *folder_name;      // from the last </H3>, until its <DL> opens
+    GString *path;
+    GArray *path_lengths;   // gsize, path length before each open <DL>
+};
+
+static void import_commit(FRBookmarkImport *import, const char *title, const char *url,
+                          const char *folder, gint64 created) {
+    // Firefox exports its smart folders as place: queries
+    if (!url || !*url || g_str_has_prefix(url, "place:")) {
+        import->progress.skipped++;
+        return;
+    }
+    
+    FRBookmark *bookmark = fr_bookmark_new(title && *title ? title : url, url, folder);
+    if (created > 0) {
+        bookmark->created = (time_t)created;
+    }
+    g_ptr_array_add(import->records, bookmark);
+    import->progress.found++;
+}
+
+// Folder names become path components, so they cannot contain the separator
+static char* import_folder_component(const char *name) {
+    char *component = g_strstrip(g_strdup(name));
+    g_strdelimit(component, "/", '-');
+    return component;
+}
+
+// JSON
+
+static void import_node_free(FRImportNode *node) {
+    g_free(node->name);
+    g_free(node->url);
+    g_free(node->member);
+    if (node->pending) {
+        g_ptr_array_unref(node->pending);
+    }
+    g_free(node);
+}
+
+static void import_node_set(FRImportNode *node, const char *value) {
+    const char *member = node->member;
+    
+    if (strcmp(member, "title") == 0 || strcmp(member, "name") == 0) {
+        g_free(node->name);
+        node->name = g_strdup(value);
+    } else if (strcmp(member, "uri") == 0 || strcmp(member, "url") == 0) {
+        g_free(node->url);
+        node->url = g_strdup(value);
+    } else if (strcmp(member, "dateAdded") == 0) {
+        // Firefox: microseconds since 1970
+        node->created = g_ascii_strtoll(value, NULL, 10) / G_USEC_PER_SEC;
+    } else if (strcmp(member, "date_added") == 0) {
+        // Chromium: microseconds since 1601, as a string
+        node->created = g_ascii_strtoll(value, NULL, 10) / G_USEC_PER_SEC - CHROMIUM_EPOCH_OFFSET;
+    }
+}
+
+static void import_item_prepend(FRBookmark *item, const char *name) {
+    if (!name) return;
+    
+    char *component = import_folder_component(name);
+    if (*component) {
+        char *folder = *item->folder ? g_strconcat(component, "/", item->folder, NULL)
+                                     : g_strdup(component);
+        g_free(item->folder);
+        item->folder = folder;
+    }
+    g_free(component);
+}
+
+// Walks up from the node at index, prefixing the folder path with each
+// ancestor's name. Chromium writes "children" before "name", so an ancestor
+// whose name is not known yet keeps the item until it closes.
+static void import_json_resolve(FRBookmarkImport *import, guint index, FRBookmark *item) {
+    while (index > 0 && ((FRImportNode*)g_ptr_array_index(import->nodes, index))->in_children) {
+        FRImportNode *parent = g_ptr_array_index(import->nodes, index - 1);
+        
+        if (!parent->name) {
+            if (!parent->pending) {
+                parent->pending = g_ptr_array_new_with_free_func((GDestroyNotify)fr_bookmark_free);
+            }
+            g_ptr_array_add(parent->pending, item);
+            return;
+        }
+        import_item_prepend(item, parent->name);
+        index--;
+    }
+    
+    import_commit(import, item->title, item->url, item->folder, item->created);
+    fr_bookmark_free(item);
+}
+
+static void import_json_close(FRBookmarkImport *import, guint index) {
+    FRImportNode *node = g_ptr_array_index(import->nodes, index);
+    
+    if (node->url) {
+        FRBookmark *item = g_malloc0(sizeof(FRBookmark));
+        item->title = g_strdup(node->name);
+        item->url = g_strdup(node->url);
+        item->folder = g_strdup("");
+        item->created = (time_t)node->created;
+        import_json_resolve(import, index, item);
+    } else if (node->pending) {
+        GPtrArray *pending = node->pending;
+        node->pending = NULL;
+        
+        g_ptr_array_set_free_func(pending, NULL);
+        for (guint i = 0; i < pending->len; i++) {
+            FRBookmark *item = g_ptr_array_index(pending, i);
+            import_item_prepend(item, node->name);
+            import_json_resolve(import, index, item);
+        }
+        g_ptr_array_unref(pending);
+    }
+}
+
+static void import_json_event(FRJsonStream *stream, FRJsonEvent event, const char *value,
+                              guint depth, gpointer user_data) {
+    FRBookmarkImport *import = (FRBookmarkImport*)user_data;
+    guint count = import->nodes->len;
+    FRImportNode *node = count > 0 ? g_ptr_array_index(import->nodes, count - 1) : NULL;
+    
+    switch (event) {
+        case FR_JSON_BEGIN_OBJECT: {
+            FRImportNode *child = g_malloc0(sizeof(FRImportNode));
+            child->depth = depth;
+            child->in_children = node && node->member && strcmp(node->member, "children") == 0 &&
+                                 depth == node->depth + 2;
+            g_ptr_array_add(import->nodes, child);
+            break;
+        }
+        case FR_JSON_END_OBJECT:
+            if (node) {
+                import_json_close(import, count - 1);
+                g_ptr_array_remove_index(import->nodes, count - 1);
+            }
+            break;
+        case FR_JSON_MEMBER:
+            if (node && depth == node->depth) {
+                g_free(node->member);
+                node->member = g_strdup(value);
+            }
+            break;
+        case FR_JSON_STRING:
+        case FR_JSON_NUMBER:
+            if (node && depth == node->depth && node->member) {
+                import_node_set(node, value);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Netscape HTML
+
+// Decodes the entities bookmark exporters write; others are kept verbatim
+static char* import_html_decode(const char *text, gsize length) {
+    static const struct { const char *name; const char *value; } entities[] = {
+        { "amp;", "&" }, { "lt;", "<" }, { "gt;", ">" }, { "quot;", "\"" },
+        { "apos;", "'" }, { "nbsp;", " " }
+    };
+    GString *decoded = g_string_sized_new(length);
+    const char *end = text + length;
+    
+    for (const char *p = text; p < end; p++) {
+        if (*p != '&') {
+            g_string_append_c(decoded, *p);
+            continue;
+        }
+        
+        gsize rest = end - p - 1;
+        gboolean matched = FALSE;
+        
+        if (rest > 1 && p[1] == '#') {
+            char *number_end = NULL;
+            gboolean hex = p[2] == 'x' || p[2] == 'X';
+            guint64 c = g_ascii_strtoull(p + (hex ? 3 : 2), &number_end, hex ? 16 : 10);
+            if (number_end && number_end < end && *number_end == ';' && c > 0 &&
+                g_unichar_validate((gunichar)c)) {
+                g_string_append_unichar(decoded, (gunichar)c);
+                p = number_end;
+                matched = TRUE;
+            }
+        } else {
+            for (gsize i = 0; i < G_N_ELEMENTS(entities); i++) {
+                gsize n = strlen(entities[i].name);
+                if (rest >= n && g_ascii_strncasecmp(p + 1, entities[i].name, n) == 0) {
+                    g_string_append(decoded, entities[i].value);
+                    p += n;
+                    matched = TRUE;
+                    break;
+                }
+            }
+        }
+        
+        if (!matched) {
+            g_string_append_c(decoded, '&');
+        }
+    }
+    
+    return g_strstrip(g_string_free(decoded, FALSE));
+}
+
+// Value of attribute name in the text of a tag, or NULL
+static char* import_html_attribute(const char *tag, const char *name) {
+    gsize name_length = strlen(name);
+    const char *p = tag + strcspn(tag, " \t\r\n");
+    
+    while (*p) {
+        p += strspn(p, " \t\r\n");
+        const char *attribute = p;
+        p += strcspn(p, " \t\r\n=");
+        gboolean match = (gsize)(p - attribute) == name_length &&
+                         g_ascii_strncasecmp(attribute, name, name_length) == 0;
+        
+        p += strspn(p, " \t\r\n");
+        if (*p != '=') continue;
+        p++;
+        p += strspn(p, " \t\r\n");
+        
+        const char *value = p;
+        if (*p == '"' || *p == '\'') {
+            char quote = *p++;
+            value = p;
+            while (*p && *p != quote) p++;
+        } else {
+            p += strcspn(p, " \t\r\n");
+        }
+        
+        if (match) {
+            return import_html_decode(value, p - value);
+        }
+        if (*p) p++;
+    }
+    
+    return NULL;
+}
+
+static gboolean import_html_tag_is(const char *tag, const char *name) {
+    gsize length = strlen(name);
+    return g_ascii_strncasecmp(tag, name, length) == 0 &&
+           (tag[length] == '\0' || strchr(" \t\r\n/", tag[length]));
+}
+
+static void import_html_tag(FRBookmarkImport *import) {
+    const char *tag = import->tag->str;
+    gboolean closing = *tag == '/';
+    if (closing) tag++;
+    
+    if (import_html_tag_is(tag, "a")) {
+        if (!closing) {
+            g_free(import->href);
+            import->href = import_html_attribute(tag, "href");
+            char *add_date = import_html_attribute(tag, "add_date");
+            import->add_date = add_date ? g_ascii_strtoll(add_date, NULL, 10) : 0;
+            g_free(add_date);
+            import->capture = TRUE;
+            g_string_truncate(import->text, 0);
+        } else if (import->capture) {
+            char *title = import_html_decode(import->text->str, import->text->len);
+            import_commit(import, title, import->href, import->path->str, import->add_date);
+            g_free(title);
+            g_clear_pointer(&import->href, g_free);
+            import->capture = FALSE;
+        }
+    } else if (import_html_tag_is(tag, "h3")) {
+        if (!closing) {
+            import->capture = TRUE;
+            g_string_truncate(import->text, 0);
+        } else if (import->capture) {
+            g_free(import->folder_name);
+            import->folder_name = import_html_decode(import->text->str, import->text->len);
+            import->capture = FALSE;
+        }
+    } else if (import_html_tag_is(tag, "dl")) {
+        if (!closing) {
+            gsize length = import->path->len;
+            g_array_append_val(import->path_lengths, length);
+            
+            char *component = import_folder_component(import->folder_name ? import->folder_name : "");
+            if (*component) {
+                if (import->path->len > 0) {
+                    g_string_append_c(import->path, '/');
+                }
+                g_string_append(import->path, component);
+            }
+            g_free(component);
+            g_clear_pointer(&import->folder_name, g_free);
+        } else if (import->path_lengths->len > 0) {
+            guint last = import->path_lengths->len - 1;
+            g_string_truncate(import->path, g_array_index(import->path_lengths, gsize, last));
+            g_array_set_size(import->path_lengths, last);
+        }
+    }
+}
+
+static void import_html_feed(FRBookmarkImport *import, const char *data, gsize length) {
+    const char *end = data + length;
+    const char *p = data;
+    
+    while (p < end) {
+        if (!import->in_tag) {
+            const char *open = memchr(p, '<', end - p);
+            const char *stop = open ? open : end;
+            if (import->capture) {
+                g_string_append_len(import->text, p, stop - p);
+            }
+            if (!open) break;
+            import->in_tag = TRUE;
+            p = open + 1;
+            continue;
+        }
+        
+        // Quotes only count after '=', so stray apostrophes cannot swallow the file
+        char c = *p++;
+        if (import->quote) {
+            if (c == import->quote) import->quote = 0;
+        } else if ((c == '"' || c == '\'') && import->tag->len > 0 &&
+                   import->tag->str[import->tag->len - 1] == '=') {
+            import->quote = c;
+        } else if (c == '>') {
+            import_html_tag(import);
+            g_string_truncate(import->tag, 0);
+            import->in_tag = FALSE;
+            continue;
+        }
+        g_string_append_c(import->tag, c);
+    }
+}
+
+// Driver
+
+static FRImportFormat import_sniff(const char *data, gsize length) {
+    const char *p = data;
+    const char *end = data + length;
+    
+    if (length >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;
+    }
+    while (p < end && g_ascii_isspace(*p)) p++;
+    
+    if (p == end) return IMPORT_FORMAT_UNKNOWN;
+    if (*p == '<') return IMPORT_FORMAT_HTML;
+    if (*p == '{' || *p == '[') return IMPORT_FORMAT_JSON;
+    return IMPORT_FORMAT_INVALID;
+}
+
+static void import_update_elapsed(FRBookmarkImport *import) {
+    import->progress.elapsed = (g_get_monotonic_time() - import->started) / (double)G_USEC_PER_SEC;
+}
+
+static void import_free(FRBookmarkImport *import) {
+    if (import->file) {
+        fclose(import->file);
+    }
+    fr_json_stream_free(import->stream);
+    g_ptr_array_unref(import->nodes);
+    g_ptr_array_unref(import->records);
+    g_string_free(import->tag, TRUE);
+    g_string_free(import->text, TRUE);
+    g_string_free(import->path, TRUE);
+    g_array_unref(import->path_lengths);
+    g_free(import->href);
+    g_free(import->folder_name);
+    g_free(import->chunk);
+    g_free(import);
+}
+
+static void import_report(FRBookmarkImport *import, GError *error) {
+    import_update_elapsed(import);
+    
+    if (import->done_func) {
+        import->done_func(&import->progress, error, import->user_data);
+    }
+    if (error) {
+        g_error_free(error);
+    }
+    import_free(import);
+}
+
+static void import_saved(FRBookmarkManager *manager, gboolean success, gpointer user_data) {
+    FRBookmarkImport *import = (FRBookmarkImport*)user_data;
+    GError *error = NULL;
+    
+    // A failed write undid the batch; the counts say what was attempted
+    if (!success) {
+        error = g_error_new(G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                            "Could not save bookmarks, the import was undone");
+    } else if (import->cancelled) {
+        error = g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "Import cancelled");
+    }
+    import_report(import, error);
+}
+
+// Inserts a chunk of records per main loop iteration. The batch stays open
+// across them, so everything is written once and undone together.
+static gboolean import_apply_step(gpointer user_data) {
+    FRBookmarkImport *import = (FRBookmarkImport*)user_data;
+    guint end = MIN(import->applied + IMPORT_APPLY_CHUNK, import->records->len);
+    
+    for (; import->applied < end; import->applied++) {
+        FRBookmark *bookmark = g_ptr_array_index(import->records, import->applied);
+        if (fr_bookmark_manager_insert(import->manager, bookmark->title, bookmark->url,
+                                       bookmark->folder, bookmark->created)) {
+            import->progress.added++;
+        } else {
+            import->progress.skipped++;
+        }
+    }
+    
+    if (import->applied < import->records->len) {
+        import_update_elapsed(import);
+        if (import->progress_func) {
+            import->progress_func(&import->progress, import->user_data);
+        }
+        return G_SOURCE_CONTINUE;
+    }
+    
+    // done hears from the storage thread whether the batch reached the disk
+    import->source_id = 0;
+    fr_bookmark_manager_commit_full(import->manager, import_saved, import);
+    return G_SOURCE_REMOVE;
+}
+
+// Reading is over. A cancelled import keeps what it read; a damaged file
+// leaves no trace.
+static void import_finish(FRBookmarkImport *import, GError *error) {
+    if (import->source_id) {
+        g_source_remove(import->source_id);
+        import->source_id = 0;
+    }
+    if (import->file) {
+        fclose(import->file);
+        import->file = NULL;
+    }
+    
+    if (error && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        import_report(import, error);
+        return;
+    }
+    if (error) {
+        import->cancelled = TRUE;
+        g_error_free(error);
+    }
+    
+    fr_bookmark_manager_begin(import->manager);
+    import->source_id = g_idle_add(import_apply_step, import);
+}
+
+static gboolean import_step(gpointer user_data) {
+    FRBookmarkImport *import = (FRBookmarkImport*)user_data;
+    GError *error = NULL;
+    
+    size_t read = fread(import->chunk, 1, IMPORT_CHUNK_SIZE, import->file);
+    if (read > 0) {
+        if (import->format == IMPORT_FORMAT_UNKNOWN) {
+            import->format = import_sniff(import->chunk, read);
+        }
+        if (import->format == IMPORT_FORMAT_INVALID) {
+            import->source_id = 0;
+            import_finish(import, g_error_new(G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                                              "Not a bookmarks export"));
+            return G_SOURCE_REMOVE;
+        }
+        
+        if (import->format == IMPORT_FORMAT_HTML) {
+            import_html_feed(import, import->chunk, read);
+        } else if (import->format == IMPORT_FORMAT_JSON &&
+                   !fr_json_stream_feed(import->stream, import->chunk, read, &error)) {
+            import->source_id = 0;
+            import_finish(import, error);
+            return G_SOURCE_REMOVE;
+        }
+        
+        import->progress.bytes_read += read;
+        import_update_elapsed(import);
+        if (import->progress_func) {
+            import->progress_func(&import->progress, import->user_data);
+        }
+        return G_SOURCE_CONTINUE;
+    }
+    
+    if (import->format == IMPORT_FORMAT_JSON) {
+        fr_json_stream_finish(import->stream, &error);
+    } else if (import->format != IMPORT_FORMAT_HTML) {
+        error = g_error_new(G_FILE_ERROR, G_FILE_ERROR_INVAL, "Not a bookmarks export");
+    }
+    
+    import->source_id = 0;
+    import_finish(import, error);
+    return G_SOURCE_REMOVE;
+}
+
+FRBookmarkImport* fr_bookmark_import_start(FRBookmarkManager *manager, const char *path,
+                                           FRBookmarkImportProgressFunc progress,
+                                           FRBookmarkImportDoneFunc done, gpointer user_data) {
+    if (!manager) return NULL;
+    
+    FRBookmarkImport *import = g_malloc0(sizeof(FRBookmarkImport));
+    import->manager = manager;
+    import->records = g_ptr_array_new_with_free_func((GDestroyNotify)fr_bookmark_free);
+    import->progress_func = progress;
+    import->done_func = done;
+    import->user_data = user_data;
+    import->started = g_get_monotonic_time();
+    import->stream = fr_json_stream_new(import_json_event, import);
+    import->nodes = g_ptr_array_new_with_free_func((GDestroyNotify)import_node_free);
+    import->tag = g_string_new(NULL);
+    import->text = g_string_new(NULL);
+    import->path = g_string_new(NULL);
+    import->path_lengths = g_array_new(FALSE, FALSE, sizeof(gsize));
+    import->file = path ? fopen(path, "rb") : NULL;
+    
+    if (!import->file) {
+        import_finish(import, g_error_new(G_FILE_ERROR, G_FILE_ERROR_NOENT, "Could not open %s",
+                                          path ? path : "(null)"));
+        return NULL;
+    }
+    
+    fseek(import->file, 0, SEEK_END);
+    import->progress.total_bytes = ftell(import->file);
+    fseek(import->file, 0, SEEK_SET);
+    import->chunk = g_malloc(IMPORT_CHUNK_SIZE);
+    import->source_id = g_idle_add(import_step, import);
+    
+    return import;
+}
+
+void fr_bookmark_import_cancel(FRBookmarkImport *import) {
+    // Only reading can be stopped; applying what was read is quick
+    if (!import || !import->file) return;
+    
+    import_finish(import, g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED, "Import cancelled"));
+}
+
+// UI
+
+typedef struct {
+    GtkWidget *dialog;
+    GtkWidget *progress_bar;
+    GtkWidget *label;
+    FRBookmarkImport *import;
+} FRImportDialog;
+
+static char* import_describe(const FRBookmarkImportProgress *progress) {
+    double rate = progress->elapsed > 0 ? progress->added / progress->elapsed : 0;
+    return g_strdup_printf("%u found, %u added, %u skipped (%.0f bookmarks/s)",
+                           progress->found, progress->added, progress->skipped, rate);
+}
+
+static void on_import_progress(const FRBookmarkImportProgress *progress, gpointer user_data) {
+    FRImportDialog *ui = (FRImportDialog*)user_data;
+    
+    if (progress->total_bytes > 0) {
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(ui->progress_bar),
+                                      (double)progress->bytes_read / progress->total_bytes);
+    }
+    char *text = import_describe(progress);
+    gtk_label_set_text(GTK_LABEL(ui->label), text);
+    g_free(text);
+}
+
+static void on_import_done(const FRBookmarkImportProgress *progress, const GError *error,
+                           gpointer user_data) {
+    FRImportDialog *ui = (FRImportDialog*)user_data;
+    ui->import = NULL;
+    
+    char *summary = import_describe(progress);
+    g_message("Bookmark import: %s in %.1fs", summary, progress->elapsed);
+    
+    // The dialog went away first and cancelled us
+    if (!ui->dialog) {
+        g_free(summary);
+        g_free(ui);
+        return;
+    }
+    
+    if (error) {
+        char *text = g_strdup_printf("%s\n%s", error->message, summary);
+        gtk_label_set_text(GTK_LABEL(ui->label), text);
+        g_free(text);
+    } else {
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(ui->progress_bar), 1.0);
+        gtk_label_set_text(GTK_LABEL(ui->label), summary);
+    }
+    g_free(summary);
+    
+    GtkWidget *button = gtk_dialog_get_widget_for_response(GTK_DIALOG(ui->dialog), GTK_RESPONSE_CLOSE);
+    gtk_button_set_label(GTK_BUTTON(button), "Close");
+}
+
+static void on_import_dialog_response(GtkDialog *dialog, gint response_id, gpointer user_data) {
+    FRImportDialog *ui = (FRImportDialog*)user_data;
+    
+    if (ui->import) {
+        fr_bookmark_import_cancel(ui->import);
+    } else {
+        gtk_widget_destroy(GTK_WIDGET(dialog));
+    }
+}
+
+static void on_import_dialog_destroy(GtkWidget *widget, gpointer user_data) {
+    FRImportDialog *ui = (FRImportDialog*)user_data;
+    ui->dialog = NULL;
+    
+    if (ui->import) {
+        fr_bookmark_import_cancel(ui->import);
+    } else {
+        g_free(ui);
+    }
+}
+
+void fr_bookmark_import_show_dialog(GtkWindow *parent, FRBookmarkManager *manager) {
+    GtkWidget *chooser = gtk_file_chooser_dialog_new("Import Bookmarks",
+                                                     parent,
+                                                     GTK_FILE_CHOOSER_ACTION_OPEN,
+                                                     "Cancel", GTK_RESPONSE_CANCEL,
+                                                     "Import", GTK_RESPONSE_ACCEPT,
+                                                     NULL);
+    
+    char *path = NULL;
+    if (gtk_dialog_run(GTK_DIALOG(chooser)) == GTK_RESPONSE_ACCEPT) {
+        path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(chooser));
+    }
+    gtk_widget_destroy(chooser);
+    
+    if (!path) return;
+    
+    FRImportDialog *ui = g_malloc0(sizeof(FRImportDialog));
+    ui->dialog = gtk_dialog_new_with_buttons("Import Bookmarks",
+                                             parent,
+                                             GTK_DIALOG_DESTROY_WITH_PARENT,
+                                             "Cancel", GTK_RESPONSE_CLOSE,
+                                             NULL);
+    gtk_window_set_default_size(GTK_WINDOW(ui->dialog), 360, -1);
+    
+    GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(ui->dialog));
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_container_set_border_width(GTK_CONTAINER(box), 12);
+    
+    ui->progress_bar = gtk_progress_bar_new();
+    ui->label = gtk_label_new("Reading bookmarks...");
+    gtk_label_set_xalign(GTK_LABEL(ui->label), 0.0);
+    
+    gtk_box_pack_start(GTK_BOX(box), ui->progress_bar, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(box), ui->label, FALSE, FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(content_area), box);
+    
+    g_signal_connect(ui->dialog, "response", G_CALLBACK(on_import_dialog_response), ui);
+    g_signal_connect(ui->dialog, "destroy", G_CALLBACK(on_import_dialog_destroy), ui);
+    gtk_widget_show_all(ui->dialog);
+    
+    // done runs before start returns when the file cannot be opened
+    ui->import = fr_bookmark_import_start(manager, path, on_import_progress, on_import_done, ui);
+    g_free(path);
+}
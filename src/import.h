@@ -0,0 +1,43 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <gtk/gtk.h>
+#include <glib.h>
+#include "bookmarks.h"
+
+// Bulk bookmark import from the files other browsers export: Netscape
+// bookmark HTML (every browser's "Export Bookmarks"), Firefox JSON backups
+// and Chromium's Bookmarks file. The format is sniffed from the content.
+typedef struct _FRBookmarkImport FRBookmarkImport;
+
+typedef struct {
+    goffset bytes_read;
+    goffset total_bytes;
+    guint found;            // bookmarks read so far
+    guint added;            // found bookmarks inserted so far
+    guint skipped;          // duplicates and entries without a usable URL
+    double elapsed;         // seconds since the import started
+} FRBookmarkImportProgress;
+
+typedef void (*FRBookmarkImportProgressFunc)(const FRBookmarkImportProgress *progress,
+                                             gpointer user_data);
+typedef void (*FRBookmarkImportDoneFunc)(const FRBookmarkImportProgress *progress,
+                                         const GError *error, gpointer user_data);
+
+// Reads path one chunk per main loop iteration, then applies what it found a
+// chunk per iteration in one bookmark batch, so the store is written once and
+// a file that fails to parse changes nothing. done is called once the batch
+// is on disk; if the write failed, the batch has been undone.
+// done is always called exactly once; on failure the import has already
+// finished and NULL is returned.
+FRBookmarkImport* fr_bookmark_import_start(FRBookmarkManager *manager, const char *path,
+                                           FRBookmarkImportProgressFunc progress,
+                                           FRBookmarkImportDoneFunc done, gpointer user_data);
+// Stops reading; bookmarks read so far are added and saved. Does nothing
+// once reading is over.
+void fr_bookmark_import_cancel(FRBookmarkImport *import);
+
+// UI functions
+void fr_bookmark_import_show_dialog(GtkWindow *parent, FRBookmarkManager *manager);
+
+#endif // IMPORT_H
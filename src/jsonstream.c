@@ -0,0 +1,465 @@
+#include "jsonstream.h"
+#include <stdio.h>
+#include <string.h>
+
+#define JSON_STREAM_CHUNK_SIZE (64 * 1024)
+
+enum {
+    STATE_VALUE,            // a value must follow
+    STATE_VALUE_OR_END,     // just after '['
+    STATE_KEY_OR_END,       // just after '{'
+    STATE_KEY,              // after ',' inside an object
+    STATE_COLON,
+    STATE_STRING,
+    STATE_ESCAPE,
+    STATE_UNICODE,
+    STATE_LITERAL,
+    STATE_AFTER_VALUE,
+    STATE_DONE
+};
+
+static void json_record_clear(FRJsonRecord *record) {
+    g_ptr_array_set_size(record->keys, 0);
+    g_ptr_array_set_size(record->values, 0);
+}
+
+// Record mode: collect scalar members of each depth-2 object
+static void json_record_event(FRJsonStream *stream, FRJsonEvent event, const char *value,
+                              guint depth, gpointer user_data) {
+    switch (event) {
+        case FR_JSON_BEGIN_OBJECT:
+            if (depth == 2) {
+                json_record_clear(&stream->record);
+            }
+            break;
+        case FR_JSON_END_OBJECT:
+            if (depth == 1) {
+                stream->record_func(&stream->record, user_data);
+                json_record_clear(&stream->record);
+            }
+            break;
+        case FR_JSON_MEMBER:
+            if (depth == 2) {
+                g_free(stream->record_key);
+                stream->record_key = g_strdup(value);
+            }
+            break;
+        case FR_JSON_STRING:
+        case FR_JSON_NUMBER:
+        case FR_JSON_BOOLEAN:
+            if (depth == 2 && stream->record_key) {
+                g_ptr_array_add(stream->record.keys, stream->record_key);
+                g_ptr_array_add(stream->record.values, g_strdup(value));
+                stream->record_key = NULL;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+FRJsonStream* fr_json_stream_new(FRJsonEventFunc func, gpointer user_data) {
+    FRJsonStream *stream = g_malloc0(sizeof(FRJsonStream));
+    stream->state = STATE_VALUE;
+    stream->stack = g_byte_array_new();
+    stream->token = g_string_new(NULL);
+    stream->func = func;
+    stream->user_data = user_data;
+    return stream;
+}
+
+FRJsonStream* fr_json_stream_new_for_records(FRJsonRecordFunc func, gpointer user_data) {
+    FRJsonStream *stream = fr_json_stream_new(json_record_event, user_data);
+    stream->record_func = func;
+    stream->record.keys = g_ptr_array_new_with_free_func(g_free);
+    stream->record.values = g_ptr_array_new_with_free_func(g_free);
+    return stream;
+}
+
+void fr_json_stream_free(FRJsonStream *stream) {
+    if (!stream) return;
+    
+    g_byte_array_free(stream->stack, TRUE);
+    g_string_free(stream->token, TRUE);
+    if (stream->record.keys) {
+        g_ptr_array_unref(stream->record.keys);
+        g_ptr_array_unref(stream->record.values);
+    }
+    g_free(stream->record_key);
+    g_free(stream);
+}
+
+static void json_emit(FRJsonStream *stream, FRJsonEvent event, const char *value) {
+    stream->func(stream, event, value, stream->stack->len, stream->user_data);
+}
+
+static void json_after_value(FRJsonStream *stream) {
+    stream->state = stream->stack->len == 0 ? STATE_DONE : STATE_AFTER_VALUE;
+}
+
+static gboolean json_fail(FRJsonStream *stream, GError **error, const char *what) {
+    g_set_error(error, G_MARKUP_ERROR, 0, "Invalid JSON at byte %" G_GSIZE_FORMAT ": %s",
+                stream->offset, what);
+    return FALSE;
+}
+
+// A high surrogate not followed by a low one is replaced
+static void json_flush_surrogate(FRJsonStream *stream) {
+    if (stream->high_surrogate) {
+        g_string_append_unichar(stream->token, 0xFFFD);
+        stream->high_surrogate = 0;
+    }
+}
+
+static void json_append_unichar(FRJsonStream *stream, guint32 c) {
+    json_flush_surrogate(stream);
+    g_string_append_unichar(stream->token, c);
+}
+
+static gboolean json_finish_literal(FRJsonStream *stream, GError **error) {
+    const char *text = stream->token->str;
+    
+    if (strcmp(text, "true") == 0 || strcmp(text, "false") == 0) {
+        json_emit(stream, FR_JSON_BOOLEAN, text);
+    } else if (strcmp(text, "null") == 0) {
+        json_emit(stream, FR_JSON_NULL, NULL);
+    } else {
+        char *end = NULL;
+        g_ascii_strtod(text, &end);
+        if (end == text || *end != '\0') {
+            return json_fail(stream, error, "bad literal");
+        }
+        json_emit(stream, FR_JSON_NUMBER, text);
+    }
+    
+    json_after_value(stream);
+    return TRUE;
+}
+
+static gboolean json_begin_value(FRJsonStream *stream, char c, GError **error) {
+    switch (c) {
+        case '{':
+            g_byte_array_append(stream->stack, (const guint8*)"{", 1);
+            json_emit(stream, FR_JSON_BEGIN_OBJECT, NULL);
+            stream->state = STATE_KEY_OR_END;
+            return TRUE;
+        case '[':
+            g_byte_array_append(stream->stack, (const guint8*)"[", 1);
+            json_emit(stream, FR_JSON_BEGIN_ARRAY, NULL);
+            stream->state = STATE_VALUE_OR_END;
+            return TRUE;
+        case '"':
+            g_string_truncate(stream->token, 0);
+            stream->token_is_key = FALSE;
+            stream->state = STATE_STRING;
+            return TRUE;
+        default:
+            if (c == '-' || g_ascii_isalnum(c)) {
+                g_string_truncate(stream->token, 0);
+                g_string_append_c(stream->token, c);
+                stream->state = STATE_LITERAL;
+                return TRUE;
+            }
+            return json_fail(stream, error, "value expected");
+    }
+}
+
+static gboolean json_end_container(FRJsonStream *stream, char close) {
+    guint depth = stream->stack->len;
+    char open = depth > 0 ? (char)stream->stack->data[depth - 1] : 0;
+    
+    if ((close == '}' && open != '{') || (close == ']' && open != '[')) {
+        return FALSE;
+    }
+    
+    g_byte_array_set_size(stream->stack, depth - 1);
+    json_emit(stream, close == '}' ? FR_JSON_END_OBJECT : FR_JSON_END_ARRAY, NULL);
+    json_after_value(stream);
+    return TRUE;
+}
+
+gboolean fr_json_stream_feed(FRJsonStream *stream, const char *data, gsize length, GError **error) {
+    if (!stream || !data) return FALSE;
+    
+    for (gsize i = 0; i < length; i++, stream->offset++) {
+        char c = data[i];
+        gboolean space = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        
+        switch (stream->state) {
+            case STATE_VALUE_OR_END:
+                if (space) break;
+                if (c == ']') {
+                    json_end_container(stream, ']');
+                    break;
+                }
+                if (!json_begin_value(stream, c, error)) return FALSE;
+                break;
+            case STATE_VALUE:
+                if (space) break;
+                if (!json_begin_value(stream, c, error)) return FALSE;
+                break;
+            case STATE_KEY_OR_END:
+            case STATE_KEY:
+                if (space) break;
+                if (c == '}' && stream->state == STATE_KEY_OR_END) {
+                    json_end_container(stream, '}');
+                } else if (c == '"') {
+                    g_string_truncate(stream->token, 0);
+                    stream->token_is_key = TRUE;
+                    stream->state = STATE_STRING;
+                } else {
+                    return json_fail(stream, error, "member name expected");
+                }
+                break;
+            case STATE_COLON:
+                if (space) break;
+                if (c != ':') return json_fail(stream, error, "':' expected");
+                stream->state = STATE_VALUE;
+                break;
+            case STATE_STRING:
+                if (c == '"') {
+                    json_flush_surrogate(stream);
+                    if (stream->token_is_key) {
+                        json_emit(stream, FR_JSON_MEMBER, stream->token->str);
+                        stream->state = STATE_COLON;
+                    } else {
+                        json_emit(stream, FR_JSON_STRING, stream->token->str);
+                        json_after_value(stream);
+                    }
+                } else if (c == '\\') {
+                    stream->state = STATE_ESCAPE;
+                } else if ((guchar)c < 0x20) {
+                    return json_fail(stream, error, "control character in string");
+                } else {
+                    json_flush_surrogate(stream);
+                    g_string_append_c(stream->token, c);
+                }
+                break;
+            case STATE_ESCAPE: {
+                char unescaped = 0;
+                switch (c) {
+                    case '"': unescaped = '"'; break;
+                    case '\\': unescaped = '\\'; break;
+                    case '/': unescaped = '/'; break;
+                    case 'b': unescaped = '\b'; break;
+                    case 'f': unescaped = '\f'; break;
+                    case 'n': unescaped = '\n'; break;
+                    case 'r': unescaped = '\r'; break;
+                    case 't': unescaped = '\t'; break;
+                    case 'u':
+                        stream->unicode = 0;
+                        stream->unicode_digits = 0;
+                        stream->state = STATE_UNICODE;
+                        break;
+                    default:
+                        return json_fail(stream, error, "bad escape");
+                }
+                if (unescaped) {
+                    json_append_unichar(stream, (guchar)unescaped);
+                    stream->state = STATE_STRING;
+                }
+                break;
+            }
+            case STATE_UNICODE: {
+                int digit = g_ascii_xdigit_value(c);
+                if (digit < 0) return json_fail(stream, error, "bad \\u escape");
+                
+                stream->unicode = (stream->unicode << 4) | (guint32)digit;
+                if (++stream->unicode_digits < 4) break;
+                
+                guint32 code = stream->unicode;
+                if (code >= 0xD800 && code < 0xDC00) {
+                    json_flush_surrogate(stream);
+                    stream->high_surrogate = code;
+                } else if (code >= 0xDC00 && code < 0xE000) {
+                    if (stream->high_surrogate) {
+                        guint32 pair = 0x10000 + ((stream->high_surrogate - 0xD800) << 10) + (code - 0xDC00);
+                        stream->high_surrogate = 0;
+                        g_string_append_unichar(stream->token, pair);
+                    } else {
+                        json_append_unichar(stream, 0xFFFD);
+                    }
+                } else {
+                    json_append_unichar(stream, code);
+                }
+                stream->state = STATE_STRING;
+                break;
+            }
+            case STATE_LITERAL:
+                if (c == '-' || c == '+' || c == '.' || g_ascii_isalnum(c)) {
+                    g_string_append_c(stream->token, c);
+                    break;
+                }
+                if (!json_finish_literal(stream, error)) return FALSE;
+                // The terminating character belongs to what follows
+                i--;
+                stream->offset--;
+                break;
+            case STATE_AFTER_VALUE: {
+                if (space) break;
+                char open = (char)stream->stack->data[stream->stack->len - 1];
+                if (c == ',') {
+                    stream->state = open == '{' ? STATE_KEY : STATE_VALUE;
+                } else if (c == '}' || c == ']') {
+                    if (!json_end_container(stream, c)) {
+                        return json_fail(stream, error, "mismatched bracket");
+                    }
+                } else {
+                    return json_fail(stream, error, "',' expected");
+                }
+                break;
+            }
+            case STATE_DONE:
+                if (!space) return json_fail(stream, error, "trailing data");
+                break;
+        }
+    }
+    
+    return TRUE;
+}
+
+gboolean fr_json_stream_finish(FRJsonStream *stream, GError **error) {
+    if (!stream) return FALSE;
+    
+    if (stream->state == STATE_LITERAL && stream->stack->len == 0) {
+        if (!json_finish_literal(stream, error)) return FALSE;
+    }
+    if (stream->state != STATE_DONE) {
+        return json_fail(stream, error, "unexpected end of data");
+    }
+    
+    return TRUE;
+}
+
+gboolean fr_json_stream_parse_file(FRJsonStream *stream, const char *path, GError **error) {
+    if (!stream || !path) return FALSE;
+    
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "Could not open %s", path);
+        return FALSE;
+    }
+    
+    char *chunk = g_malloc(JSON_STREAM_CHUNK_SIZE);
+    gboolean success = TRUE;
+    size_t read;
+    
+    while (success && (read = fread(chunk, 1, JSON_STREAM_CHUNK_SIZE, file)) > 0) {
+        success = fr_json_stream_feed(stream, chunk, read, error);
+    }
+    if (success) {
+        success = fr_json_stream_finish(stream, error);
+    }
+    
+    g_free(chunk);
+    fclose(file);
+    return success;
+}
+
+typedef struct {
+    FRJsonStream *stream;
+    FILE *file;
+    char *chunk;
+    goffset total;
+    goffset done_bytes;
+    FRJsonProgressFunc progress;
+    FRJsonDoneFunc done;
+    gpointer user_data;
+} FRJsonFileJob;
+
+// Also the idle source's destroy notify, so removing the source cancels the job
+static void json_file_job_free(FRJsonFileJob *job) {
+    if (job->file) {
+        fclose(job->file);
+    }
+    fr_json_stream_free(job->stream);
+    g_free(job->chunk);
+    g_free(job);
+}
+
+static void json_file_job_finish(FRJsonFileJob *job, gboolean success, GError *error) {
+    job->done(success, error, job->user_data);
+    
+    if (error) {
+        g_error_free(error);
+    }
+}
+
+static gboolean json_file_job_step(gpointer user_data) {
+    FRJsonFileJob *job = (FRJsonFileJob*)user_data;
+    GError *error = NULL;
+    
+    size_t read = fread(job->chunk, 1, JSON_STREAM_CHUNK_SIZE, job->file);
+    if (read > 0) {
+        if (!fr_json_stream_feed(job->stream, job->chunk, read, &error)) {
+            json_file_job_finish(job, FALSE, error);
+            return G_SOURCE_REMOVE;
+        }
+        job->done_bytes += read;
+        if (job->progress) {
+            job->progress(job->done_bytes, job->total, job->user_data);
+        }
+        return G_SOURCE_CONTINUE;
+    }
+    
+    gboolean success = fr_json_stream_finish(job->stream, &error);
+    json_file_job_finish(job, success, error);
+    return G_SOURCE_REMOVE;
+}
+
+guint fr_json_stream_parse_file_async(FRJsonStream *stream, const char *path,
+                                      FRJsonProgressFunc progress, FRJsonDoneFunc done,
+                                      gpointer user_data) {
+    FRJsonFileJob *job = g_malloc0(sizeof(FRJsonFileJob));
+    job->stream = stream;
+    job->progress = progress;
+    job->done = done;
+    job->user_data = user_data;
+    job->file = path ? fopen(path, "rb") : NULL;
+    
+    if (!job->file) {
+        GError *error = g_error_new(G_FILE_ERROR, G_FILE_ERROR_NOENT, "Could not open %s",
+                                    path ? path : "(null)");
+        json_file_job_finish(job, FALSE, error);
+        json_file_job_free(job);
+        return 0;
+    }
+    
+    fseek(job->file, 0, SEEK_END);
+    job->total = ftell(job->file);
+    fseek(job->file, 0, SEEK_SET);
+    job->chunk = g_malloc(JSON_STREAM_CHUNK_SIZE);
+    
+    return g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, json_file_job_step, job,
+                           (GDestroyNotify)json_file_job_free);
+}
+
+static gint json_record_find(FRJsonRecord *record, const char *key) {
+    for (guint i = 0; i < record->keys->len; i++) {
+        if (strcmp(g_ptr_array_index(record->keys, i), key) == 0) {
+            return (gint)i;
+        }
+    }
+    return -1;
+}
+
+const char* fr_json_record_get_string(FRJsonRecord *record, const char *key) {
+    if (!record || !key) return NULL;
+    
+    gint index = json_record_find(record, key);
+    return index >= 0 ? g_ptr_array_index(record->values, index) : NULL;
+}
+
+gint64 fr_json_record_get_int(FRJsonRecord *record, const char *key, gint64 default_value) {
+    const char *value = fr_json_record_get_string(record, key);
+    return value ? g_ascii_strtoll(value, NULL, 10) : default_value;
+}
+
+double fr_json_record_get_double(FRJsonRecord *record, const char *key, double default_value) {
+    const char *value = fr_json_record_get_string(record, key);
+    return value ? g_ascii_strtod(value, NULL) : default_value;
+}
+
+gboolean fr_json_record_has(FRJsonRecord *record, const char *key) {
+    return record && key && json_record_find(record, key) >= 0;
+}
@@ -0,0 +1,77 @@
+#ifndef JSONSTREAM_H
+#define JSONSTREAM_H
+
+#include <glib.h>
+
+// Incremental JSON reader. Input can be fed in chunks of any size; events are
+// reported as soon as each token is complete, so memory use is bounded by the
+// longest single string rather than by the size of the document.
+typedef enum {
+    FR_JSON_BEGIN_OBJECT,
+    FR_JSON_END_OBJECT,
+    FR_JSON_BEGIN_ARRAY,
+    FR_JSON_END_ARRAY,
+    FR_JSON_MEMBER,         // value is the member name
+    FR_JSON_STRING,         // value is the unescaped string
+    FR_JSON_NUMBER,         // value is the number as written
+    FR_JSON_BOOLEAN,        // value is "true" or "false"
+    FR_JSON_NULL
+} FRJsonEvent;
+
+typedef struct _FRJsonStream FRJsonStream;
+
+// depth is the number of open containers after the event is applied
+typedef void (*FRJsonEventFunc)(FRJsonStream *stream, FRJsonEvent event, const char *value,
+                                guint depth, gpointer user_data);
+
+// Scalar members of one element of the top-level array
+typedef struct {
+    GPtrArray *keys;
+    GPtrArray *values;
+} FRJsonRecord;
+
+typedef void (*FRJsonRecordFunc)(FRJsonRecord *record, gpointer user_data);
+typedef void (*FRJsonProgressFunc)(goffset bytes_read, goffset total_bytes, gpointer user_data);
+typedef void (*FRJsonDoneFunc)(gboolean success, const GError *error, gpointer user_data);
+
+struct _FRJsonStream {
+    int state;
+    GByteArray *stack;      // '{' or '[' per open container
+    GString *token;
+    gboolean token_is_key;
+    guint32 unicode;
+    int unicode_digits;
+    guint32 high_surrogate;
+    gsize offset;           // bytes consumed, for error messages
+    FRJsonEventFunc func;
+    gpointer user_data;
+    
+    // Record mode, see fr_json_stream_new_for_records
+    FRJsonRecordFunc record_func;
+    FRJsonRecord record;
+    char *record_key;
+};
+
+FRJsonStream* fr_json_stream_new(FRJsonEventFunc func, gpointer user_data);
+FRJsonStream* fr_json_stream_new_for_records(FRJsonRecordFunc func, gpointer user_data);
+void fr_json_stream_free(FRJsonStream *stream);
+
+gboolean fr_json_stream_feed(FRJsonStream *stream, const char *data, gsize length, GError **error);
+gboolean fr_json_stream_finish(FRJsonStream *stream, GError **error);
+
+// Reads path in fixed-size chunks on the calling thread
+gboolean fr_json_stream_parse_file(FRJsonStream *stream, const char *path, GError **error);
+
+// Reads path one chunk per main loop idle iteration. The stream is freed when
+// parsing ends; done is called exactly once, unless the returned source is
+// removed first, which cancels parsing. Returns 0 if path cannot be opened.
+guint fr_json_stream_parse_file_async(FRJsonStream *stream, const char *path,
+                                      FRJsonProgressFunc progress, FRJsonDoneFunc done,
+                                      gpointer user_data);
+
+const char* fr_json_record_get_string(FRJsonRecord *record, const char *key);
+gint64 fr_json_record_get_int(FRJsonRecord *record, const char *key, gint64 default_value);
+double fr_json_record_get_double(FRJsonRecord *record, const char *key, double default_value);
+gboolean fr_json_record_has(FRJsonRecord *record, const char *key);
+
+#endif // JSONSTREAM_H
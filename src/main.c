@@ -6,6 +6,14 @@
 #include "window.h"
 #include "utils.h"
 
+static void on_omnibox_switch_tab(int tab_index, gpointer user_data) {
+    fr_browser_switch_tab((FRBrowser*)user_data, tab_index);
+}
+
+static FRTab* on_session_add_tab(guint id, const char *url, const char *title, gpointer user_data) {
+    return fr_browser_add_background_tab((FRBrowser*)user_data, id, url, title, FALSE);
+}
+
 static void activate(GtkApplication *app, gpointer user_data) {
     FRBrowser *browser = (FRBrowser*)user_data;
     
@@ -104,6 +112,21 @@ static void activate(GtkApplication *app, gpointer user_data) {
     gtk_notebook_set_show_tabs(GTK_NOTEBOOK(browser->notebook), TRUE);
     gtk_notebook_set_show_border(GTK_NOTEBOOK(browser->notebook), FALSE);
     gtk_box_pack_start(GTK_BOX(vbox), browser->notebook, TRUE, TRUE, 0);
+    browser->tab_discarder = fr_tab_discarder_new(GTK_NOTEBOOK(browser->notebook), browser->thumbnails);
+    browser->tab_overview = fr_tab_overview_new(GTK_NOTEBOOK(browser->notebook), browser->thumbnails);
+    browser->tab_throttler = fr_tab_throttler_new(browser->main_window, GTK_NOTEBOOK(browser->notebook),
+                                                  browser->tabs);
+    browser->ui_updater = fr_ui_updater_new(browser->main_window, browser->tabs, fr_browser_flush_ui, browser);
+    
+    // Favicons for tabs, menus and suggestions
+    browser->favicons = fr_favicon_cache_new(browser->web_context,
+                                             FR_FAVICON_CACHE_CAPACITY);
+    
+    // Autocomplete for the URL entry; connected before the activate handler below
+    browser->omnibox = fr_omnibox_new(GTK_ENTRY(browser->url_entry), GTK_NOTEBOOK(browser->notebook),
+                                      browser->history_manager, browser->bookmark_manager);
+    fr_omnibox_set_switch_tab_func(browser->omnibox, on_omnibox_switch_tab, browser);
+    fr_omnibox_set_favicons(browser->omnibox, browser->favicons);
     
     // Setup menu
     fr_window_setup_menu(browser);
@@ -118,8 +141,18 @@ static void activate(GtkApplication *app, gpointer user_data) {
     // URL entry activation
     g_signal_connect(browser->url_entry, "activate", G_CALLBACK(on_url_entry_activate), browser);
     
-    // Create initial tab
-    fr_browser_new_tab(browser, DEFAULT_HOME_PAGE);
+    // Bring back the last session as placeholders. Tab switches are watched
+    // only afterwards, so the tab that was selected is the only one loading.
+    browser->session = fr_session_new(browser->storage, GTK_NOTEBOOK(browser->notebook));
+    int active_tab = fr_session_restore(browser->session, on_session_add_tab, browser);
+    g_signal_connect(browser->notebook, "switch-page", G_CALLBACK(on_notebook_switch_page), browser);
+    
+    if (active_tab >= 0) {
+        fr_browser_switch_tab(browser, active_tab);
+    } else {
+        // Create initial tab
+        fr_browser_new_tab(browser, DEFAULT_HOME_PAGE);
+    }
     
     // Show all widgets
     gtk_widget_show_all(browser->main_window);
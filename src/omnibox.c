@@ -0,0 +1,645 @@
+#include "omnibox.h"
+#include "tabs.h"
+#include <webkit2/webkit2.h>
+#include <string.h>
+
+typedef struct {
+    const char *title;
+    const char *url;
+    const char *folded;     // folded "title\nurl"
+} FROmniboxBookmark;
+
+static FROmniboxMatch* omnibox_match_new(FROmniboxMatchType type, const char *title, const char *url) {
+    FROmniboxMatch *match = g_malloc0(sizeof(FROmniboxMatch));
+    match->type = type;
+    match->title = g_strdup(title && *title ? title : url);
+    match->url = g_strdup(url);
+    match->tab_index = -1;
+    return match;
+}
+
+static void omnibox_match_free(FROmniboxMatch *match) {
+    if (!match) return;
+    
+    g_free(match->title);
+    g_free(match->url);
+    g_free(match);
+}
+
+static gboolean omnibox_has_url(FROmnibox *omnibox, const char *url) {
+    for (guint i = 0; i < omnibox->matches->len; i++) {
+        FROmniboxMatch *match = g_ptr_array_index(omnibox->matches, i);
+        if (strcmp(match->url, url) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+static void omnibox_cancel(FROmnibox *omnibox) {
+    if (omnibox->job_source) {
+        g_source_remove(omnibox->job_source);
+        omnibox->job_source = 0;
+    }
+}
+
+// Sets the entry text without it counting as typing
+static void omnibox_replace_text(FROmnibox *omnibox, const char *text) {
+    omnibox->updating = TRUE;
+    gtk_entry_set_text(GTK_ENTRY(omnibox->entry), text ? text : "");
+    gtk_editable_set_position(GTK_EDITABLE(omnibox->entry), -1);
+    omnibox->updating = FALSE;
+}
+
+static void omnibox_reset_scan(FROmnibox *omnibox) {
+    if (omnibox->scan) {
+        g_array_unref(omnibox->scan);
+        omnibox->scan = NULL;
+    }
+    omnibox->scan_pos = 0;
+    omnibox->scan_iter = NULL;
+}
+
+// Matches the query against all of history: trigram candidates when the
+// query is long enough, otherwise every entry in ranking order
+static void omnibox_scan_history(FROmnibox *omnibox) {
+    omnibox_reset_scan(omnibox);
+    g_array_set_size(omnibox->matched, 0);
+    omnibox->matched_complete = FALSE;
+    
+    omnibox->scan = fr_history_manager_find_candidates(omnibox->history, omnibox->folded);
+    if (!omnibox->scan) {
+        omnibox->scan_iter = g_sequence_get_begin_iter(omnibox->history->ranking);
+    }
+    omnibox->scan_serial = omnibox->history->serial;
+}
+
+// The query extends the previous one, so only its matches can still match
+static void omnibox_refine_history(FROmnibox *omnibox) {
+    omnibox_reset_scan(omnibox);
+    omnibox->scan = omnibox->matched;
+    omnibox->matched = g_array_new(FALSE, FALSE, sizeof(guint));
+    omnibox->matched_complete = FALSE;
+}
+
+// Checks candidates until they run out or the deadline passes. Returns TRUE
+// once matched holds every entry containing the query.
+static gboolean omnibox_match_history(FROmnibox *omnibox, gint64 deadline) {
+    if (omnibox->history->serial != omnibox->scan_serial) {
+        // A visit landed between slices; ids and iterators may be stale
+        omnibox_scan_history(omnibox);
+    }
+    
+    guint checked = 0;
+    for (;;) {
+        FRHistoryEntry *entry;
+        
+        if (omnibox->scan) {
+            if (omnibox->scan_pos >= omnibox->scan->len) break;
+            entry = fr_history_manager_get_entry(omnibox->history,
+                                                 g_array_index(omnibox->scan, guint, omnibox->scan_pos++));
+        } else {
+            if (g_sequence_iter_is_end(omnibox->scan_iter)) break;
+            entry = (FRHistoryEntry*)g_sequence_get(omnibox->scan_iter);
+            omnibox->scan_iter = g_sequence_iter_next(omnibox->scan_iter);
+        }
+        
+        if (entry && entry->search_text && strstr(entry->search_text, omnibox->folded)) {
+            g_array_append_val(omnibox->matched, entry->id);
+        }
+        
+        if (++checked % 256 == 0 && g_get_monotonic_time() >= deadline) {
+            return FALSE;
+        }
+    }
+    
+    omnibox_reset_scan(omnibox);
+    omnibox->matched_complete = TRUE;
+    return TRUE;
+}
+
+static void omnibox_scan_bookmarks(FROmnibox *omnibox) {
+    if (omnibox->bookmark_scan) {
+        g_array_unref(omnibox->bookmark_scan);
+        omnibox->bookmark_scan = NULL;
+    }
+    omnibox->bookmark_scan_pos = 0;
+    omnibox->bookmark_scan_serial = omnibox->bookmark_serial;
+    g_array_set_size(omnibox->bookmark_matched, 0);
+    omnibox->bookmark_matched_complete = FALSE;
+}
+
+static void omnibox_refine_bookmarks(FROmnibox *omnibox) {
+    if (omnibox->bookmark_scan) {
+        g_array_unref(omnibox->bookmark_scan);
+    }
+    omnibox->bookmark_scan = omnibox->bookmark_matched;
+    omnibox->bookmark_scan_pos = 0;
+    omnibox->bookmark_matched = g_array_new(FALSE, FALSE, sizeof(guint));
+    omnibox->bookmark_matched_complete = FALSE;
+}
+
+// Like omnibox_match_history, over the folded bookmark cache
+static gboolean omnibox_match_bookmarks(FROmnibox *omnibox, gint64 deadline) {
+    if (omnibox->bookmark_serial != omnibox->bookmark_scan_serial) {
+        // The bookmarks changed between slices; cache indices are stale
+        omnibox_scan_bookmarks(omnibox);
+    }
+    
+    GArray *scan = omnibox->bookmark_scan;
+    guint count = scan ? scan->len : omnibox->bookmark_cache->len;
+    while (omnibox->bookmark_scan_pos < count) {
+        guint index = scan ? g_array_index(scan, guint, omnibox->bookmark_scan_pos)
+                           : omnibox->bookmark_scan_pos;
+        FROmniboxBookmark *bookmark = &g_array_index(omnibox->bookmark_cache, FROmniboxBookmark, index);
+        
+        if (strstr(bookmark->folded, omnibox->folded)) {
+            g_array_append_val(omnibox->bookmark_matched, index);
+        }
+        
+        if (++omnibox->bookmark_scan_pos % 256 == 0 && g_get_monotonic_time() >= deadline) {
+            return FALSE;
+        }
+    }
+    
+    if (scan) {
+        g_array_unref(scan);
+        omnibox->bookmark_scan = NULL;
+    }
+    omnibox->bookmark_matched_complete = TRUE;
+    return TRUE;
+}
+
+// History first, then bookmarks, each picking up where the last slice stopped
+static gboolean omnibox_match(FROmnibox *omnibox, gint64 deadline) {
+    return (omnibox->matched_complete || omnibox_match_history(omnibox, deadline)) &&
+           omnibox_match_bookmarks(omnibox, deadline);
+}
+
+static void omnibox_add_tab_matches(FROmnibox *omnibox) {
+    int pages = gtk_notebook_get_n_pages(GTK_NOTEBOOK(omnibox->notebook));
+    int current = gtk_notebook_get_current_page(GTK_NOTEBOOK(omnibox->notebook));
+    int added = 0;
+    
+    for (int i = 0; i < pages && added < FR_OMNIBOX_MAX_TAB_RESULTS; i++) {
+        if (i == current) continue;
+        
+        // Placeholder tabs match on what they were opened with
+        FRTab *tab = fr_tab_get(gtk_notebook_get_nth_page(GTK_NOTEBOOK(omnibox->notebook), i));
+        if (!tab || !tab->url) continue;
+        
+        const char *title = tab->title;
+        const char *uri = tab->url;
+        
+        char *text = g_strconcat(title ? title : "", "\n", uri, NULL);
+        char *folded = fr_trigram_fold(text);
+        if (strstr(folded, omnibox->folded)) {
+            FROmniboxMatch *match = omnibox_match_new(FR_OMNIBOX_MATCH_TAB, title, uri);
+            match->tab_index = i;
+            g_ptr_array_add(omnibox->matches, match);
+            added++;
+        }
+        g_free(folded);
+        g_free(text);
+    }
+}
+
+// Highest frecency matches, best first
+static void omnibox_add_history_matches(FROmnibox *omnibox, guint limit) {
+    GPtrArray *top = g_ptr_array_sized_new(limit + 1);
+    
+    for (guint i = 0; i < omnibox->matched->len; i++) {
+        FRHistoryEntry *entry = fr_history_manager_get_entry(omnibox->history,
+                                                             g_array_index(omnibox->matched, guint, i));
+        if (!entry) continue;
+        
+        guint pos = top->len;
+        while (pos > 0 && ((FRHistoryEntry*)g_ptr_array_index(top, pos - 1))->frecency < entry->frecency) {
+            pos--;
+        }
+        if (pos >= limit) continue;
+        
+        g_ptr_array_insert(top, pos, entry);
+        if (top->len > limit) {
+            g_ptr_array_set_size(top, limit);
+        }
+    }
+    
+    for (guint i = 0; i < top->len; i++) {
+        FRHistoryEntry *entry = g_ptr_array_index(top, i);
+        if (!omnibox_has_url(omnibox, entry->url)) {
+            g_ptr_array_add(omnibox->matches,
+                            omnibox_match_new(FR_OMNIBOX_MATCH_HISTORY, entry->title, entry->url));
+        }
+    }
+    
+    g_ptr_array_unref(top);
+}
+
+static void omnibox_add_bookmark_matches(FROmnibox *omnibox, guint limit) {
+    for (guint i = 0; i < omnibox->bookmark_matched->len; i++) {
+        FROmniboxBookmark *bookmark = &g_array_index(omnibox->bookmark_cache, FROmniboxBookmark,
+                                                     g_array_index(omnibox->bookmark_matched, guint, i));
+        gboolean known = FALSE;
+        for (guint m = 0; m < omnibox->matches->len; m++) {
+            FROmniboxMatch *match = g_ptr_array_index(omnibox->matches, m);
+            if (strcmp(match->url, bookmark->url) == 0) {
+                match->bookmarked = TRUE;
+                known = TRUE;
+            }
+        }
+        
+        if (!known && omnibox->matches->len < limit) {
+            FROmniboxMatch *match = omnibox_match_new(FR_OMNIBOX_MATCH_BOOKMARK, bookmark->title, bookmark->url);
+            match->bookmarked = TRUE;
+            g_ptr_array_add(omnibox->matches, match);
+        }
+    }
+}
+
+static void omnibox_cache_bookmarks(FROmnibox *omnibox) {
+    g_array_set_size(omnibox->bookmark_cache, 0);
+    g_string_chunk_clear(omnibox->bookmark_strings);
+    omnibox->bookmark_serial++;
+    
+    for (GList *l = fr_bookmark_manager_get_all(omnibox->bookmarks); l != NULL; l = l->next) {
+        FRBookmark *bookmark = (FRBookmark*)l->data;
+        char *text = g_strconcat(bookmark->title ? bookmark->title : "", "\n", bookmark->url, NULL);
+        char *folded = fr_trigram_fold(text);
+        
+        FROmniboxBookmark cached;
+        cached.title = g_string_chunk_insert(omnibox->bookmark_strings, bookmark->title ? bookmark->title : "");
+        cached.url = g_string_chunk_insert(omnibox->bookmark_strings, bookmark->url);
+        cached.folded = g_string_chunk_insert(omnibox->bookmark_strings, folded);
+        g_array_append_val(omnibox->bookmark_cache, cached);
+        
+        g_free(folded);
+        g_free(text);
+    }
+}
+
+// Part of url's host that follows typed, if typed is a prefix of the url
+// without its scheme (and without "www." unless typed starts with it)
+static const char* omnibox_host_suffix(const char *url, const char *typed, gsize *length) {
+    const char *start = strstr(url, "://");
+    start = start ? start + 3 : url;
+    if (g_ascii_strncasecmp(start, "www.", 4) == 0 && g_ascii_strncasecmp(typed, "www.", 4) != 0) {
+        start += 4;
+    }
+    
+    gsize typed_length = strlen(typed);
+    if (g_ascii_strncasecmp(start, typed, typed_length) != 0) return NULL;
+    
+    const char *host_end = start + strcspn(start, "/?#");
+    if (start + typed_length >= host_end) return NULL;
+    
+    *length = host_end - (start + typed_length);
+    return start + typed_length;
+}
+
+static void omnibox_complete_inline(FROmnibox *omnibox) {
+    if (!omnibox->complete_inline) return;
+    omnibox->complete_inline = FALSE;
+    
+    // Only complete what is still exactly what the user typed
+    if (strcmp(gtk_entry_get_text(GTK_ENTRY(omnibox->entry)), omnibox->typed) != 0 ||
+        strpbrk(omnibox->typed, " /") != NULL) {
+        return;
+    }
+    
+    for (guint i = 0; i < omnibox->matches->len; i++) {
+        FROmniboxMatch *match = g_ptr_array_index(omnibox->matches, i);
+        gsize length;
+        const char *suffix = omnibox_host_suffix(match->url, omnibox->typed, &length);
+        if (!suffix) continue;
+        
+        char *rest = g_strndup(suffix, length);
+        char *completed = g_strconcat(omnibox->typed, rest, NULL);
+        
+        omnibox->updating = TRUE;
+        gtk_entry_set_text(GTK_ENTRY(omnibox->entry), completed);
+        gtk_editable_select_region(GTK_EDITABLE(omnibox->entry),
+                                   (gint)g_utf8_strlen(omnibox->typed, -1), -1);
+        omnibox->updating = FALSE;
+        
+        g_free(completed);
+        g_free(rest);
+        return;
+    }
+}
+
+static GtkWidget* omnibox_create_row(FROmnibox *omnibox, FROmniboxMatch *match) {
+    GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_container_set_border_width(GTK_CONTAINER(row), 4);
+    
+    GtkWidget *icon = gtk_image_new();
+    gtk_widget_set_size_request(icon, FR_FAVICON_SIZE, FR_FAVICON_SIZE);
+    gtk_widget_set_valign(icon, GTK_ALIGN_START);
+    fr_favicon_cache_set_image(omnibox->favicons, GTK_IMAGE(icon), match->url);
+    gtk_box_pack_start(GTK_BOX(row), icon, FALSE, FALSE, 0);
+    
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_box_pack_start(GTK_BOX(row), box, TRUE, TRUE, 0);
+    
+    char *title = NULL;
+    switch (match->type) {
+        case FR_OMNIBOX_MATCH_TAB:
+            title = g_strdup_printf("Switch to tab: %s", match->title);
+            break;
+        default:
+            title = g_strdup_printf("%s%s", match->bookmarked ? "★ " : "", match->title);
+            break;
+    }
+    
+    GtkWidget *title_label = gtk_label_new(title);
+    gtk_label_set_xalign(GTK_LABEL(title_label), 0.0);
+    gtk_label_set_ellipsize(GTK_LABEL(title_label), PANGO_ELLIPSIZE_END);
+    gtk_box_pack_start(GTK_BOX(box), title_label, FALSE, FALSE, 0);
+    
+    GtkWidget *url_label = gtk_label_new(match->url);
+    gtk_label_set_xalign(GTK_LABEL(url_label), 0.0);
+    gtk_label_set_ellipsize(GTK_LABEL(url_label), PANGO_ELLIPSIZE_END);
+    gtk_style_context_add_class(gtk_widget_get_style_context(url_label), "dim-label");
+    gtk_box_pack_start(GTK_BOX(box), url_label, FALSE, FALSE, 0);
+    
+    g_free(title);
+    return row;
+}
+
+static void omnibox_show_results(FROmnibox *omnibox) {
+    g_ptr_array_set_size(omnibox->matches, 0);
+    
+    omnibox_add_tab_matches(omnibox);
+    guint limit = omnibox->matches->len + FR_OMNIBOX_MAX_RESULTS;
+    omnibox_add_history_matches(omnibox, FR_OMNIBOX_MAX_RESULTS);
+    omnibox_add_bookmark_matches(omnibox, limit);
+    
+    GList *rows = gtk_container_get_children(GTK_CONTAINER(omnibox->list_box));
+    for (GList *l = rows; l != NULL; l = l->next) {
+        gtk_widget_destroy(GTK_WIDGET(l->data));
+    }
+    g_list_free(rows);
+    
+    for (guint i = 0; i < omnibox->matches->len; i++) {
+        gtk_list_box_insert(GTK_LIST_BOX(omnibox->list_box),
+                            omnibox_create_row(omnibox, g_ptr_array_index(omnibox->matches, i)), -1);
+        // Rows must not take focus away from the entry
+        gtk_widget_set_can_focus(GTK_WIDGET(gtk_list_box_get_row_at_index(GTK_LIST_BOX(omnibox->list_box), i)),
+                                 FALSE);
+    }
+    
+    omnibox_complete_inline(omnibox);
+    
+    if (omnibox->matches->len == 0) {
+        gtk_popover_popdown(GTK_POPOVER(omnibox->popover));
+        return;
+    }
+    
+    gtk_widget_set_size_request(omnibox->list_box, gtk_widget_get_allocated_width(omnibox->entry), -1);
+    gtk_widget_show_all(omnibox->list_box);
+    gtk_popover_popup(GTK_POPOVER(omnibox->popover));
+}
+
+static gboolean omnibox_job_step(gpointer user_data) {
+    FROmnibox *omnibox = (FROmnibox*)user_data;
+    
+    if (!omnibox_match(omnibox, g_get_monotonic_time() + FR_OMNIBOX_BUDGET_USEC)) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    omnibox->job_source = 0;
+    omnibox_show_results(omnibox);
+    return G_SOURCE_REMOVE;
+}
+
+static void omnibox_query(FROmnibox *omnibox) {
+    omnibox_cancel(omnibox);
+    
+    if (!omnibox->typed || *omnibox->typed == '\0' || !gtk_widget_has_focus(omnibox->entry)) {
+        fr_omnibox_hide(omnibox);
+        return;
+    }
+    
+    char *folded = fr_trigram_fold(omnibox->typed);
+    gboolean extends = omnibox->folded && g_str_has_prefix(folded, omnibox->folded);
+    g_free(omnibox->folded);
+    omnibox->folded = folded;
+    
+    if (extends && omnibox->matched_complete && omnibox->scan_serial == omnibox->history->serial) {
+        omnibox_refine_history(omnibox);
+    } else {
+        omnibox_scan_history(omnibox);
+    }
+    if (extends && omnibox->bookmark_matched_complete &&
+        omnibox->bookmark_scan_serial == omnibox->bookmark_serial) {
+        omnibox_refine_bookmarks(omnibox);
+    } else {
+        omnibox_scan_bookmarks(omnibox);
+    }
+    
+    // Most queries finish within the first slice; the rest continue from idle
+    if (!omnibox_match(omnibox, g_get_monotonic_time() + FR_OMNIBOX_BUDGET_USEC)) {
+        omnibox->job_source = g_idle_add(omnibox_job_step, omnibox);
+        return;
+    }
+    
+    omnibox_show_results(omnibox);
+}
+
+static void on_omnibox_changed(GtkEditable *editable, gpointer user_data) {
+    FROmnibox *omnibox = (FROmnibox*)user_data;
+    if (omnibox->updating) return;
+    
+    const char *text = gtk_entry_get_text(GTK_ENTRY(omnibox->entry));
+    
+    // Complete inline only while typing forward; after a deletion the
+    // completion would just put back what was deleted
+    omnibox->complete_inline = !omnibox->typed ||
+                               (strlen(text) > strlen(omnibox->typed) && g_str_has_prefix(text, omnibox->typed));
+    
+    g_free(omnibox->typed);
+    omnibox->typed = g_strdup(text);
+    omnibox_query(omnibox);
+}
+
+static FROmniboxMatch* omnibox_get_selected(FROmnibox *omnibox) {
+    GtkListBoxRow *row = gtk_list_box_get_selected_row(GTK_LIST_BOX(omnibox->list_box));
+    if (!row) return NULL;
+    
+    int index = gtk_list_box_row_get_index(row);
+    return index >= 0 && index < (int)omnibox->matches->len ? g_ptr_array_index(omnibox->matches, index) : NULL;
+}
+
+static void omnibox_move_selection(FROmnibox *omnibox, int delta) {
+    GtkListBoxRow *row = gtk_list_box_get_selected_row(GTK_LIST_BOX(omnibox->list_box));
+    int index = row ? gtk_list_box_row_get_index(row) + delta
+                    : (delta > 0 ? 0 : (int)omnibox->matches->len - 1);
+    
+    // Moving past either end goes back to the typed text
+    if (index < 0 || index >= (int)omnibox->matches->len) {
+        gtk_list_box_unselect_all(GTK_LIST_BOX(omnibox->list_box));
+        omnibox_replace_text(omnibox, omnibox->typed);
+        return;
+    }
+    
+    gtk_list_box_select_row(GTK_LIST_BOX(omnibox->list_box),
+                            gtk_list_box_get_row_at_index(GTK_LIST_BOX(omnibox->list_box), index));
+    omnibox_replace_text(omnibox, ((FROmniboxMatch*)g_ptr_array_index(omnibox->matches, index))->url);
+}
+
+static gboolean on_omnibox_key_press(GtkWidget *widget, GdkEventKey *event, gpointer user_data) {
+    FROmnibox *omnibox = (FROmnibox*)user_data;
+    if (!gtk_widget_get_visible(omnibox->popover)) return FALSE;
+    
+    switch (event->keyval) {
+        case GDK_KEY_Down:
+            omnibox_move_selection(omnibox, 1);
+            return TRUE;
+        case GDK_KEY_Up:
+            omnibox_move_selection(omnibox, -1);
+            return TRUE;
+        case GDK_KEY_Escape:
+            fr_omnibox_hide(omnibox);
+            omnibox_replace_text(omnibox, omnibox->typed);
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+// Connected ahead of the navigation handler so a tab match can switch tabs
+// instead of loading its url again
+static void on_omnibox_activate(GtkEntry *entry, gpointer user_data) {
+    FROmnibox *omnibox = (FROmnibox*)user_data;
+    FROmniboxMatch *match = omnibox_get_selected(omnibox);
+    int tab_index = match && match->type == FR_OMNIBOX_MATCH_TAB &&
+                    strcmp(gtk_entry_get_text(entry), match->url) == 0 ? match->tab_index : -1;
+    
+    fr_omnibox_hide(omnibox);
+    
+    if (tab_index >= 0 && omnibox->switch_tab) {
+        g_signal_stop_emission_by_name(entry, "activate");
+        omnibox->switch_tab(tab_index, omnibox->switch_tab_data);
+    }
+}
+
+static void on_omnibox_row_activated(GtkListBox *list_box, GtkListBoxRow *row, gpointer user_data) {
+    FROmnibox *omnibox = (FROmnibox*)user_data;
+    int index = gtk_list_box_row_get_index(row);
+    if (index < 0 || index >= (int)omnibox->matches->len) return;
+    
+    gtk_list_box_select_row(list_box, row);
+    omnibox_replace_text(omnibox, ((FROmniboxMatch*)g_ptr_array_index(omnibox->matches, index))->url);
+    gtk_widget_activate(omnibox->entry);
+}
+
+// Once per change or committed batch, so an import refolds the cache only once
+static void on_omnibox_bookmarks_changed(FRBookmarkManager *manager, gpointer user_data) {
+    omnibox_cache_bookmarks((FROmnibox*)user_data);
+}
+
+static gboolean on_omnibox_focus_out(GtkWidget *widget, GdkEventFocus *event, gpointer user_data) {
+    fr_omnibox_hide((FROmnibox*)user_data);
+    return FALSE;
+}
+
+static void on_omnibox_entry_destroy(GtkWidget *widget, gpointer user_data) {
+    FROmnibox *omnibox = (FROmnibox*)user_data;
+    
+    omnibox_cancel(omnibox);
+    omnibox->entry = NULL;
+    omnibox->popover = NULL;
+    omnibox->list_box = NULL;
+}
+
+FROmnibox* fr_omnibox_new(GtkEntry *entry, GtkNotebook *notebook,
+                          FRHistoryManager *history, FRBookmarkManager *bookmarks) {
+    if (!entry || !notebook || !history || !bookmarks) return NULL;
+    
+    FROmnibox *omnibox = g_malloc0(sizeof(FROmnibox));
+    omnibox->entry = GTK_WIDGET(entry);
+    omnibox->notebook = GTK_WIDGET(notebook);
+    omnibox->history = history;
+    omnibox->bookmarks = bookmarks;
+    omnibox->matches = g_ptr_array_new_with_free_func((GDestroyNotify)omnibox_match_free);
+    omnibox->matched = g_array_new(FALSE, FALSE, sizeof(guint));
+    omnibox->bookmark_cache = g_array_new(FALSE, FALSE, sizeof(FROmniboxBookmark));
+    omnibox->bookmark_strings = g_string_chunk_new(16 * 1024);
+    omnibox->bookmark_matched = g_array_new(FALSE, FALSE, sizeof(guint));
+    omnibox_cache_bookmarks(omnibox);
+    omnibox->bookmarks_handler = fr_bookmark_manager_connect_changed(bookmarks, on_omnibox_bookmarks_changed,
+                                                                     omnibox);
+    
+    // Not modal, so typing keeps going to the entry
+    omnibox->popover = gtk_popover_new(omnibox->entry);
+    gtk_popover_set_modal(GTK_POPOVER(omnibox->popover), FALSE);
+    gtk_popover_set_position(GTK_POPOVER(omnibox->popover), GTK_POS_BOTTOM);
+    
+    omnibox->list_box = gtk_list_box_new();
+    gtk_list_box_set_selection_mode(GTK_LIST_BOX(omnibox->list_box), GTK_SELECTION_SINGLE);
+    gtk_widget_set_can_focus(omnibox->list_box, FALSE);
+    gtk_container_add(GTK_CONTAINER(omnibox->popover), omnibox->list_box);
+    
+    g_signal_connect(omnibox->entry, "changed", G_CALLBACK(on_omnibox_changed), omnibox);
+    g_signal_connect(omnibox->entry, "activate", G_CALLBACK(on_omnibox_activate), omnibox);
+    g_signal_connect(omnibox->entry, "key-press-event", G_CALLBACK(on_omnibox_key_press), omnibox);
+    g_signal_connect(omnibox->entry, "focus-out-event", G_CALLBACK(on_omnibox_focus_out), omnibox);
+    g_signal_connect(omnibox->entry, "destroy", G_CALLBACK(on_omnibox_entry_destroy), omnibox);
+    g_signal_connect(omnibox->list_box, "row-activated", G_CALLBACK(on_omnibox_row_activated), omnibox);
+    
+    return omnibox;
+}
+
+void fr_omnibox_free(FROmnibox *omnibox) {
+    if (!omnibox) return;
+    
+    omnibox_cancel(omnibox);
+    if (omnibox->entry) {
+        g_signal_handlers_disconnect_by_data(omnibox->entry, omnibox);
+    }
+    if (omnibox->list_box) {
+        g_signal_handlers_disconnect_by_data(omnibox->list_box, omnibox);
+    }
+    
+    fr_bookmark_manager_disconnect_changed(omnibox->bookmarks, omnibox->bookmarks_handler);
+    
+    omnibox_reset_scan(omnibox);
+    omnibox_scan_bookmarks(omnibox);
+    g_array_unref(omnibox->bookmark_matched);
+    g_array_unref(omnibox->matched);
+    g_ptr_array_unref(omnibox->matches);
+    g_array_unref(omnibox->bookmark_cache);
+    g_string_chunk_free(omnibox->bookmark_strings);
+    g_free(omnibox->typed);
+    g_free(omnibox->folded);
+    g_free(omnibox);
+}
+
+void fr_omnibox_set_switch_tab_func(FROmnibox *omnibox, FROmniboxSwitchTabFunc func,
+                                    gpointer user_data) {
+    if (!omnibox) return;
+    
+    omnibox->switch_tab = func;
+    omnibox->switch_tab_data = user_data;
+}
+
+void fr_omnibox_set_favicons(FROmnibox *omnibox, FRFaviconCache *favicons) {
+    if (!omnibox) return;
+    
+    omnibox->favicons = favicons;
+}
+
+void fr_omnibox_set_text(FROmnibox *omnibox, const char *text) {
+    if (!omnibox || !omnibox->entry) return;
+    
+    fr_omnibox_hide(omnibox);
+    omnibox_replace_text(omnibox, text);
+    g_free(omnibox->typed);
+    omnibox->typed = NULL;
+}
+
+void fr_omnibox_hide(FROmnibox *omnibox) {
+    if (!omnibox || !omnibox->popover) return;
+    
+    omnibox_cancel(omnibox);
+    gtk_list_box_unselect_all(GTK_LIST_BOX(omnibox->list_box));
+    gtk_popover_popdown(GTK_POPOVER(omnibox->popover));
+}
@@ -0,0 +1,85 @@
+#ifndef OMNIBOX_H
+#define OMNIBOX_H
+
+#include <gtk/gtk.h>
+#include <glib.h>
+#include "bookmarks.h"
+#include "history.h"
+
+#define FR_OMNIBOX_MAX_RESULTS 8
+#define FR_OMNIBOX_MAX_TAB_RESULTS 3
+// Matching work done per keystroke or idle slice, in microseconds (one frame)
+#define FR_OMNIBOX_BUDGET_USEC 8000
+
+typedef enum {
+    FR_OMNIBOX_MATCH_TAB,
+    FR_OMNIBOX_MATCH_HISTORY,
+    FR_OMNIBOX_MATCH_BOOKMARK
+} FROmniboxMatchType;
+
+typedef struct {
+    FROmniboxMatchType type;
+    char *title;
+    char *url;
+    int tab_index;          // notebook page for tab matches
+    gboolean bookmarked;
+} FROmniboxMatch;
+
+typedef void (*FROmniboxSwitchTabFunc)(int tab_index, gpointer user_data);
+
+// As-you-type suggestions for the URL entry from open tabs, history and
+// bookmarks. Each keystroke that extends the previous query filters the
+// previous matches instead of searching again; matching runs in slices of
+// FR_OMNIBOX_BUDGET_USEC and a new keystroke cancels the slice still pending.
+typedef struct {
+    GtkWidget *entry;
+    GtkWidget *notebook;
+    FRHistoryManager *history;
+    FRBookmarkManager *bookmarks;
+    FRFaviconCache *favicons;
+    FROmniboxSwitchTabFunc switch_tab;
+    gpointer switch_tab_data;
+    
+    GtkWidget *popover;
+    GtkWidget *list_box;
+    GPtrArray *matches;     // FROmniboxMatch*, one per list row
+    char *typed;            // entry text as typed, without inline completion
+    gboolean updating;      // the entry text is being set by us
+    gboolean complete_inline;
+    
+    // History matching for the current query
+    guint job_source;
+    char *folded;           // folded query being matched
+    GArray *scan;           // candidate ids being checked; NULL while walking the ranking
+    guint scan_pos;
+    GSequenceIter *scan_iter;
+    guint scan_serial;      // history serial the scan started at
+    GArray *matched;        // ids of history entries containing folded
+    gboolean matched_complete;
+    
+    // Folded bookmark text, rebuilt whenever the bookmarks change
+    GArray *bookmark_cache; // FROmniboxBookmark
+    GStringChunk *bookmark_strings;
+    guint bookmark_serial;  // bumped by every rebuild
+    guint bookmarks_handler;
+    
+    // Bookmark matching for the current query
+    GArray *bookmark_scan;  // cache indices being checked; NULL while walking the whole cache
+    guint bookmark_scan_pos;
+    guint bookmark_scan_serial; // cache serial the scan started at
+    GArray *bookmark_matched; // cache indices of bookmarks containing folded
+    gboolean bookmark_matched_complete;
+} FROmnibox;
+
+FROmnibox* fr_omnibox_new(GtkEntry *entry, GtkNotebook *notebook,
+                          FRHistoryManager *history, FRBookmarkManager *bookmarks);
+void fr_omnibox_free(FROmnibox *omnibox);
+void fr_omnibox_set_switch_tab_func(FROmnibox *omnibox, FROmniboxSwitchTabFunc func,
+                                    gpointer user_data);
+void fr_omnibox_set_favicons(FROmnibox *omnibox, FRFaviconCache *favicons);
+
+// Replaces the entry text without treating it as typing
+void fr_omnibox_set_text(FROmnibox *omnibox, const char *text);
+void fr_omnibox_hide(FROmnibox *omnibox);
+
+#endif // OMNIBOX_H
@@ -0,0 +1,138 @@
+#include "overview.h"
+
+#define OVERVIEW_TILE_HEIGHT (FR_THUMBNAIL_WIDTH * 5 / 8)
+
+FRTabOverview* fr_tab_overview_new(GtkNotebook *notebook, FRThumbnailCache *thumbnails) {
+    FRTabOverview *overview = g_malloc0(sizeof(FRTabOverview));
+    overview->notebook = notebook;
+    overview->thumbnails = thumbnails;
+    return overview;
+}
+
+void fr_tab_overview_free(FRTabOverview *overview) {
+    if (!overview) return;
+    
+    if (overview->window) {
+        gtk_widget_destroy(overview->window);
+    }
+    g_free(overview);
+}
+
+static void overview_set_thumbnail(GtkImage *image, cairo_surface_t *thumbnail) {
+    if (thumbnail) {
+        gtk_image_set_from_surface(image, thumbnail);
+    } else {
+        gtk_image_set_from_icon_name(image, "text-html", GTK_ICON_SIZE_DIALOG);
+    }
+}
+
+// Tabs closed meanwhile never get here, so tab is still alive
+static void on_overview_thumbnail(FRTab *tab, cairo_surface_t *thumbnail, gpointer user_data) {
+    FRTabOverview *overview = (FRTabOverview*)user_data;
+    if (!overview->window || !thumbnail) return;
+    
+    GtkImage *image = g_hash_table_lookup(overview->images, GUINT_TO_POINTER(tab->id));
+    if (image) {
+        overview_set_thumbnail(image, thumbnail);
+    }
+}
+
+static GtkWidget* overview_tile_new(FRTabOverview *overview, FRTab *tab) {
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
+    gtk_container_set_border_width(GTK_CONTAINER(box), 6);
+    
+    // Every tile is the size of a full thumbnail, so the grid does not jump
+    // when a capture lands
+    GtkWidget *image = gtk_image_new();
+    gtk_widget_set_size_request(image, FR_THUMBNAIL_WIDTH, OVERVIEW_TILE_HEIGHT);
+    overview_set_thumbnail(GTK_IMAGE(image), fr_thumbnail_cache_lookup(overview->thumbnails, tab->id));
+    g_hash_table_insert(overview->images, GUINT_TO_POINTER(tab->id), image);
+    
+    GtkWidget *label = gtk_label_new(tab->title ? tab->title : tab->url);
+    gtk_label_set_ellipsize(GTK_LABEL(label), PANGO_ELLIPSIZE_END);
+    gtk_label_set_max_width_chars(GTK_LABEL(label), 1);
+    gtk_widget_set_size_request(label, FR_THUMBNAIL_WIDTH, -1);
+    
+    gtk_box_pack_start(GTK_BOX(box), image, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(box), label, FALSE, FALSE, 0);
+    
+    GtkWidget *child = gtk_flow_box_child_new();
+    gtk_container_add(GTK_CONTAINER(child), box);
+    g_object_set_data(G_OBJECT(child), "page-widget", tab->page);
+    return child;
+}
+
+static void on_overview_child_activated(GtkFlowBox *flow_box, GtkFlowBoxChild *child, gpointer user_data) {
+    FRTabOverview *overview = (FRTabOverview*)user_data;
+    
+    // Pages can close themselves while the overview is open
+    GtkWidget *page = GTK_WIDGET(g_object_get_data(G_OBJECT(child), "page-widget"));
+    int page_num = gtk_notebook_page_num(overview->notebook, page);
+    if (page_num >= 0) {
+        gtk_notebook_set_current_page(overview->notebook, page_num);
+    }
+    gtk_widget_destroy(overview->window);
+}
+
+static gboolean on_overview_key_press(GtkWidget *widget, GdkEventKey *event, gpointer user_data) {
+    if (event->keyval != GDK_KEY_Escape) return FALSE;
+    
+    gtk_widget_destroy(widget);
+    return TRUE;
+}
+
+static void on_overview_destroy(GtkWidget *widget, gpointer user_data) {
+    FRTabOverview *overview = (FRTabOverview*)user_data;
+    
+    overview->window = NULL;
+    g_clear_pointer(&overview->images, g_hash_table_destroy);
+}
+
+void fr_tab_overview_show(FRTabOverview *overview, GtkWindow *parent) {
+    if (!overview) return;
+    
+    if (overview->window) {
+        gtk_window_present(GTK_WINDOW(overview->window));
+        return;
+    }
+    
+    overview->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(overview->window), "Tabs");
+    gtk_window_set_transient_for(GTK_WINDOW(overview->window), parent);
+    gtk_window_set_modal(GTK_WINDOW(overview->window), TRUE);
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(overview->window), TRUE);
+    gtk_window_set_default_size(GTK_WINDOW(overview->window), 3 * (FR_THUMBNAIL_WIDTH + 24), 600);
+    overview->images = g_hash_table_new(NULL, NULL);
+    
+    GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    GtkWidget *flow_box = gtk_flow_box_new();
+    gtk_flow_box_set_homogeneous(GTK_FLOW_BOX(flow_box), TRUE);
+    gtk_flow_box_set_selection_mode(GTK_FLOW_BOX(flow_box), GTK_SELECTION_SINGLE);
+    gtk_flow_box_set_activate_on_single_click(GTK_FLOW_BOX(flow_box), TRUE);
+    gtk_widget_set_valign(flow_box, GTK_ALIGN_START);
+    gtk_container_add(GTK_CONTAINER(scrolled), flow_box);
+    gtk_container_add(GTK_CONTAINER(overview->window), scrolled);
+    
+    int current = gtk_notebook_get_current_page(overview->notebook);
+    int pages = gtk_notebook_get_n_pages(overview->notebook);
+    for (int i = 0; i < pages; i++) {
+        FRTab *tab = fr_tab_get(gtk_notebook_get_nth_page(overview->notebook, i));
+        if (!tab) continue;
+        
+        GtkWidget *child = overview_tile_new(overview, tab);
+        gtk_flow_box_insert(GTK_FLOW_BOX(flow_box), child, -1);
+        
+        // Hidden views cannot be drawn, but the selected one is on screen
+        // and its thumbnail may be from before the last scroll
+        if (i == current) {
+            gtk_flow_box_select_child(GTK_FLOW_BOX(flow_box), GTK_FLOW_BOX_CHILD(child));
+            fr_thumbnail_cache_capture(overview->thumbnails, tab, on_overview_thumbnail, overview);
+        }
+    }
+    
+    g_signal_connect(flow_box, "child-activated", G_CALLBACK(on_overview_child_activated), overview);
+    g_signal_connect(overview->window, "key-press-event", G_CALLBACK(on_overview_key_press), overview);
+    g_signal_connect(overview->window, "destroy", G_CALLBACK(on_overview_destroy), overview);
+    gtk_widget_show_all(overview->window);
+}
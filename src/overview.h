@@ -0,0 +1,25 @@
+#ifndef OVERVIEW_H
+#define OVERVIEW_H
+
+#include <gtk/gtk.h>
+#include <glib.h>
+#include "tabs.h"
+#include "thumbnail.h"
+
+// A grid of every tab's thumbnail in notebook order; choosing one selects
+// that tab. It draws only what the thumbnail cache already holds, already
+// scaled down, so opening it takes no snapshots beyond refreshing the
+// selected tab's. Tabs without a thumbnail show an icon until one arrives.
+typedef struct {
+    GtkNotebook *notebook;
+    FRThumbnailCache *thumbnails;
+    GtkWidget *window;          // NULL while closed
+    GHashTable *images;         // tab id -> GtkImage*, while open
+} FRTabOverview;
+
+FRTabOverview* fr_tab_overview_new(GtkNotebook *notebook, FRThumbnailCache *thumbnails);
+// Free after the thumbnail cache, whose captures may still report to it
+void fr_tab_overview_free(FRTabOverview *overview);
+void fr_tab_overview_show(FRTabOverview *overview, GtkWindow *parent);
+
+#endif // OVERVIEW_H
@@ -0,0 +1,325 @@
+#include "session.h"
+#include "jsonstream.h"
+#include "utils.h"
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+
+// One tab of the index, copied for the storage thread
+typedef struct {
+    guint id;
+    char *url;
+    char *title;
+    gboolean active;
+} FRSessionRecord;
+
+static void session_record_clear(FRSessionRecord *record) {
+    g_free(record->url);
+    g_free(record->title);
+}
+
+static char* session_state_path(FRSession *session, guint id) {
+    char *name = g_strdup_printf("tab-%u.state", id);
+    char *path = g_build_filename(session->directory, name, NULL);
+    g_free(name);
+    return path;
+}
+
+// Runs on the storage thread
+static char* session_serialize_index(gpointer snapshot, gsize *length) {
+    GArray *records = (GArray*)snapshot;
+    
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_array(builder);
+    
+    for (guint i = 0; i < records->len; i++) {
+        FRSessionRecord *record = &g_array_index(records, FRSessionRecord, i);
+        
+        json_builder_begin_object(builder);
+        
+        json_builder_set_member_name(builder, "id");
+        json_builder_add_int_value(builder, record->id);
+        
+        json_builder_set_member_name(builder, "url");
+        json_builder_add_string_value(builder, record->url ? record->url : "");
+        
+        json_builder_set_member_name(builder, "title");
+        json_builder_add_string_value(builder, record->title ? record->title : "");
+        
+        if (record->active) {
+            json_builder_set_member_name(builder, "active");
+            json_builder_add_boolean_value(builder, TRUE);
+        }
+        
+        json_builder_end_object(builder);
+    }
+    
+    json_builder_end_array(builder);
+    
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    
+    char *json_data = json_generator_to_data(generator, length);
+    
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+    
+    return json_data;
+}
+
+// Runs on the storage thread
+static char* session_serialize_state(gpointer snapshot, gsize *length) {
+    gsize size = 0;
+    gconstpointer data = g_bytes_get_data((GBytes*)snapshot, &size);
+    
+    char *contents = g_malloc(size);
+    memcpy(contents, data, size);
+    *length = size;
+    return contents;
+}
+
+static void session_write_state(FRSession *session, FRTab *tab) {
+    WebKitWebViewSessionState *state = NULL;
+    
+    // Discarded tabs still hold the state they had; placeholders that never
+    // loaded have nothing but their url
+    if (tab->web_view) {
+        state = webkit_web_view_get_session_state(tab->web_view);
+    } else if (tab->session_state) {
+        state = webkit_web_view_session_state_ref(tab->session_state);
+    }
+    if (!state) return;
+    
+    char *path = session_state_path(session, tab->id);
+    fr_storage_write(session->storage, path, webkit_web_view_session_state_serialize(state),
+                     session_serialize_state, (GDestroyNotify)g_bytes_unref);
+    g_free(path);
+    webkit_web_view_session_state_unref(state);
+}
+
+static void session_write_index(FRSession *session) {
+    int pages = gtk_notebook_get_n_pages(session->notebook);
+    int current = gtk_notebook_get_current_page(session->notebook);
+    GArray *records = g_array_sized_new(FALSE, TRUE, sizeof(FRSessionRecord), pages);
+    g_array_set_clear_func(records, (GDestroyNotify)session_record_clear);
+    
+    for (int i = 0; i < pages; i++) {
+        FRTab *tab = fr_tab_get(gtk_notebook_get_nth_page(session->notebook, i));
+        if (!tab || !tab->url) continue;
+        
+        FRSessionRecord record = { tab->id, g_strdup(tab->url), g_strdup(tab->title), i == current };
+        g_array_append_val(records, record);
+    }
+    
+    fr_storage_write(session->storage, session->index_file, records,
+                     session_serialize_index, (GDestroyNotify)g_array_unref);
+}
+
+void fr_session_checkpoint(FRSession *session) {
+    if (!session || session->closed) return;
+    
+    if (session->checkpoint_source) {
+        g_source_remove(session->checkpoint_source);
+        session->checkpoint_source = 0;
+    }
+    
+    // State files are queued ahead of the index naming them
+    GHashTableIter iter;
+    gpointer tab;
+    g_hash_table_iter_init(&iter, session->dirty);
+    while (g_hash_table_iter_next(&iter, &tab, NULL)) {
+        session_write_state(session, (FRTab*)tab);
+    }
+    g_hash_table_remove_all(session->dirty);
+    
+    if (session->index_dirty) {
+        session_write_index(session);
+        session->index_dirty = FALSE;
+    }
+}
+
+static gboolean on_session_checkpoint(gpointer user_data) {
+    FRSession *session = (FRSession*)user_data;
+    
+    session->checkpoint_source = 0;
+    fr_session_checkpoint(session);
+    return G_SOURCE_REMOVE;
+}
+
+static void session_schedule(FRSession *session) {
+    if (session->closed || session->checkpoint_source) return;
+    
+    session->checkpoint_source = g_timeout_add(FR_SESSION_CHECKPOINT_MS, on_session_checkpoint, session);
+}
+
+void fr_session_tab_changed(FRSession *session, FRTab *tab) {
+    if (!session || !tab || session->closed) return;
+    
+    g_hash_table_add(session->dirty, tab);
+    session->index_dirty = TRUE;
+    session_schedule(session);
+}
+
+void fr_session_index_changed(FRSession *session) {
+    if (!session || session->closed) return;
+    
+    session->index_dirty = TRUE;
+    session_schedule(session);
+}
+
+static void on_session_notebook_changed(GtkNotebook *notebook, GtkWidget *page, guint page_num,
+                                        gpointer user_data) {
+    FRSession *session = (FRSession*)user_data;
+    
+    session->index_dirty = TRUE;
+    session_schedule(session);
+}
+
+static void on_session_page_removed(GtkNotebook *notebook, GtkWidget *page, guint page_num,
+                                    gpointer user_data) {
+    FRSession *session = (FRSession*)user_data;
+    
+    // The tab is freed with its page; its state file is pruned at next start
+    g_hash_table_remove(session->dirty, fr_tab_get(page));
+    on_session_notebook_changed(notebook, page, page_num, user_data);
+}
+
+// Runs before the notebook gives up its pages, so the tabs are still all there
+static void on_session_notebook_destroy(GtkWidget *notebook, gpointer user_data) {
+    FRSession *session = (FRSession*)user_data;
+    
+    fr_session_checkpoint(session);
+    session->closed = TRUE;
+    g_hash_table_remove_all(session->dirty);
+}
+
+FRSession* fr_session_new(FRStorage *storage, GtkNotebook *notebook) {
+    if (!notebook) return NULL;
+    
+    FRSession *session = g_malloc0(sizeof(FRSession));
+    session->storage = storage;
+    session->notebook = notebook;
+    session->dirty = g_hash_table_new(NULL, NULL);
+    session->handlers = g_array_new(FALSE, FALSE, sizeof(gulong));
+    
+    char *config_dir = fr_browser_get_config_dir();
+    session->directory = g_build_filename(config_dir, "session", NULL);
+    session->index_file = g_build_filename(session->directory, "session.json", NULL);
+    fr_browser_ensure_directory(session->directory);
+    g_free(config_dir);
+    
+    gulong handlers[] = {
+        g_signal_connect(notebook, "page-added", G_CALLBACK(on_session_notebook_changed), session),
+        g_signal_connect(notebook, "page-removed", G_CALLBACK(on_session_page_removed), session),
+        g_signal_connect(notebook, "page-reordered", G_CALLBACK(on_session_notebook_changed), session),
+        g_signal_connect(notebook, "switch-page", G_CALLBACK(on_session_notebook_changed), session),
+        g_signal_connect(notebook, "destroy", G_CALLBACK(on_session_notebook_destroy), session)
+    };
+    g_array_append_vals(session->handlers, handlers, G_N_ELEMENTS(handlers));
+    
+    return session;
+}
+
+void fr_session_free(FRSession *session) {
+    if (!session) return;
+    
+    if (session->checkpoint_source) {
+        g_source_remove(session->checkpoint_source);
+    }
+    
+    // The notebook is gone once it has told us it is closing
+    if (!session->closed) {
+        for (guint i = 0; i < session->handlers->len; i++) {
+            g_signal_handler_disconnect(session->notebook, g_array_index(session->handlers, gulong, i));
+        }
+    }
+    
+    g_array_unref(session->handlers);
+    g_hash_table_destroy(session->dirty);
+    g_free(session->index_file);
+    g_free(session->directory);
+    g_free(session);
+}
+
+static void session_load_record(FRJsonRecord *record, gpointer user_data) {
+    GArray *records = (GArray*)user_data;
+    const char *url = fr_json_record_get_string(record, "url");
+    gint64 id = fr_json_record_get_int(record, "id", 0);
+    
+    if (!url || !*url || id <= 0 || id > G_MAXUINT) return;
+    
+    FRSessionRecord loaded = { (guint)id, g_strdup(url),
+                               g_strdup(fr_json_record_get_string(record, "title")),
+                               fr_json_record_has(record, "active") };
+    g_array_append_val(records, loaded);
+}
+
+// Deletes the state files of tabs that were closed
+static void session_prune(FRSession *session, GHashTable *live) {
+    GDir *dir = g_dir_open(session->directory, 0, NULL);
+    if (!dir) return;
+    
+    const char *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        guint id = 0;
+        if (!g_str_has_prefix(name, "tab-") || !g_str_has_suffix(name, ".state")) continue;
+        if (sscanf(name, "tab-%u.state", &id) == 1 && g_hash_table_contains(live, GUINT_TO_POINTER(id))) continue;
+        
+        char *path = g_build_filename(session->directory, name, NULL);
+        g_remove(path);
+        g_free(path);
+    }
+    g_dir_close(dir);
+}
+
+int fr_session_restore(FRSession *session, FRSessionAddTabFunc add_tab, gpointer user_data) {
+    if (!session || !add_tab) return -1;
+    
+    GArray *records = g_array_new(FALSE, TRUE, sizeof(FRSessionRecord));
+    g_array_set_clear_func(records, (GDestroyNotify)session_record_clear);
+    
+    // A damaged index still gives back the tabs before the damage
+    if (g_file_test(session->index_file, G_FILE_TEST_EXISTS)) {
+        FRJsonStream *stream = fr_json_stream_new_for_records(session_load_record, records);
+        fr_json_stream_parse_file(stream, session->index_file, NULL);
+        fr_json_stream_free(stream);
+    }
+    
+    GHashTable *live = g_hash_table_new(NULL, NULL);
+    FRTab *active = NULL;
+    
+    for (guint i = 0; i < records->len; i++) {
+        FRSessionRecord *record = &g_array_index(records, FRSessionRecord, i);
+        if (g_hash_table_contains(live, GUINT_TO_POINTER(record->id))) continue;
+        
+        FRTab *tab = add_tab(record->id, record->url, record->title, user_data);
+        if (!tab) continue;
+        
+        // The state file goes with the id the tab ended up with
+        g_hash_table_add(live, GUINT_TO_POINTER(tab->id));
+        
+        // Missing or unreadable state just means no back/forward list
+        char *path = session_state_path(session, record->id);
+        char *contents = NULL;
+        gsize length = 0;
+        if (g_file_get_contents(path, &contents, &length, NULL)) {
+            GBytes *bytes = g_bytes_new_take(contents, length);
+            tab->session_state = webkit_web_view_session_state_new(bytes);
+            g_bytes_unref(bytes);
+        }
+        g_free(path);
+        
+        if (record->active || !active) {
+            active = tab;
+        }
+    }
+    
+    session_prune(session, live);
+    g_hash_table_destroy(live);
+    g_array_unref(records);
+    
+    return active ? gtk_notebook_page_num(session->notebook, active->page) : -1;
+}
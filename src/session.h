@@ -0,0 +1,46 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <gtk/gtk.h>
+#include <glib.h>
+#include "storage.h"
+#include "tabs.h"
+
+// Changes gathered into one checkpoint, in milliseconds
+#define FR_SESSION_CHECKPOINT_MS 1000
+
+// Adds a placeholder tab for a restored entry, keeping its id if it can
+typedef FRTab* (*FRSessionAddTabFunc)(guint id, const char *url, const char *title,
+                                      gpointer user_data);
+
+// The open tabs, saved as they change so that a crash loses at most the last
+// checkpoint. The session directory holds an index of every tab's id, url
+// and title in tab order, plus one tab-<id>.state file per tab with its
+// serialized WebKitWebViewSessionState. A checkpoint rewrites the index and
+// only the state files of tabs that navigated since the last one.
+typedef struct {
+    FRStorage *storage;
+    GtkNotebook *notebook;
+    char *directory;
+    char *index_file;
+    GHashTable *dirty;      // FRTab* whose state file is out of date
+    gboolean index_dirty;
+    guint checkpoint_source;
+    gboolean closed;        // the notebook is going away, keep the last checkpoint
+    GArray *handlers;       // gulong, notebook signal handlers
+} FRSession;
+
+FRSession* fr_session_new(FRStorage *storage, GtkNotebook *notebook);
+void fr_session_free(FRSession *session);
+
+// Recreates the saved tabs through add_tab and returns the page to select,
+// or -1 if there was nothing to restore. No page is loaded here.
+int fr_session_restore(FRSession *session, FRSessionAddTabFunc add_tab, gpointer user_data);
+// Call when tab navigated
+void fr_session_tab_changed(FRSession *session, FRTab *tab);
+// Call when a tab changed title; only the index records it
+void fr_session_index_changed(FRSession *session);
+// Writes pending changes now
+void fr_session_checkpoint(FRSession *session);
+
+#endif // SESSION_H
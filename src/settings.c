@@ -0,0 +1,77 @@
+#include "settings.h"
+#include "utils.h"
+
+#define DEFAULT_STORAGE_FLUSH_DELAY_MS 500
+#define DEFAULT_MAX_BACKGROUND_LOADS 3
+#define DEFAULT_SPARE_WEB_VIEWS 1
+#define DEFAULT_SPARE_MEMORY_LIMIT_MB 0
+#define DEFAULT_THUMBNAIL_CACHE_MB 16
+#define DEFAULT_CLOSED_TABS 25
+#define DEFAULT_CLOSED_TAB_KEEP_ALIVE_SEC 10
+#define DEFAULT_WEB_PROCESS_LIMIT 0
+#define DEFAULT_WEB_PROCESS_MEMORY_LIMIT_MB 0
+
+FRSettings* fr_settings_new(void) {
+    FRSettings *settings = g_malloc0(sizeof(FRSettings));
+    settings->storage_flush_delay_ms = DEFAULT_STORAGE_FLUSH_DELAY_MS;
+    settings->max_background_loads = DEFAULT_MAX_BACKGROUND_LOADS;
+    settings->spare_web_views = DEFAULT_SPARE_WEB_VIEWS;
+    settings->spare_memory_limit_mb = DEFAULT_SPARE_MEMORY_LIMIT_MB;
+    settings->thumbnail_cache_mb = DEFAULT_THUMBNAIL_CACHE_MB;
+    settings->closed_tabs = DEFAULT_CLOSED_TABS;
+    settings->closed_tab_keep_alive_sec = DEFAULT_CLOSED_TAB_KEEP_ALIVE_SEC;
+    settings->shared_web_process = FALSE;
+    settings->web_process_limit = DEFAULT_WEB_PROCESS_LIMIT;
+    settings->web_process_memory_limit_mb = DEFAULT_WEB_PROCESS_MEMORY_LIMIT_MB;
+    return settings;
+}
+
+void fr_settings_free(FRSettings *settings) {
+    g_free(settings);
+}
+
+static void settings_read_int(GKeyFile *key_file, const char *group, const char *key,
+                              int min_value, int *value) {
+    GError *error = NULL;
+    int read = g_key_file_get_integer(key_file, group, key, &error);
+    if (error) {
+        g_error_free(error);
+        return;
+    }
+    *value = MAX(read, min_value);
+}
+
+gboolean fr_settings_load(FRSettings *settings) {
+    if (!settings) return FALSE;
+    
+    char *config_dir = fr_browser_get_config_dir();
+    char *settings_file = g_build_filename(config_dir, "settings.ini", NULL);
+    g_free(config_dir);
+    
+    GKeyFile *key_file = g_key_file_new();
+    if (!g_key_file_load_from_file(key_file, settings_file, G_KEY_FILE_NONE, NULL)) {
+        g_key_file_free(key_file);
+        g_free(settings_file);
+        return TRUE; // No settings file, keep defaults
+    }
+    
+    settings_read_int(key_file, "storage", "flush-delay-ms", 0, &settings->storage_flush_delay_ms);
+    settings_read_int(key_file, "tabs", "max-background-loads", 1, &settings->max_background_loads);
+    settings_read_int(key_file, "tabs", "spare-web-views", 0, &settings->spare_web_views);
+    settings_read_int(key_file, "tabs", "spare-memory-limit-mb", 0, &settings->spare_memory_limit_mb);
+    settings_read_int(key_file, "tabs", "thumbnail-cache-mb", 1, &settings->thumbnail_cache_mb);
+    settings_read_int(key_file, "tabs", "closed-tabs", 0, &settings->closed_tabs);
+    settings_read_int(key_file, "tabs", "closed-tab-keep-alive-sec", 0, &settings->closed_tab_keep_alive_sec);
+    settings_read_int(key_file, "web", "process-limit", 0, &settings->web_process_limit);
+    settings_read_int(key_file, "web", "memory-limit-mb", 0, &settings->web_process_memory_limit_mb);
+    
+    char *process_model = g_key_file_get_string(key_file, "web", "process-model", NULL);
+    if (process_model) {
+        settings->shared_web_process = g_strcmp0(process_model, "shared") == 0;
+        g_free(process_model);
+    }
+    
+    g_key_file_free(key_file);
+    g_free(settings_file);
+    return TRUE;
+}
@@ -0,0 +1,30 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <glib.h>
+
+// Deployment tunables, read from settings.ini in the config directory.
+// Every key is optional; missing keys keep the defaults below.
+typedef struct {
+    // [storage]
+    int storage_flush_delay_ms;
+    
+    // [tabs]
+    int max_background_loads;
+    int spare_web_views;            // kept ready for new tabs
+    int spare_memory_limit_mb;      // no spares while web processes use more; 0: no limit
+    int thumbnail_cache_mb;
+    int closed_tabs;                // how many closed tabs can be reopened
+    int closed_tab_keep_alive_sec;  // a closed tab's web view lives this long; 0: not at all
+    
+    // [web]
+    gboolean shared_web_process;    // process-model = shared | multiple
+    int web_process_limit;          // 0: one process per tab
+    int web_process_memory_limit_mb;    // 0: WebKit's own limit
+} FRSettings;
+
+FRSettings* fr_settings_new(void);
+void fr_settings_free(FRSettings *settings);
+gboolean fr_settings_load(FRSettings *settings);
+
+#endif // SETTINGS_H
@@ -0,0 +1,302 @@
+#include "storage.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+typedef enum {
+    FR_STORAGE_OP_WRITE,
+    FR_STORAGE_OP_APPEND
+} FRStorageOpType;
+
+typedef struct {
+    FRStorageDoneFunc func;
+    gpointer user_data;
+} FRStorageCallback;
+
+typedef struct {
+    FRStorageOpType type;
+    char *path;
+    gpointer snapshot;
+    FRStorageSerializeFunc serialize;
+    GDestroyNotify free_snapshot;
+    GString *data;
+    GArray *callbacks;      // FRStorageCallback, this write's and those it superseded
+} FRStorageOp;
+
+// Outcome of one write, on its way back to the main loop
+typedef struct {
+    GArray *callbacks;
+    gboolean success;
+} FRStorageReport;
+
+static void storage_op_free(FRStorageOp *op) {
+    if (!op) return;
+    
+    if (op->free_snapshot && op->snapshot) {
+        op->free_snapshot(op->snapshot);
+    }
+    if (op->data) {
+        g_string_free(op->data, TRUE);
+    }
+    if (op->callbacks) {
+        g_array_unref(op->callbacks);
+    }
+    g_free(op->path);
+    g_free(op);
+}
+
+static gboolean storage_write_file(FRStorageOp *op, GError **error) {
+    gsize length = 0;
+    char *contents = op->serialize ? op->serialize(op->snapshot, &length) : NULL;
+    
+    gboolean success = g_file_set_contents(op->path, contents ? contents : "",
+                                           contents ? (gssize)length : 0, error);
+    g_free(contents);
+    return success;
+}
+
+static gboolean storage_op_run(FRStorageOp *op) {
+    GError *error = NULL;
+    
+    if (op->type == FR_STORAGE_OP_WRITE) {
+        if (!storage_write_file(op, &error)) {
+            g_warning("Could not write %s: %s", op->path, error->message);
+            g_error_free(error);
+            return FALSE;
+        }
+    } else {
+        FILE *file = fopen(op->path, "a");
+        if (!file) {
+            g_warning("Could not open %s for appending: %s", op->path, g_strerror(errno));
+            return FALSE;
+        }
+        
+        // Appends are journals that get replayed after a crash, so make sure
+        // the records are on disk rather than in the page cache
+        gboolean success = fwrite(op->data->str, 1, op->data->len, file) == op->data->len &&
+                           fflush(file) == 0 && fsync(fileno(file)) == 0;
+        if (!success) {
+            g_warning("Could not append to %s: %s", op->path, g_strerror(errno));
+        }
+        if (fclose(file) != 0 && success) {
+            g_warning("Could not close %s: %s", op->path, g_strerror(errno));
+            success = FALSE;
+        }
+        return success;
+    }
+    return TRUE;
+}
+
+static void storage_report_run(FRStorageReport *report) {
+    for (guint i = 0; i < report->callbacks->len; i++) {
+        FRStorageCallback *callback = &g_array_index(report->callbacks, FRStorageCallback, i);
+        callback->func(report->success, callback->user_data);
+    }
+    g_array_unref(report->callbacks);
+    g_free(report);
+}
+
+static gboolean storage_report_idle(gpointer user_data) {
+    storage_report_run((FRStorageReport*)user_data);
+    return G_SOURCE_REMOVE;
+}
+
+// Runs op and hands its outcome to whoever asked for it. The storage thread
+// posts it to the main loop; a NULL storage reports on the spot.
+static void storage_op_finish(FRStorageOp *op, gboolean on_thread) {
+    gboolean success = storage_op_run(op);
+    
+    if (op->callbacks && op->callbacks->len > 0) {
+        FRStorageReport *report = g_malloc0(sizeof(FRStorageReport));
+        report->callbacks = g_steal_pointer(&op->callbacks);
+        report->success = success;
+        if (on_thread) {
+            g_idle_add(storage_report_idle, report);
+        } else {
+            storage_report_run(report);
+        }
+    }
+    storage_op_free(op);
+}
+
+static gpointer storage_thread_main(gpointer user_data) {
+    FRStorage *storage = (FRStorage*)user_data;
+    
+    g_mutex_lock(&storage->lock);
+    while (TRUE) {
+        while (g_queue_is_empty(storage->pending) && !storage->stopping) {
+            g_cond_wait(&storage->wake, &storage->lock);
+        }
+        if (g_queue_is_empty(storage->pending)) {
+            break; // Stopping with nothing left to write
+        }
+        
+        // Let a burst of changes settle into one write
+        while (!storage->flush_requested && !storage->stopping &&
+               g_get_monotonic_time() < storage->deadline) {
+            g_cond_wait_until(&storage->wake, &storage->lock, storage->deadline);
+        }
+        
+        GQueue *batch = storage->pending;
+        storage->pending = g_queue_new();
+        storage->busy = TRUE;
+        g_mutex_unlock(&storage->lock);
+        
+        for (GList *l = batch->head; l != NULL; l = l->next) {
+            storage_op_finish((FRStorageOp*)l->data, TRUE);
+        }
+        g_queue_free(batch);
+        
+        g_mutex_lock(&storage->lock);
+        storage->busy = FALSE;
+        g_cond_broadcast(&storage->idle);
+    }
+    g_mutex_unlock(&storage->lock);
+    
+    return NULL;
+}
+
+FRStorage* fr_storage_new(guint flush_delay_ms) {
+    FRStorage *storage = g_malloc0(sizeof(FRStorage));
+    g_mutex_init(&storage->lock);
+    g_cond_init(&storage->wake);
+    g_cond_init(&storage->idle);
+    storage->pending = g_queue_new();
+    storage->flush_delay_ms = flush_delay_ms;
+    storage->thread = g_thread_new("fr-storage", storage_thread_main, storage);
+    
+    return storage;
+}
+
+void fr_storage_free(FRStorage *storage) {
+    if (!storage) return;
+    
+    // Everything queued before quit must reach the disk
+    g_mutex_lock(&storage->lock);
+    storage->stopping = TRUE;
+    g_cond_signal(&storage->wake);
+    g_mutex_unlock(&storage->lock);
+    g_thread_join(storage->thread);
+    
+    g_queue_free_full(storage->pending, (GDestroyNotify)storage_op_free);
+    g_cond_clear(&storage->idle);
+    g_cond_clear(&storage->wake);
+    g_mutex_clear(&storage->lock);
+    g_free(storage);
+}
+
+void fr_storage_flush(FRStorage *storage) {
+    if (!storage) return;
+    
+    g_mutex_lock(&storage->lock);
+    storage->flush_requested = TRUE;
+    g_cond_signal(&storage->wake);
+    while (!g_queue_is_empty(storage->pending) || storage->busy) {
+        g_cond_wait(&storage->idle, &storage->lock);
+    }
+    storage->flush_requested = FALSE;
+    g_mutex_unlock(&storage->lock);
+}
+
+// Must be called with the lock held
+static void storage_enqueue(FRStorage *storage, FRStorageOp *op) {
+    if (g_queue_is_empty(storage->pending)) {
+        storage->deadline = g_get_monotonic_time() + (gint64)storage->flush_delay_ms * 1000;
+    }
+    g_queue_push_tail(storage->pending, op);
+    g_cond_signal(&storage->wake);
+}
+
+// Must be called with the lock held. Whoever waits on a dropped write now
+// waits on its replacement.
+static void storage_drop_pending(FRStorage *storage, FRStorageOp *replacement) {
+    GList *l = storage->pending->head;
+    while (l != NULL) {
+        GList *next = l->next;
+        FRStorageOp *queued = (FRStorageOp*)l->data;
+        if (strcmp(queued->path, replacement->path) == 0) {
+            if (queued->callbacks) {
+                g_array_append_vals(replacement->callbacks, queued->callbacks->data,
+                                    queued->callbacks->len);
+            }
+            storage_op_free(queued);
+            g_queue_delete_link(storage->pending, l);
+        }
+        l = next;
+    }
+}
+
+void fr_storage_write(FRStorage *storage, const char *path, gpointer snapshot,
+                      FRStorageSerializeFunc serialize, GDestroyNotify free_snapshot) {
+    fr_storage_write_full(storage, path, snapshot, serialize, free_snapshot, NULL, NULL);
+}
+
+void fr_storage_write_full(FRStorage *storage, const char *path, gpointer snapshot,
+                           FRStorageSerializeFunc serialize, GDestroyNotify free_snapshot,
+                           FRStorageDoneFunc done, gpointer user_data) {
+    if (!path) return;
+    
+    FRStorageOp *op = g_malloc0(sizeof(FRStorageOp));
+    op->type = FR_STORAGE_OP_WRITE;
+    op->path = g_strdup(path);
+    op->snapshot = snapshot;
+    op->serialize = serialize;
+    op->free_snapshot = free_snapshot;
+    op->callbacks = g_array_new(FALSE, FALSE, sizeof(FRStorageCallback));
+    
+    if (!storage) {
+        if (done) {
+            FRStorageCallback callback = { done, user_data };
+            g_array_append_val(op->callbacks, callback);
+        }
+        storage_op_finish(op, FALSE);
+        return;
+    }
+    
+    g_mutex_lock(&storage->lock);
+    
+    // A full rewrite supersedes anything still queued for the same file
+    storage_drop_pending(storage, op);
+    if (done) {
+        FRStorageCallback callback = { done, user_data };
+        g_array_append_val(op->callbacks, callback);
+    }
+    
+    storage_enqueue(storage, op);
+    g_mutex_unlock(&storage->lock);
+}
+
+void fr_storage_append(FRStorage *storage, const char *path, const char *data, gsize length) {
+    if (!path || !data) return;
+    
+    if (storage) {
+        g_mutex_lock(&storage->lock);
+        
+        // Extend the last queued append if nothing else for this file follows it
+        for (GList *l = storage->pending->tail; l != NULL; l = l->prev) {
+            FRStorageOp *queued = (FRStorageOp*)l->data;
+            if (strcmp(queued->path, path) != 0) continue;
+            
+            if (queued->type == FR_STORAGE_OP_APPEND) {
+                g_string_append_len(queued->data, data, length);
+                g_mutex_unlock(&storage->lock);
+                return;
+            }
+            break;
+        }
+    }
+    
+    FRStorageOp *op = g_malloc0(sizeof(FRStorageOp));
+    op->type = FR_STORAGE_OP_APPEND;
+    op->path = g_strdup(path);
+    op->data = g_string_new_len(data, length);
+    
+    if (!storage) {
+        storage_op_finish(op, FALSE);
+        return;
+    }
+    
+    storage_enqueue(storage, op);
+    g_mutex_unlock(&storage->lock);
+}
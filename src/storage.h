@@ -0,0 +1,48 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <glib.h>
+
+// Turns an immutable snapshot into file contents. Runs on the storage thread,
+// so it must only touch the snapshot it is given.
+typedef char* (*FRStorageSerializeFunc)(gpointer snapshot, gsize *length);
+
+// Reports whether a write reached the disk. Runs on the main loop.
+typedef void (*FRStorageDoneFunc)(gboolean success, gpointer user_data);
+
+// Background writer that owns serialization and disk I/O for the persistent
+// stores. Work queued on it is coalesced per file and written once the flush
+// delay has passed since the first pending change.
+typedef struct {
+    GThread *thread;
+    GMutex lock;
+    GCond wake;
+    GCond idle;
+    GQueue *pending;        // queued operations, in submission order
+    gint64 deadline;        // monotonic time the pending batch is due
+    guint flush_delay_ms;
+    gboolean busy;
+    gboolean flush_requested;
+    gboolean stopping;
+} FRStorage;
+
+FRStorage* fr_storage_new(guint flush_delay_ms);
+void fr_storage_free(FRStorage *storage);
+void fr_storage_flush(FRStorage *storage);
+
+// Queue a full rewrite of path. Replaces any write or append still pending
+// for the same file. A NULL serialize function truncates the file.
+// With a NULL storage the write happens immediately on the calling thread.
+void fr_storage_write(FRStorage *storage, const char *path, gpointer snapshot,
+                      FRStorageSerializeFunc serialize, GDestroyNotify free_snapshot);
+// Like fr_storage_write, but done hears whether the file made it to disk.
+// A write that is superseded before it runs reports the outcome of the one
+// that replaced it. With a NULL storage done runs before this returns.
+void fr_storage_write_full(FRStorage *storage, const char *path, gpointer snapshot,
+                           FRStorageSerializeFunc serialize, GDestroyNotify free_snapshot,
+                           FRStorageDoneFunc done, gpointer user_data);
+
+// Queue data to be appended to path, after everything already queued for it.
+void fr_storage_append(FRStorage *storage, const char *path, const char *data, gsize length);
+
+#endif // STORAGE_H
@@ -5,11 +5,23 @@
 void fr_tab_init(FRTab *tab) {
     if (!tab) return;
     
+    tab->id = 0;
     tab->web_view = NULL;
+    tab->page = NULL;
     tab->tab_label = NULL;
+    tab->tab_icon = NULL;
     tab->title = NULL;
     tab->url = NULL;
     tab->loading = FALSE;
+    tab->can_go_back = FALSE;
+    tab->can_go_forward = FALSE;
+    tab->queued = FALSE;
+    tab->throttled = FALSE;
+    tab->priority = FR_TAB_PRIORITY_BACKGROUND;
+    tab->last_active = g_get_monotonic_time();
+    tab->discarded = FALSE;
+    tab->discarding = FALSE;
+    tab->session_state = NULL;
 }
 
 void fr_tab_free(FRTab *tab) {
@@ -21,6 +33,9 @@ void fr_tab_free(FRTab *tab) {
     if (tab->url) {
         g_free(tab->url);
     }
+    if (tab->session_state) {
+        webkit_web_view_session_state_unref(tab->session_state);
+    }
     
     g_free(tab);
 }
@@ -36,6 +51,15 @@ FRTab* fr_tab_new(const char *url) {
     return tab;
 }
 
+FRTab* fr_tab_get(GtkWidget *widget) {
+    if (!widget) return NULL;
+    
+    if (WEBKIT_IS_WEB_VIEW(widget)) {
+        widget = gtk_widget_get_parent(widget);
+    }
+    return widget ? (FRTab*)g_object_get_data(G_OBJECT(widget), "tab") : NULL;
+}
+
 void fr_tab_set_title(FRTab *tab, const char *title) {
     if (!tab) return;
     
@@ -61,25 +85,196 @@ void fr_tab_set_loading(FRTab *tab, gboolean loading) {
     tab->loading = loading;
 }
 
-GList* fr_tab_list_add(GList *tab_list, FRTab *tab) {
-    if (!tab) return tab_list;
-    return g_list_append(tab_list, tab);
+void fr_tab_update_label(FRTab *tab, const char *title) {
+    if (!tab || !tab->tab_label || !title) return;
+    
+    // Truncate long titles
+    char *short_title;
+    if (g_utf8_strlen(title, -1) > 20) {
+        char *prefix = g_utf8_substring(title, 0, 20);
+        short_title = g_strconcat(prefix, "...", NULL);
+        g_free(prefix);
+    } else {
+        short_title = g_strdup(title);
+    }
+    
+    if (g_strcmp0(gtk_label_get_text(GTK_LABEL(tab->tab_label)), short_title) != 0) {
+        gtk_label_set_text(GTK_LABEL(tab->tab_label), short_title);
+    }
+    g_free(short_title);
+}
+
+FRTabModel* fr_tab_model_new(void) {
+    FRTabModel *model = g_malloc0(sizeof(FRTabModel));
+    model->tabs = g_hash_table_new(NULL, NULL);
+    model->views = g_hash_table_new(NULL, NULL);
+    model->next_id = 1;
+    return model;
+}
+
+void fr_tab_model_free(FRTabModel *model) {
+    if (!model) return;
+    
+    g_hash_table_destroy(model->tabs);
+    g_hash_table_destroy(model->views);
+    g_free(model);
+}
+
+void fr_tab_model_add(FRTabModel *model, FRTab *tab, guint id) {
+    if (!model || !tab) return;
+    
+    if (id == 0 || g_hash_table_contains(model->tabs, GUINT_TO_POINTER(id))) {
+        id = model->next_id;
+    }
+    model->next_id = MAX(model->next_id, id + 1);
+    
+    tab->id = id;
+    g_hash_table_insert(model->tabs, GUINT_TO_POINTER(id), tab);
+    if (tab->web_view) {
+        g_hash_table_insert(model->views, tab->web_view, tab);
+    }
+}
+
+void fr_tab_model_remove(FRTabModel *model, FRTab *tab) {
+    if (!model || !tab) return;
+    
+    g_hash_table_remove(model->tabs, GUINT_TO_POINTER(tab->id));
+    if (tab->web_view) {
+        g_hash_table_remove(model->views, tab->web_view);
+    }
+    if (model->current == tab) {
+        model->current = NULL;
+    }
+}
+
+void fr_tab_model_set_web_view(FRTabModel *model, FRTab *tab, WebKitWebView *web_view) {
+    if (!model || !tab) return;
+    
+    if (tab->web_view) {
+        g_hash_table_remove(model->views, tab->web_view);
+    }
+    tab->web_view = web_view;
+    tab->loading = FALSE;
+    tab->can_go_back = FALSE;
+    tab->can_go_forward = FALSE;
+    tab->throttled = FALSE;
+    if (web_view) {
+        g_hash_table_insert(model->views, web_view, tab);
+    }
+}
+
+void fr_tab_model_forget_web_view(FRTabModel *model, WebKitWebView *web_view) {
+    if (!model || !web_view) return;
+    
+    FRTab *tab = g_hash_table_lookup(model->views, web_view);
+    if (tab && tab->web_view == web_view) {
+        fr_tab_model_set_web_view(model, tab, NULL);
+    } else {
+        g_hash_table_remove(model->views, web_view);
+    }
+}
+
+FRTab* fr_tab_model_lookup(FRTabModel *model, guint id) {
+    if (!model) return NULL;
+    return g_hash_table_lookup(model->tabs, GUINT_TO_POINTER(id));
+}
+
+FRTab* fr_tab_model_lookup_view(FRTabModel *model, WebKitWebView *web_view) {
+    if (!model || !web_view) return NULL;
+    return g_hash_table_lookup(model->views, web_view);
 }
 
-GList* fr_tab_list_remove(GList *tab_list, FRTab *tab) {
-    if (!tab) return tab_list;
-    return g_list_remove(tab_list, tab);
+guint fr_tab_model_get_count(FRTabModel *model) {
+    return model ? g_hash_table_size(model->tabs) : 0;
 }
 
-FRTab* fr_tab_list_find_by_webview(GList *tab_list, WebKitWebView *web_view) {
-    if (!web_view) return NULL;
+FRTabLoader* fr_tab_loader_new(guint max_loads, FRTabMaterializeFunc materialize,
+                               gpointer user_data) {
+    FRTabLoader *loader = g_malloc0(sizeof(FRTabLoader));
+    g_queue_init(&loader->waiting);
+    loader->loading = g_ptr_array_new();
+    loader->max_loads = max_loads > 0 ? max_loads : FR_TAB_LOADER_MAX_LOADS;
+    loader->materialize = materialize;
+    loader->user_data = user_data;
+    return loader;
+}
+
+void fr_tab_loader_free(FRTabLoader *loader) {
+    if (!loader) return;
+    
+    // The tabs belong to their notebook pages
+    g_queue_clear(&loader->waiting);
+    g_ptr_array_unref(loader->loading);
+    g_free(loader);
+}
+
+static void tab_loader_start(FRTabLoader *loader, FRTab *tab) {
+    loader->materialize(tab, loader->user_data);
+    if (!tab->web_view) return;
+    
+    tab->loading = TRUE;
+    g_ptr_array_add(loader->loading, tab);
     
-    for (GList *l = tab_list; l != NULL; l = l->next) {
-        FRTab *tab = (FRTab*)l->data;
-        if (tab && tab->web_view == web_view) {
-            return tab;
+    // A discarded tab comes back with its back/forward list
+    if (tab->session_state) {
+        webkit_web_view_restore_session_state(tab->web_view, tab->session_state);
+        webkit_web_view_session_state_unref(tab->session_state);
+        tab->session_state = NULL;
+        tab->discarded = FALSE;
+        
+        WebKitBackForwardList *list = webkit_web_view_get_back_forward_list(tab->web_view);
+        WebKitBackForwardListItem *item = webkit_back_forward_list_get_current_item(list);
+        if (item) {
+            webkit_web_view_go_to_back_forward_list_item(tab->web_view, item);
+            return;
         }
     }
     
-    return NULL;
+    webkit_web_view_load_uri(tab->web_view, tab->url);
+}
+
+static void tab_loader_pump(FRTabLoader *loader) {
+    while (loader->loading->len < loader->max_loads && !g_queue_is_empty(&loader->waiting)) {
+        FRTab *tab = (FRTab*)g_queue_pop_head(&loader->waiting);
+        tab->queued = FALSE;
+        tab_loader_start(loader, tab);
+    }
+}
+
+// Orders by priority; equal priorities keep request order
+static gint tab_loader_compare(gconstpointer a, gconstpointer b, gpointer user_data) {
+    return ((const FRTab*)a)->priority <= ((const FRTab*)b)->priority ? -1 : 1;
+}
+
+void fr_tab_loader_request(FRTabLoader *loader, FRTab *tab, FRTabPriority priority) {
+    if (!loader || !tab || tab->web_view || !tab->url) return;
+    
+    if (tab->queued) {
+        if (priority >= tab->priority) return;
+        g_queue_remove(&loader->waiting, tab);
+        tab->queued = FALSE;
+    }
+    tab->priority = priority;
+    
+    if (priority == FR_TAB_PRIORITY_FOREGROUND) {
+        tab_loader_start(loader, tab);
+        return;
+    }
+    
+    g_queue_insert_sorted(&loader->waiting, tab, tab_loader_compare, NULL);
+    tab->queued = TRUE;
+    tab_loader_pump(loader);
+}
+
+void fr_tab_loader_finished(FRTabLoader *loader, FRTab *tab) {
+    if (!loader || !tab) return;
+    
+    if (tab->queued) {
+        g_queue_remove(&loader->waiting, tab);
+        tab->queued = FALSE;
+    }
+    if (g_ptr_array_remove(loader->loading, tab)) {
+        tab->loading = FALSE;
+        tab_loader_pump(loader);
+    }
 }
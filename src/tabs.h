@@ -3,21 +3,99 @@
 
 #include <gtk/gtk.h>
 #include <webkit2/webkit2.h>
-#include "browser.h"
+
+#define FR_TAB_LOADER_MAX_LOADS 3
+
+typedef enum {
+    FR_TAB_PRIORITY_FOREGROUND,     // the selected tab, never waits for a slot
+    FR_TAB_PRIORITY_BACKGROUND
+} FRTabPriority;
+
+// One notebook page. A tab starts out as a placeholder holding only what it
+// was opened with; its web view is created when the loader starts it, which
+// is when it is first selected or its background load gets a slot. A tab
+// whose web view was discarded is a placeholder again until reselected.
+// The web view signal handlers keep url, title and the navigation flags
+// current, so nothing else needs to ask WebKit.
+typedef struct {
+    guint id;                   // stable for the tab's life and across restarts
+    WebKitWebView *web_view;    // NULL while the tab is a placeholder
+    GtkWidget *page;            // scrolled window the web view goes into
+    GtkWidget *tab_label;
+    GtkWidget *tab_icon;
+    char *title;
+    char *url;                  // what the placeholder loads, then the current page
+    gboolean loading;
+    gboolean can_go_back;
+    gboolean can_go_forward;
+    gboolean queued;            // waiting in the loader
+    gboolean throttled;         // its media was paused while hidden
+    FRTabPriority priority;
+    gint64 last_active;         // monotonic time it was last selected or left
+    
+    // Discarding
+    gboolean discarded;
+    gboolean discarding;        // waiting for its thumbnail
+    WebKitWebViewSessionState *session_state;   // restored by the loader
+} FRTab;
+
+// Every open tab by id and by web view, and which one is selected. Tabs
+// belong to their notebook pages, which also give the tab order.
+typedef struct {
+    GHashTable *tabs;           // id -> FRTab*
+    GHashTable *views;          // WebKitWebView* -> FRTab*
+    FRTab *current;
+    guint next_id;
+} FRTabModel;
+
+typedef void (*FRTabMaterializeFunc)(FRTab *tab, gpointer user_data);
+
+// Starts first loads of tabs. Background tabs wait until fewer than
+// max_loads first loads are in flight, higher priority first and otherwise in
+// the order they were requested; the selected tab starts at once and counts
+// against the limit, so background pages hold back while it loads.
+typedef struct {
+    GQueue waiting;             // FRTab*
+    GPtrArray *loading;         // FRTab* whose first load is in flight
+    guint max_loads;
+    FRTabMaterializeFunc materialize;   // must set tab->web_view
+    gpointer user_data;
+} FRTabLoader;
 
 // Tab management functions
 void fr_tab_init(FRTab *tab);
 void fr_tab_free(FRTab *tab);
 FRTab* fr_tab_new(const char *url);
+// The tab a notebook page or one of its web views belongs to
+FRTab* fr_tab_get(GtkWidget *widget);
 
 // Tab operations
 void fr_tab_set_title(FRTab *tab, const char *title);
 void fr_tab_set_url(FRTab *tab, const char *url);
 void fr_tab_set_loading(FRTab *tab, gboolean loading);
+// Shows title, shortened, on the tab
+void fr_tab_update_label(FRTab *tab, const char *title);
+
+// Tab model
+FRTabModel* fr_tab_model_new(void);
+void fr_tab_model_free(FRTabModel *model);
+// Gives tab id if it is free, such as when restoring, or else a new one
+void fr_tab_model_add(FRTabModel *model, FRTab *tab, guint id);
+void fr_tab_model_remove(FRTabModel *model, FRTab *tab);
+void fr_tab_model_set_web_view(FRTabModel *model, FRTab *tab, WebKitWebView *web_view);
+// Call when a web view is destroyed, which may be after its tab let go of it
+void fr_tab_model_forget_web_view(FRTabModel *model, WebKitWebView *web_view);
+FRTab* fr_tab_model_lookup(FRTabModel *model, guint id);
+FRTab* fr_tab_model_lookup_view(FRTabModel *model, WebKitWebView *web_view);
+guint fr_tab_model_get_count(FRTabModel *model);
 
-// Tab list management
-GList* fr_tab_list_add(GList *tab_list, FRTab *tab);
-GList* fr_tab_list_remove(GList *tab_list, FRTab *tab);
-FRTab* fr_tab_list_find_by_webview(GList *tab_list, WebKitWebView *web_view);
+// Tab loading
+FRTabLoader* fr_tab_loader_new(guint max_loads, FRTabMaterializeFunc materialize,
+                               gpointer user_data);
+void fr_tab_loader_free(FRTabLoader *loader);
+// Queues tab's first load, or raises its priority; tabs with a web view are left alone
+void fr_tab_loader_request(FRTabLoader *loader, FRTab *tab, FRTabPriority priority);
+// Frees tab's slot once its first load has finished or failed, or the tab closed
+void fr_tab_loader_finished(FRTabLoader *loader, FRTab *tab);
 
 #endif // TABS_H
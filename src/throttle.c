@@ -0,0 +1,128 @@
+#include "throttle.h"
+
+// Remembers what it paused so that resuming does not start anything the
+// page had stopped itself
+static const char *throttle_pause_script =
+    "document.querySelectorAll('video, audio').forEach(function (media) {"
+    "  if (!media.paused) { media.dataset.frThrottled = '1'; media.pause(); }"
+    "});";
+
+static const char *throttle_resume_script =
+    "document.querySelectorAll('[data-fr-throttled]').forEach(function (media) {"
+    "  delete media.dataset.frThrottled; media.play();"
+    "});";
+
+static void tab_run_script(FRTab *tab, const char *script) {
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    webkit_web_view_run_javascript(tab->web_view, script, NULL, NULL, NULL);
+    G_GNUC_END_IGNORE_DEPRECATIONS
+}
+
+static void tab_throttle(FRTab *tab) {
+    if (!tab->web_view || tab->throttled) return;
+    if (webkit_web_view_is_playing_audio(tab->web_view)) return;
+    
+    tab_run_script(tab, throttle_pause_script);
+    tab->throttled = TRUE;
+}
+
+static void tab_resume(FRTab *tab) {
+    if (!tab || !tab->web_view || !tab->throttled) return;
+    
+    tab_run_script(tab, throttle_resume_script);
+    tab->throttled = FALSE;
+}
+
+void fr_tab_throttler_throttle_hidden(FRTabThrottler *throttler) {
+    if (!throttler) return;
+    
+    GHashTableIter iter;
+    gpointer tab;
+    g_hash_table_iter_init(&iter, throttler->tabs->tabs);
+    while (g_hash_table_iter_next(&iter, NULL, &tab)) {
+        if (tab != throttler->tabs->current || throttler->minimized) {
+            tab_throttle((FRTab*)tab);
+        }
+    }
+}
+
+void fr_tab_throttler_resume(FRTabThrottler *throttler, FRTab *tab) {
+    if (!throttler) return;
+    
+    tab_resume(tab);
+}
+
+static gboolean on_throttle_timeout(gpointer user_data) {
+    FRTabThrottler *throttler = (FRTabThrottler*)user_data;
+    
+    throttler->throttle_source = 0;
+    fr_tab_throttler_throttle_hidden(throttler);
+    return G_SOURCE_REMOVE;
+}
+
+static void throttle_schedule(FRTabThrottler *throttler) {
+    if (throttler->throttle_source) {
+        g_source_remove(throttler->throttle_source);
+    }
+    throttler->throttle_source = g_timeout_add(FR_THROTTLE_DELAY_MS, on_throttle_timeout, throttler);
+}
+
+static void on_throttle_switch_page(GtkNotebook *notebook, GtkWidget *page, guint page_num,
+                                    gpointer user_data) {
+    FRTabThrottler *throttler = (FRTabThrottler*)user_data;
+    
+    tab_resume(fr_tab_get(page));
+    
+    // Flipping through tabs should not pause and restart everything on the way
+    throttle_schedule(throttler);
+}
+
+static gboolean on_throttle_window_state(GtkWidget *window, GdkEventWindowState *event,
+                                         gpointer user_data) {
+    FRTabThrottler *throttler = (FRTabThrottler*)user_data;
+    if (!(event->changed_mask & GDK_WINDOW_STATE_ICONIFIED)) return FALSE;
+    
+    throttler->minimized = (event->new_window_state & GDK_WINDOW_STATE_ICONIFIED) != 0;
+    FRTab *current = throttler->tabs->current;
+    
+    // The selected tab may have changed or lost its view meanwhile, so the
+    // view that was hidden is the one shown again
+    if (throttler->minimized) {
+        if (current && current->web_view && !throttler->hidden_view) {
+            throttler->hidden_view = g_object_ref(current->web_view);
+            gtk_widget_hide(GTK_WIDGET(current->web_view));
+        }
+        fr_tab_throttler_throttle_hidden(throttler);
+    } else {
+        if (throttler->hidden_view) {
+            gtk_widget_show(GTK_WIDGET(throttler->hidden_view));
+            g_clear_object(&throttler->hidden_view);
+        }
+        tab_resume(current);
+    }
+    
+    return FALSE;
+}
+
+FRTabThrottler* fr_tab_throttler_new(GtkWidget *window, GtkNotebook *notebook, FRTabModel *tabs) {
+    if (!window || !notebook || !tabs) return NULL;
+    
+    FRTabThrottler *throttler = g_malloc0(sizeof(FRTabThrottler));
+    throttler->window = window;
+    throttler->notebook = notebook;
+    throttler->tabs = tabs;
+    
+    g_signal_connect(window, "window-state-event", G_CALLBACK(on_throttle_window_state), throttler);
+    g_signal_connect(notebook, "switch-page", G_CALLBACK(on_throttle_switch_page), throttler);
+    return throttler;
+}
+
+void fr_tab_throttler_free(FRTabThrottler *throttler) {
+    if (!throttler) return;
+    
+    if (throttler->throttle_source) {
+        g_source_remove(throttler->throttle_source);
+    }
+    g_clear_object(&throttler->hidden_view);
+    g_free(throttler);
+}
@@ -0,0 +1,33 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <gtk/gtk.h>
+#include "tabs.h"
+
+// How long a tab stays in the background before its media is paused
+#define FR_THROTTLE_DELAY_MS 5000
+
+// Quiets tabs nobody can see. WebKit already slows timers and stops
+// animation frames for a page whose view is not mapped, which covers
+// background notebook pages; a minimized window keeps its selected page
+// mapped, so its web view is hidden until the window comes back. Playing
+// video and other silent media in background tabs is paused as well; tabs
+// making sound are left alone. Everything resumes as soon as a tab is shown.
+typedef struct {
+    GtkWidget *window;
+    GtkNotebook *notebook;
+    FRTabModel *tabs;
+    gboolean minimized;
+    WebKitWebView *hidden_view; // the selected view at minimize, until the window comes back
+    guint throttle_source;
+} FRTabThrottler;
+
+FRTabThrottler* fr_tab_throttler_new(GtkWidget *window, GtkNotebook *notebook, FRTabModel *tabs);
+void fr_tab_throttler_free(FRTabThrottler *throttler);
+
+// Pauses the media of every tab that is not shown
+void fr_tab_throttler_throttle_hidden(FRTabThrottler *throttler);
+// Plays again what was paused in tab, e.g. when a closed tab is reopened
+void fr_tab_throttler_resume(FRTabThrottler *throttler, FRTab *tab);
+
+#endif // THROTTLE_H
@@ -0,0 +1,275 @@
+#include "thumbnail.h"
+#include <string.h>
+
+typedef struct {
+    FRThumbnailReadyFunc func;
+    gpointer user_data;
+} FRThumbnailWaiter;
+
+// One capture, from snapshot to stored thumbnail
+typedef struct {
+    FRThumbnailCache *cache;
+    FRTab *tab;
+    guint tab_id;
+    GCancellable *cancellable;
+    GArray *waiters;            // FRThumbnailWaiter
+} FRThumbnailRequest;
+
+static void thumbnail_free(FRThumbnail *thumbnail) {
+    cairo_surface_destroy(thumbnail->surface);
+    g_free(thumbnail);
+}
+
+static void thumbnail_request_free(FRThumbnailRequest *request) {
+    g_object_unref(request->cancellable);
+    g_array_unref(request->waiters);
+    g_free(request);
+}
+
+FRThumbnailCache* fr_thumbnail_cache_new(gsize max_size) {
+    FRThumbnailCache *cache = g_malloc0(sizeof(FRThumbnailCache));
+    cache->entries = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)thumbnail_free);
+    g_queue_init(&cache->lru);
+    cache->max_size = max_size;
+    cache->pending = g_hash_table_new(NULL, NULL);
+    return cache;
+}
+
+void fr_thumbnail_cache_free(FRThumbnailCache *cache) {
+    if (!cache) return;
+    
+    // Requests free themselves once their cancellation comes back
+    GHashTableIter iter;
+    gpointer request;
+    g_hash_table_iter_init(&iter, cache->pending);
+    while (g_hash_table_iter_next(&iter, NULL, &request)) {
+        g_cancellable_cancel(((FRThumbnailRequest*)request)->cancellable);
+    }
+    g_hash_table_destroy(cache->pending);
+    
+    // The lru links live in the thumbnails
+    g_hash_table_destroy(cache->entries);
+    g_free(cache);
+}
+
+static void thumbnail_store(FRThumbnailCache *cache, guint tab_id, cairo_surface_t *surface) {
+    FRThumbnail *thumbnail = g_hash_table_lookup(cache->entries, GUINT_TO_POINTER(tab_id));
+    if (thumbnail) {
+        g_queue_unlink(&cache->lru, &thumbnail->link);
+        cache->size -= thumbnail->size;
+        cairo_surface_destroy(thumbnail->surface);
+    } else {
+        thumbnail = g_malloc0(sizeof(FRThumbnail));
+        thumbnail->tab_id = tab_id;
+        thumbnail->link.data = thumbnail;
+        g_hash_table_insert(cache->entries, GUINT_TO_POINTER(tab_id), thumbnail);
+    }
+    
+    thumbnail->surface = surface;
+    thumbnail->size = (gsize)cairo_image_surface_get_stride(surface) * cairo_image_surface_get_height(surface);
+    cache->size += thumbnail->size;
+    g_queue_push_head_link(&cache->lru, &thumbnail->link);
+    
+    // The newest one stays even if it alone is over the limit
+    while (cache->size > cache->max_size && cache->lru.length > 1) {
+        FRThumbnail *oldest = (FRThumbnail*)cache->lru.tail->data;
+        g_queue_unlink(&cache->lru, &oldest->link);
+        cache->size -= oldest->size;
+        g_hash_table_remove(cache->entries, GUINT_TO_POINTER(oldest->tab_id));
+    }
+}
+
+// Averages each box of source pixels into one destination pixel. Cairo's
+// premultiplied ARGB can be averaged channel by channel as it is. A vertical
+// pass adds a box's source rows byte by byte, a straight loop over contiguous
+// memory that the compiler vectorizes and that does nearly all the work; a
+// horizontal pass then folds the summed row into the destination pixels.
+static void thumbnail_box_filter(const guint8 *src, int src_width, int src_height, int src_stride,
+                                 guint8 *dst, int dst_width, int dst_height, int dst_stride) {
+    gsize row_length = (gsize)src_width * 4;
+    guint32 *sums = g_new(guint32, row_length);
+    int *columns = g_new(int, dst_width + 1);
+    
+    for (int x = 0; x <= dst_width; x++) {
+        columns[x] = (int)((gint64)x * src_width / dst_width);
+    }
+    
+    for (int y = 0; y < dst_height; y++) {
+        int top = (int)((gint64)y * src_height / dst_height);
+        int bottom = MAX(top + 1, (int)((gint64)(y + 1) * src_height / dst_height));
+        
+        memset(sums, 0, row_length * sizeof(guint32));
+        for (int sy = top; sy < bottom; sy++) {
+            const guint8 *row = src + (gsize)sy * src_stride;
+            for (gsize i = 0; i < row_length; i++) {
+                sums[i] += row[i];
+            }
+        }
+        
+        guint8 *out = dst + (gsize)y * dst_stride;
+        for (int x = 0; x < dst_width; x++) {
+            guint32 total[4] = { 0, 0, 0, 0 };
+            for (int sx = columns[x]; sx < columns[x + 1]; sx++) {
+                const guint32 *sum = sums + sx * 4;
+                total[0] += sum[0];
+                total[1] += sum[1];
+                total[2] += sum[2];
+                total[3] += sum[3];
+            }
+            
+            guint32 count = (guint32)(columns[x + 1] - columns[x]) * (guint32)(bottom - top);
+            for (int c = 0; c < 4; c++) {
+                out[x * 4 + c] = (guint8)((total[c] + count / 2) / count);
+            }
+        }
+    }
+    
+    g_free(columns);
+    g_free(sums);
+}
+
+// Runs on a worker thread, which owns the snapshot until it returns
+static void thumbnail_scale_thread(GTask *task, gpointer source, gpointer task_data,
+                                   GCancellable *cancellable) {
+    cairo_surface_t *snapshot = (cairo_surface_t*)task_data;
+    cairo_surface_flush(snapshot);
+    
+    int width = cairo_image_surface_get_width(snapshot);
+    int height = cairo_image_surface_get_height(snapshot);
+    if (width <= 0 || height <= 0 || cairo_image_surface_get_format(snapshot) != CAIRO_FORMAT_ARGB32) {
+        g_task_return_pointer(task, NULL, NULL);
+        return;
+    }
+    if (width <= FR_THUMBNAIL_WIDTH) {
+        g_task_return_pointer(task, cairo_surface_reference(snapshot), (GDestroyNotify)cairo_surface_destroy);
+        return;
+    }
+    
+    int thumbnail_height = MAX(1, (int)((gint64)height * FR_THUMBNAIL_WIDTH / width));
+    cairo_surface_t *thumbnail = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, FR_THUMBNAIL_WIDTH,
+                                                            thumbnail_height);
+    cairo_surface_flush(thumbnail);
+    thumbnail_box_filter(cairo_image_surface_get_data(snapshot), width, height,
+                         cairo_image_surface_get_stride(snapshot),
+                         cairo_image_surface_get_data(thumbnail), FR_THUMBNAIL_WIDTH, thumbnail_height,
+                         cairo_image_surface_get_stride(thumbnail));
+    cairo_surface_mark_dirty(thumbnail);
+    
+    g_task_return_pointer(task, thumbnail, (GDestroyNotify)cairo_surface_destroy);
+}
+
+static void thumbnail_request_finish(FRThumbnailRequest *request, cairo_surface_t *thumbnail) {
+    g_hash_table_remove(request->cache->pending, GUINT_TO_POINTER(request->tab_id));
+    
+    // The cache owns it from here; waiters only borrow it
+    if (thumbnail) {
+        thumbnail_store(request->cache, request->tab_id, thumbnail);
+    }
+    
+    for (guint i = 0; i < request->waiters->len; i++) {
+        FRThumbnailWaiter *waiter = &g_array_index(request->waiters, FRThumbnailWaiter, i);
+        waiter->func(request->tab, thumbnail, waiter->user_data);
+    }
+    thumbnail_request_free(request);
+}
+
+static void on_thumbnail_scaled(GObject *source, GAsyncResult *result, gpointer user_data) {
+    FRThumbnailRequest *request = (FRThumbnailRequest*)user_data;
+    GError *error = NULL;
+    
+    cairo_surface_t *thumbnail = g_task_propagate_pointer(G_TASK(result), &error);
+    
+    // Cancelled when the tab closed or the cache went away
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free(error);
+        thumbnail_request_free(request);
+        return;
+    }
+    g_clear_error(&error);
+    
+    thumbnail_request_finish(request, thumbnail);
+}
+
+static void on_thumbnail_snapshot(GObject *source, GAsyncResult *result, gpointer user_data) {
+    FRThumbnailRequest *request = (FRThumbnailRequest*)user_data;
+    GError *error = NULL;
+    
+    cairo_surface_t *snapshot = webkit_web_view_get_snapshot_finish(WEBKIT_WEB_VIEW(source), result, &error);
+    
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free(error);
+        thumbnail_request_free(request);
+        return;
+    }
+    g_clear_error(&error);
+    
+    // Pages that could not be drawn go without one
+    if (!snapshot) {
+        thumbnail_request_finish(request, NULL);
+        return;
+    }
+    
+    GTask *task = g_task_new(NULL, request->cancellable, on_thumbnail_scaled, request);
+    g_task_set_task_data(task, snapshot, (GDestroyNotify)cairo_surface_destroy);
+    g_task_run_in_thread(task, thumbnail_scale_thread);
+    g_object_unref(task);
+}
+
+void fr_thumbnail_cache_capture(FRThumbnailCache *cache, FRTab *tab, FRThumbnailReadyFunc ready,
+                                gpointer user_data) {
+    if (!cache || !tab || !tab->web_view) return;
+    
+    FRThumbnailRequest *request = g_hash_table_lookup(cache->pending, GUINT_TO_POINTER(tab->id));
+    if (!request) {
+        request = g_malloc0(sizeof(FRThumbnailRequest));
+        request->cache = cache;
+        request->tab = tab;
+        request->tab_id = tab->id;
+        request->cancellable = g_cancellable_new();
+        request->waiters = g_array_new(FALSE, FALSE, sizeof(FRThumbnailWaiter));
+        g_hash_table_insert(cache->pending, GUINT_TO_POINTER(tab->id), request);
+        
+        webkit_web_view_get_snapshot(tab->web_view, WEBKIT_SNAPSHOT_REGION_VISIBLE,
+                                     WEBKIT_SNAPSHOT_OPTIONS_NONE, request->cancellable,
+                                     on_thumbnail_snapshot, request);
+    }
+    
+    if (ready) {
+        FRThumbnailWaiter waiter = { ready, user_data };
+        g_array_append_val(request->waiters, waiter);
+    }
+}
+
+cairo_surface_t* fr_thumbnail_cache_lookup(FRThumbnailCache *cache, guint tab_id) {
+    if (!cache) return NULL;
+    
+    FRThumbnail *thumbnail = g_hash_table_lookup(cache->entries, GUINT_TO_POINTER(tab_id));
+    if (!thumbnail) return NULL;
+    
+    g_queue_unlink(&cache->lru, &thumbnail->link);
+    g_queue_push_head_link(&cache->lru, &thumbnail->link);
+    return thumbnail->surface;
+}
+
+void fr_thumbnail_cache_insert(FRThumbnailCache *cache, guint tab_id, cairo_surface_t *surface) {
+    if (!cache || !surface) return;
+    
+    thumbnail_store(cache, tab_id, cairo_surface_reference(surface));
+}
+
+void fr_thumbnail_cache_remove(FRThumbnailCache *cache, guint tab_id) {
+    if (!cache) return;
+    
+    FRThumbnailRequest *request = g_hash_table_lookup(cache->pending, GUINT_TO_POINTER(tab_id));
+    if (request) {
+        g_hash_table_remove(cache->pending, GUINT_TO_POINTER(tab_id));
+        g_cancellable_cancel(request->cancellable);
+    }
+    
+    FRThumbnail *thumbnail = g_hash_table_lookup(cache->entries, GUINT_TO_POINTER(tab_id));
+    if (thumbnail) {
+        g_queue_unlink(&cache->lru, &thumbnail->link);
+        cache->size -= thumbnail->size;
+        g_hash_table_remove(cache->entries, GUINT_TO_POINTER(tab_id));
+    }
+}
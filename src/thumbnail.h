@@ -0,0 +1,49 @@
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+
+#include <gtk/gtk.h>
+#include <webkit2/webkit2.h>
+#include "tabs.h"
+
+#define FR_THUMBNAIL_WIDTH 320
+
+// Called on the main thread once a capture is done; thumbnail is NULL when
+// the page could not be drawn (transfer none)
+typedef void (*FRThumbnailReadyFunc)(FRTab *tab, cairo_surface_t *thumbnail, gpointer user_data);
+
+typedef struct {
+    guint tab_id;
+    cairo_surface_t *surface;   // at most FR_THUMBNAIL_WIDTH wide
+    gsize size;                 // bytes of pixel data
+    GList link;                 // node in the cache's lru, data is the thumbnail
+} FRThumbnail;
+
+// How each tab last looked, by tab id, for previews and for tabs whose web
+// view was discarded. A capture snapshots the visible part of the page
+// asynchronously and box-filters it down to FR_THUMBNAIL_WIDTH on a worker
+// thread, so even a large page never holds up the UI. The least recently
+// used thumbnails go once they take more than max_bytes together.
+typedef struct {
+    GHashTable *entries;        // tab id -> FRThumbnail*
+    GQueue lru;                 // FRThumbnail*, most recently used first
+    gsize size;
+    gsize max_size;
+    GHashTable *pending;        // tab id -> FRThumbnailRequest*, captures in flight
+} FRThumbnailCache;
+
+FRThumbnailCache* fr_thumbnail_cache_new(gsize max_size);
+void fr_thumbnail_cache_free(FRThumbnailCache *cache);
+
+// Snapshots tab's web view; ready, if given, is called when the thumbnail is
+// stored, unless the tab is removed first. A capture already in flight for
+// tab is not started again.
+void fr_thumbnail_cache_capture(FRThumbnailCache *cache, FRTab *tab, FRThumbnailReadyFunc ready,
+                                gpointer user_data);
+// The tab's thumbnail, or NULL (transfer none)
+cairo_surface_t* fr_thumbnail_cache_lookup(FRThumbnailCache *cache, guint tab_id);
+// Stores a thumbnail the tab already had, e.g. when it is reopened
+void fr_thumbnail_cache_insert(FRThumbnailCache *cache, guint tab_id, cairo_surface_t *surface);
+// Forgets a closed tab and cancels its capture
+void fr_thumbnail_cache_remove(FRThumbnailCache *cache, guint tab_id);
+
+#endif // THUMBNAIL_H
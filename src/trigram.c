@@ -0,0 +1,173 @@
+#include "trigram.h"
+#include <string.h>
+
+static inline guint32 trigram_key(const char *p) {
+    return ((guint32)(guchar)p[0] << 16) | ((guint32)(guchar)p[1] << 8) | (guint32)(guchar)p[2];
+}
+
+static gint compare_keys(gconstpointer a, gconstpointer b) {
+    guint32 ka = *(const guint32*)a;
+    guint32 kb = *(const guint32*)b;
+    return (ka > kb) - (ka < kb);
+}
+
+// Distinct trigrams of text, sorted so duplicates are dropped in one pass
+static GArray* trigram_collect(const char *text) {
+    GArray *keys = g_array_new(FALSE, FALSE, sizeof(guint32));
+    size_t length = text ? strlen(text) : 0;
+    if (length < 3) return keys;
+    
+    g_array_set_size(keys, length - 2);
+    for (size_t i = 0; i + 2 < length; i++) {
+        g_array_index(keys, guint32, i) = trigram_key(text + i);
+    }
+    g_array_sort(keys, compare_keys);
+    
+    guint unique = 0;
+    for (guint i = 0; i < keys->len; i++) {
+        guint32 key = g_array_index(keys, guint32, i);
+        if (unique == 0 || g_array_index(keys, guint32, unique - 1) != key) {
+            g_array_index(keys, guint32, unique++) = key;
+        }
+    }
+    g_array_set_size(keys, unique);
+    
+    return keys;
+}
+
+// Position of the first element >= id
+static guint posting_lower_bound(GArray *posting, guint id) {
+    guint low = 0, high = posting->len;
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        if (g_array_index(posting, guint, mid) < id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+FRTrigramIndex* fr_trigram_index_new(void) {
+    FRTrigramIndex *index = g_malloc0(sizeof(FRTrigramIndex));
+    index->postings = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                            NULL, (GDestroyNotify)g_array_unref);
+    return index;
+}
+
+void fr_trigram_index_free(FRTrigramIndex *index) {
+    if (!index) return;
+    
+    g_hash_table_destroy(index->postings);
+    g_free(index);
+}
+
+void fr_trigram_index_clear(FRTrigramIndex *index) {
+    if (!index) return;
+    g_hash_table_remove_all(index->postings);
+}
+
+void fr_trigram_index_add(FRTrigramIndex *index, guint id, const char *folded_text) {
+    if (!index || !folded_text) return;
+    
+    GArray *keys = trigram_collect(folded_text);
+    for (guint i = 0; i < keys->len; i++) {
+        gpointer key = GUINT_TO_POINTER(g_array_index(keys, guint32, i));
+        GArray *posting = g_hash_table_lookup(index->postings, key);
+        if (!posting) {
+            posting = g_array_sized_new(FALSE, FALSE, sizeof(guint), 4);
+            g_hash_table_insert(index->postings, key, posting);
+        }
+        
+        // Ids are handed out in increasing order, so this is nearly always an append
+        if (posting->len == 0 || g_array_index(posting, guint, posting->len - 1) < id) {
+            g_array_append_val(posting, id);
+        } else {
+            guint pos = posting_lower_bound(posting, id);
+            if (pos == posting->len || g_array_index(posting, guint, pos) != id) {
+                g_array_insert_val(posting, pos, id);
+            }
+        }
+    }
+    g_array_unref(keys);
+}
+
+void fr_trigram_index_remove(FRTrigramIndex *index, guint id, const char *folded_text) {
+    if (!index || !folded_text) return;
+    
+    GArray *keys = trigram_collect(folded_text);
+    for (guint i = 0; i < keys->len; i++) {
+        gpointer key = GUINT_TO_POINTER(g_array_index(keys, guint32, i));
+        GArray *posting = g_hash_table_lookup(index->postings, key);
+        if (!posting) continue;
+        
+        guint pos = posting_lower_bound(posting, id);
+        if (pos < posting->len && g_array_index(posting, guint, pos) == id) {
+            g_array_remove_index(posting, pos);
+        }
+        if (posting->len == 0) {
+            g_hash_table_remove(index->postings, key);
+        }
+    }
+    g_array_unref(keys);
+}
+
+static gint compare_posting_length(gconstpointer a, gconstpointer b) {
+    const GArray *pa = *(GArray* const*)a;
+    const GArray *pb = *(GArray* const*)b;
+    return (pa->len > pb->len) - (pa->len < pb->len);
+}
+
+GArray* fr_trigram_index_query(FRTrigramIndex *index, const char *folded_pattern) {
+    if (!index || !folded_pattern || strlen(folded_pattern) < 3) return NULL;
+    
+    GArray *result = g_array_new(FALSE, FALSE, sizeof(guint));
+    GArray *keys = trigram_collect(folded_pattern);
+    GPtrArray *postings = g_ptr_array_sized_new(keys->len);
+    
+    for (guint i = 0; i < keys->len; i++) {
+        GArray *posting = g_hash_table_lookup(index->postings,
+                                              GUINT_TO_POINTER(g_array_index(keys, guint32, i)));
+        if (!posting) {
+            // A trigram nobody contains: no candidates at all
+            g_ptr_array_unref(postings);
+            g_array_unref(keys);
+            return result;
+        }
+        g_ptr_array_add(postings, posting);
+    }
+    
+    // Start from the rarest trigram and probe the longer lists
+    g_ptr_array_sort(postings, compare_posting_length);
+    GArray *smallest = g_ptr_array_index(postings, 0);
+    
+    for (guint i = 0; i < smallest->len; i++) {
+        guint id = g_array_index(smallest, guint, i);
+        gboolean everywhere = TRUE;
+        
+        for (guint p = 1; p < postings->len && everywhere; p++) {
+            GArray *other = g_ptr_array_index(postings, p);
+            guint pos = posting_lower_bound(other, id);
+            everywhere = pos < other->len && g_array_index(other, guint, pos) == id;
+        }
+        
+        if (everywhere) {
+            g_array_append_val(result, id);
+        }
+    }
+    
+    g_ptr_array_unref(postings);
+    g_array_unref(keys);
+    return result;
+}
+
+char* fr_trigram_fold(const char *text) {
+    if (!text) return g_strdup("");
+    
+    char *folded = g_utf8_casefold(text, -1);
+    char *normalized = g_utf8_normalize(folded, -1, G_NORMALIZE_ALL);
+    g_free(folded);
+    
+    return normalized ? normalized : g_strdup("");
+}
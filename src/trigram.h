@@ -0,0 +1,28 @@
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+
+#include <glib.h>
+
+// Inverted index from byte trigrams to the ids of the documents containing
+// them. Documents are indexed in folded form (see fr_trigram_fold), so a
+// query narrows to candidates that contain every trigram of the folded query;
+// callers still verify each candidate with a substring test.
+typedef struct {
+    GHashTable *postings;   // packed trigram -> GArray of guint ids, ascending
+} FRTrigramIndex;
+
+FRTrigramIndex* fr_trigram_index_new(void);
+void fr_trigram_index_free(FRTrigramIndex *index);
+void fr_trigram_index_clear(FRTrigramIndex *index);
+
+void fr_trigram_index_add(FRTrigramIndex *index, guint id, const char *folded_text);
+void fr_trigram_index_remove(FRTrigramIndex *index, guint id, const char *folded_text);
+
+// Returns candidate ids in ascending order, or NULL when the pattern is too
+// short to narrow anything down and every document is a candidate.
+GArray* fr_trigram_index_query(FRTrigramIndex *index, const char *folded_pattern);
+
+// Case-folds and normalizes text for indexing and querying
+char* fr_trigram_fold(const char *text);
+
+#endif // TRIGRAM_H
@@ -0,0 +1,119 @@
+#include "uiupdate.h"
+
+static gboolean on_ui_updater_tick(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data) {
+    FRUiUpdater *updater = (FRUiUpdater*)user_data;
+    updater->tick_id = 0;
+    
+    // Flushing may queue more, which goes to the next frame
+    GHashTable *dirty = updater->dirty;
+    updater->dirty = g_hash_table_new(NULL, NULL);
+    
+    GHashTableIter iter;
+    gpointer tab, updates;
+    g_hash_table_iter_init(&iter, dirty);
+    while (g_hash_table_iter_next(&iter, &tab, &updates)) {
+        updater->flush((FRTab*)tab, (FRUiUpdate)GPOINTER_TO_UINT(updates), updater->user_data);
+    }
+    g_hash_table_destroy(dirty);
+    
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean on_ui_updater_hidden(gpointer user_data) {
+    FRUiUpdater *updater = (FRUiUpdater*)user_data;
+    updater->hidden_source = 0;
+    
+    GHashTable *hidden = updater->hidden;
+    updater->hidden = g_hash_table_new(NULL, NULL);
+    
+    GHashTableIter iter;
+    gpointer tab;
+    g_hash_table_iter_init(&iter, hidden);
+    while (g_hash_table_iter_next(&iter, &tab, NULL)) {
+        updater->flush((FRTab*)tab, FR_UI_UPDATE_LABEL, updater->user_data);
+    }
+    g_hash_table_destroy(hidden);
+    
+    return G_SOURCE_REMOVE;
+}
+
+// Tick callbacks go with the widget, and the tabs with the window
+static void on_ui_updater_widget_destroy(GtkWidget *widget, gpointer user_data) {
+    FRUiUpdater *updater = (FRUiUpdater*)user_data;
+    
+    updater->widget = NULL;
+    updater->tick_id = 0;
+    if (updater->hidden_source) {
+        g_source_remove(updater->hidden_source);
+        updater->hidden_source = 0;
+    }
+    g_hash_table_remove_all(updater->dirty);
+    g_hash_table_remove_all(updater->hidden);
+}
+
+FRUiUpdater* fr_ui_updater_new(GtkWidget *widget, FRTabModel *tabs, FRUiFlushFunc flush,
+                               gpointer user_data) {
+    if (!widget || !tabs || !flush) return NULL;
+    
+    FRUiUpdater *updater = g_malloc0(sizeof(FRUiUpdater));
+    updater->widget = widget;
+    updater->tabs = tabs;
+    updater->dirty = g_hash_table_new(NULL, NULL);
+    updater->hidden = g_hash_table_new(NULL, NULL);
+    updater->flush = flush;
+    updater->user_data = user_data;
+    
+    g_signal_connect(widget, "destroy", G_CALLBACK(on_ui_updater_widget_destroy), updater);
+    return updater;
+}
+
+void fr_ui_updater_free(FRUiUpdater *updater) {
+    if (!updater) return;
+    
+    if (updater->widget) {
+        if (updater->tick_id) {
+            gtk_widget_remove_tick_callback(updater->widget, updater->tick_id);
+        }
+        g_signal_handlers_disconnect_by_data(updater->widget, updater);
+    }
+    if (updater->hidden_source) {
+        g_source_remove(updater->hidden_source);
+    }
+    
+    g_hash_table_destroy(updater->dirty);
+    g_hash_table_destroy(updater->hidden);
+    g_free(updater);
+}
+
+void fr_ui_updater_queue(FRUiUpdater *updater, FRTab *tab, FRUiUpdate updates) {
+    if (!updater || !tab || !updater->widget) return;
+    
+    if (tab != updater->tabs->current) {
+        if (!(updates & FR_UI_UPDATE_LABEL)) return;
+        
+        g_hash_table_add(updater->hidden, tab);
+        if (!updater->hidden_source) {
+            updater->hidden_source = g_timeout_add(FR_UI_HIDDEN_LABEL_INTERVAL_MS, on_ui_updater_hidden, updater);
+        }
+        return;
+    }
+    
+    // A tab that was just selected should not wait for the timer
+    if (g_hash_table_remove(updater->hidden, tab)) {
+        updates |= FR_UI_UPDATE_LABEL;
+    }
+    
+    updates |= GPOINTER_TO_UINT(g_hash_table_lookup(updater->dirty, tab));
+    g_hash_table_insert(updater->dirty, tab, GUINT_TO_POINTER(updates));
+    
+    if (!updater->tick_id) {
+        updater->tick_id = gtk_widget_add_tick_callback(updater->widget, on_ui_updater_tick, updater, NULL);
+    }
+}
+
+void fr_ui_updater_forget(FRUiUpdater *updater, FRTab *tab) {
+    if (!updater || !tab) return;
+    
+    g_hash_table_remove(updater->dirty, tab);
+    g_hash_table_remove(updater->hidden, tab);
+}
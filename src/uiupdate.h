@@ -0,0 +1,43 @@
+#ifndef UIUPDATE_H
+#define UIUPDATE_H
+
+#include <gtk/gtk.h>
+#include "tabs.h"
+
+// Hidden tabs relabel at most this often, in milliseconds
+#define FR_UI_HIDDEN_LABEL_INTERVAL_MS 1000
+
+typedef enum {
+    FR_UI_UPDATE_LABEL = 1 << 0,        // title on the tab
+    FR_UI_UPDATE_TOOLBAR = 1 << 1,      // address and back/forward buttons
+    FR_UI_UPDATE_WINDOW_TITLE = 1 << 2
+} FRUiUpdate;
+
+typedef void (*FRUiFlushFunc)(FRTab *tab, FRUiUpdate updates, gpointer user_data);
+
+// Gathers what web view signals changed and applies it at most once per
+// frame, on the frame clock of the window, however often pages fire. The
+// toolbar and window title only follow the selected tab, so changes to
+// other tabs never touch them; labels of tabs that are not shown are
+// updated at most every FR_UI_HIDDEN_LABEL_INTERVAL_MS.
+typedef struct {
+    GtkWidget *widget;          // whose frame clock paces updates
+    FRTabModel *tabs;
+    GHashTable *dirty;          // FRTab* -> FRUiUpdate, for the next frame
+    GHashTable *hidden;         // FRTab* whose label waits for the timer
+    guint tick_id;
+    guint hidden_source;
+    FRUiFlushFunc flush;
+    gpointer user_data;
+} FRUiUpdater;
+
+FRUiUpdater* fr_ui_updater_new(GtkWidget *widget, FRTabModel *tabs, FRUiFlushFunc flush,
+                               gpointer user_data);
+void fr_ui_updater_free(FRUiUpdater *updater);
+
+// Asks for updates of tab at the next frame
+void fr_ui_updater_queue(FRUiUpdater *updater, FRTab *tab, FRUiUpdate updates);
+// Drops what is pending for a tab that is closing
+void fr_ui_updater_forget(FRUiUpdater *updater, FRTab *tab);
+
+#endif // UIUPDATE_H
@@ -119,18 +119,33 @@ void on_url_entry_activate(GtkEntry *entry, gpointer user_data) {
     fr_browser_navigate_to(browser, url);
 }
 
+// Refreshes the cached navigation state, which only changes as the view navigates
+static void tab_update_navigation(FRTab *tab) {
+    tab->can_go_back = webkit_web_view_can_go_back(tab->web_view);
+    tab->can_go_forward = webkit_web_view_can_go_forward(tab->web_view);
+}
+
 void on_load_changed(WebKitWebView *web_view, WebKitLoadEvent load_event, gpointer user_data) {
     FRBrowser *browser = (FRBrowser*)user_data;
+    FRTab *tab = fr_tab_model_lookup_view(browser->tabs, web_view);
+    if (!tab) return;
     
     switch (load_event) {
         case WEBKIT_LOAD_STARTED:
-            // Show loading indicator
+            fr_tab_set_loading(tab, TRUE);
             break;
         case WEBKIT_LOAD_COMMITTED:
-            fr_browser_update_ui(browser);
+            tab_update_navigation(tab);
+            fr_session_tab_changed(browser->session, tab);
+            fr_ui_updater_queue(browser->ui_updater, tab, FR_UI_UPDATE_TOOLBAR);
             break;
         case WEBKIT_LOAD_FINISHED:
-            fr_browser_update_ui(browser);
+            // Also reached after a failed load, which frees the loader slot as well
+            fr_tab_set_loading(tab, FALSE);
+            fr_tab_loader_finished(browser->tab_loader, tab);
+            fr_history_manager_add(browser->history_manager, tab->title, tab->url);
+            fr_thumbnail_cache_capture(browser->thumbnails, tab, NULL, NULL);
+            fr_web_context_log_processes(browser->web_context, browser->tabs);
             break;
         default:
             break;
@@ -140,46 +155,143 @@ void on_load_changed(WebKitWebView *web_view, WebKitLoadEvent load_event, gpoint
 void on_title_changed(WebKitWebView *web_view, GParamSpec *pspec, gpointer user_data) {
     FRBrowser *browser = (FRBrowser*)user_data;
     const char *title = webkit_web_view_get_title(web_view);
+    FRTab *tab = fr_tab_model_lookup_view(browser->tabs, web_view);
     
-    if (title) {
-        // Find the tab containing this web view and update its label
-        int n_pages = gtk_notebook_get_n_pages(GTK_NOTEBOOK(browser->notebook));
-        for (int i = 0; i < n_pages; i++) {
-            GtkWidget *page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(browser->notebook), i);
-            WebKitWebView *page_web_view = WEBKIT_WEB_VIEW(gtk_bin_get_child(GTK_BIN(page)));
-            
-            if (page_web_view == web_view) {
-                GtkWidget *tab_label_widget = gtk_notebook_get_tab_label(GTK_NOTEBOOK(browser->notebook), page);
-                GList *children = gtk_container_get_children(GTK_CONTAINER(tab_label_widget));
-                if (children && children->data) {
-                    GtkLabel *label = GTK_LABEL(children->data);
-                    
-                    // Truncate long titles
-                    char *short_title = g_strndup(title, 20);
-                    if (strlen(title) > 20) {
-                        strcat(short_title, "...");
-                    }
-                    
-                    gtk_label_set_text(label, short_title);
-                    g_free(short_title);
-                }
-                g_list_free(children);
-                break;
-            }
-        }
-        
-        // Update window title if this is the current tab
-        if (gtk_notebook_get_current_page(GTK_NOTEBOOK(browser->notebook)) == 
-            gtk_notebook_page_num(GTK_NOTEBOOK(browser->notebook), 
-                                 gtk_widget_get_parent(GTK_WIDGET(web_view)))) {
-            fr_window_update_title(browser, title);
-        }
-    }
+    if (!title || !tab || g_strcmp0(title, tab->title) == 0) return;
+    
+    // Pages that animate their title fire this many times a second. The
+    // title lives in the session index; the page state did not change.
+    fr_tab_set_title(tab, title);
+    fr_session_index_changed(browser->session);
+    fr_ui_updater_queue(browser->ui_updater, tab, FR_UI_UPDATE_LABEL | FR_UI_UPDATE_WINDOW_TITLE);
 }
 
 void on_uri_changed(WebKitWebView *web_view, GParamSpec *pspec, gpointer user_data) {
     FRBrowser *browser = (FRBrowser*)user_data;
+    FRTab *tab = fr_tab_model_lookup_view(browser->tabs, web_view);
+    const char *uri = webkit_web_view_get_uri(web_view);
+    if (!tab || !uri) return;
+    
+    // Same-document navigations change the uri without a new load
+    fr_tab_set_url(tab, uri);
+    tab_update_navigation(tab);
+    fr_ui_updater_queue(browser->ui_updater, tab, FR_UI_UPDATE_TOOLBAR);
+}
+
+void on_favicon_changed(WebKitWebView *web_view, GParamSpec *pspec, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    FRTab *tab = fr_tab_model_lookup_view(browser->tabs, web_view);
+    
+    if (!tab || !tab->tab_icon || !tab->url) return;
+    const char *uri = tab->url;
+    
+    // The view's icon is scaled once here and reused by menus and suggestions;
+    // while a page loads it has none yet, so show the one from its last visit
+    GtkImage *icon = GTK_IMAGE(tab->tab_icon);
+    cairo_surface_t *surface = webkit_web_view_get_favicon(web_view);
+    if (surface) {
+        g_object_set_data_full(G_OBJECT(icon), "favicon-url", g_strdup(uri), g_free);
+        gtk_image_set_from_pixbuf(icon, fr_favicon_cache_set_surface(browser->favicons, uri, surface));
+    } else {
+        fr_favicon_cache_set_image(browser->favicons, icon, uri);
+    }
+}
+
+void on_web_process_terminated(WebKitWebView *web_view, WebKitWebProcessTerminationReason reason,
+                               gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    FRTab *tab = fr_tab_model_lookup_view(browser->tabs, web_view);
+    if (!tab) return;
+    
+    // Every tab sharing the process gets this, which shows how they were grouped
+    g_warning("Web process of tab %u (%s) %s", tab->id, tab->url ? tab->url : "",
+              reason == WEBKIT_WEB_PROCESS_EXCEEDED_MEMORY_LIMIT ? "exceeded its memory limit" : "crashed");
+    
+    // No finished load is coming, so give up the loader slot here
+    fr_tab_set_loading(tab, FALSE);
+    fr_tab_loader_finished(browser->tab_loader, tab);
+    fr_web_context_log_processes(browser->web_context, browser->tabs);
+}
+
+GtkWidget* on_web_view_create(WebKitWebView *web_view, WebKitNavigationAction *navigation_action,
+                              gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    WebKitURIRequest *request = webkit_navigation_action_get_request(navigation_action);
+    
+    return GTK_WIDGET(fr_browser_open_popup(browser, web_view, webkit_uri_request_get_uri(request)));
+}
+
+// window.close() from the page
+void on_web_view_close(WebKitWebView *web_view, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    FRTab *tab = fr_tab_model_lookup_view(browser->tabs, web_view);
+    if (!tab) return;
+    
+    fr_browser_close_tab(browser, gtk_notebook_page_num(GTK_NOTEBOOK(browser->notebook), tab->page));
+}
+
+void on_notebook_switch_page(GtkNotebook *notebook, GtkWidget *page, guint page_num,
+                             gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    FRTab *tab = fr_tab_get(page);
+    gint64 now = g_get_monotonic_time();
+    
+    // Idle time, which decides what gets discarded first, counts from leaving a
+    // tab. It is still mapped here, so its thumbnail shows what was on screen.
+    if (browser->tabs->current && browser->tabs->current != tab) {
+        browser->tabs->current->last_active = now;
+        fr_thumbnail_cache_capture(browser->thumbnails, browser->tabs->current, NULL, NULL);
+    }
+    if (tab) {
+        tab->last_active = now;
+    }
+    
+    browser->tabs->current = tab;
+    
+    // A placeholder becomes a real page the first time it is looked at
+    fr_tab_loader_request(browser->tab_loader, tab, FR_TAB_PRIORITY_FOREGROUND);
     fr_browser_update_ui(browser);
+    fr_window_update_title(browser, tab ? tab->title : NULL);
+    
+    // Its label may still be waiting for the hidden tab timer
+    fr_ui_updater_queue(browser->ui_updater, tab, FR_UI_UPDATE_LABEL);
+}
+
+gboolean on_tab_query_tooltip(GtkWidget *widget, int x, int y, gboolean keyboard_mode,
+                              GtkTooltip *tooltip, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    FRTab *tab = fr_tab_get(GTK_WIDGET(g_object_get_data(G_OBJECT(widget), "page-widget")));
+    if (!tab) return FALSE;
+    
+    // Called on every pointer motion, so one preview is kept and only refilled
+    if (!browser->tab_preview) {
+        GtkWidget *image = gtk_image_new();
+        GtkWidget *label = gtk_label_new(NULL);
+        browser->tab_preview = g_object_ref_sink(gtk_box_new(GTK_ORIENTATION_VERTICAL, 4));
+        gtk_box_pack_start(GTK_BOX(browser->tab_preview), image, FALSE, FALSE, 0);
+        gtk_box_pack_start(GTK_BOX(browser->tab_preview), label, FALSE, FALSE, 0);
+        gtk_widget_show_all(browser->tab_preview);
+        g_object_set_data(G_OBJECT(browser->tab_preview), "image", image);
+        g_object_set_data(G_OBJECT(browser->tab_preview), "label", label);
+    }
+    
+    GtkImage *image = GTK_IMAGE(g_object_get_data(G_OBJECT(browser->tab_preview), "image"));
+    GtkLabel *label = GTK_LABEL(g_object_get_data(G_OBJECT(browser->tab_preview), "label"));
+    
+    // The image holds a reference, so a matching pointer is the same thumbnail
+    cairo_surface_t *thumbnail = fr_thumbnail_cache_lookup(browser->thumbnails, tab->id);
+    if (g_object_get_data(G_OBJECT(image), "thumbnail") != thumbnail) {
+        gtk_image_set_from_surface(image, thumbnail);
+        g_object_set_data(G_OBJECT(image), "thumbnail", thumbnail);
+        gtk_widget_set_visible(GTK_WIDGET(image), thumbnail != NULL);
+    }
+    const char *text = tab->title ? tab->title : tab->url;
+    if (g_strcmp0(gtk_label_get_text(label), text) != 0) {
+        gtk_label_set_text(label, text);
+    }
+    
+    gtk_tooltip_set_custom(tooltip, browser->tab_preview);
+    return TRUE;
 }
 
 void on_tab_close_clicked(GtkButton *button, gpointer user_data) {
@@ -24,6 +24,16 @@ void on_url_entry_activate(GtkEntry *entry, gpointer user_data);
 void on_load_changed(WebKitWebView *web_view, WebKitLoadEvent load_event, gpointer user_data);
 void on_title_changed(WebKitWebView *web_view, GParamSpec *pspec, gpointer user_data);
 void on_uri_changed(WebKitWebView *web_view, GParamSpec *pspec, gpointer user_data);
+void on_favicon_changed(WebKitWebView *web_view, GParamSpec *pspec, gpointer user_data);
+void on_web_process_terminated(WebKitWebView *web_view, WebKitWebProcessTerminationReason reason,
+                               gpointer user_data);
+GtkWidget* on_web_view_create(WebKitWebView *web_view, WebKitNavigationAction *navigation_action,
+                              gpointer user_data);
+void on_web_view_close(WebKitWebView *web_view, gpointer user_data);
+void on_notebook_switch_page(GtkNotebook *notebook, GtkWidget *page, guint page_num,
+                             gpointer user_data);
+gboolean on_tab_query_tooltip(GtkWidget *widget, int x, int y, gboolean keyboard_mode,
+                              GtkTooltip *tooltip, gpointer user_data);
 void on_tab_close_clicked(GtkButton *button, gpointer user_data);
 void on_new_tab_clicked(GtkButton *button, gpointer user_data);
 
@@ -0,0 +1,91 @@
+#include "viewpool.h"
+#include "webcontext.h"
+
+// Scans /proc, so it runs once per refill rather than once per spare. The
+// spares of one refill would not show up in it anyway: a new view's process
+// is still starting when the next idle call comes.
+static gboolean web_view_pool_over_limit(FRWebViewPool *pool) {
+    if (pool->memory_limit_mb == 0) return FALSE;
+    return fr_web_context_get_memory_usage() / (1024 * 1024) >= pool->memory_limit_mb;
+}
+
+// Adds one spare per idle call so the main loop is never held up for long
+static gboolean on_web_view_pool_refill(gpointer user_data) {
+    FRWebViewPool *pool = (FRWebViewPool*)user_data;
+    
+    if (pool->spare.length >= pool->size) {
+        pool->refill_source = 0;
+        return G_SOURCE_REMOVE;
+    }
+    
+    GtkWidget *web_view = webkit_web_view_new_with_context(pool->context);
+    g_queue_push_tail(&pool->spare, g_object_ref_sink(web_view));
+    return G_SOURCE_CONTINUE;
+}
+
+static void web_view_pool_schedule_refill(FRWebViewPool *pool) {
+    if (pool->refill_source || pool->spare.length >= pool->size) return;
+    if (web_view_pool_over_limit(pool)) return;
+    
+    pool->refill_source = g_idle_add_full(G_PRIORITY_LOW, on_web_view_pool_refill, pool, NULL);
+}
+
+static void on_web_view_pool_low_memory(GMemoryMonitor *monitor, GMemoryMonitorWarningLevel level,
+                                        gpointer user_data) {
+    fr_web_view_pool_drain((FRWebViewPool*)user_data);
+}
+
+FRWebViewPool* fr_web_view_pool_new(WebKitWebContext *context, guint size, guint memory_limit_mb) {
+    if (!context) return NULL;
+    
+    FRWebViewPool *pool = g_malloc0(sizeof(FRWebViewPool));
+    pool->context = context;
+    g_queue_init(&pool->spare);
+    pool->size = size;
+    pool->memory_limit_mb = memory_limit_mb;
+    pool->monitor = g_memory_monitor_dup_default();
+    pool->warning_handler = g_signal_connect(pool->monitor, "low-memory-warning",
+                                             G_CALLBACK(on_web_view_pool_low_memory), pool);
+    
+    web_view_pool_schedule_refill(pool);
+    return pool;
+}
+
+void fr_web_view_pool_drain(FRWebViewPool *pool) {
+    if (!pool) return;
+    
+    if (pool->refill_source) {
+        g_source_remove(pool->refill_source);
+        pool->refill_source = 0;
+    }
+    
+    GtkWidget *web_view;
+    while ((web_view = g_queue_pop_head(&pool->spare)) != NULL) {
+        gtk_widget_destroy(web_view);
+        g_object_unref(web_view);
+    }
+}
+
+void fr_web_view_pool_free(FRWebViewPool *pool) {
+    if (!pool) return;
+    
+    fr_web_view_pool_drain(pool);
+    g_signal_handler_disconnect(pool->monitor, pool->warning_handler);
+    g_object_unref(pool->monitor);
+    g_free(pool);
+}
+
+WebKitWebView* fr_web_view_pool_take(FRWebViewPool *pool) {
+    if (!pool) return NULL;
+    
+    WebKitWebView *web_view = g_queue_pop_head(&pool->spare);
+    if (web_view) {
+        // Our reference becomes the floating one a new view would have
+        g_object_force_floating(G_OBJECT(web_view));
+    } else {
+        web_view = WEBKIT_WEB_VIEW(webkit_web_view_new_with_context(pool->context));
+    }
+    
+    web_view_pool_schedule_refill(pool);
+    return web_view;
+}
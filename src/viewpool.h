@@ -0,0 +1,32 @@
+#ifndef VIEWPOOL_H
+#define VIEWPOOL_H
+
+#include <gtk/gtk.h>
+#include <webkit2/webkit2.h>
+
+// Spare web views kept ready so a tab does not wait for a web process to
+// start. Creating a view in the context is what launches its process, so a
+// spare has loaded nothing and can still take a restored back/forward list.
+// Spares are made again from idle time after each one is used, and dropped
+// when the system is short of memory or our web processes use more than
+// memory_limit_mb.
+typedef struct {
+    WebKitWebContext *context;
+    GQueue spare;               // WebKitWebView*, one reference each
+    guint size;
+    guint memory_limit_mb;      // 0: no limit
+    guint refill_source;
+    GMemoryMonitor *monitor;
+    gulong warning_handler;
+} FRWebViewPool;
+
+FRWebViewPool* fr_web_view_pool_new(WebKitWebContext *context, guint size, guint memory_limit_mb);
+void fr_web_view_pool_free(FRWebViewPool *pool);
+
+// A spare view if one is ready, or else a new one; floating, like
+// webkit_web_view_new()
+WebKitWebView* fr_web_view_pool_take(FRWebViewPool *pool);
+// Destroys the spares; they come back at the next take
+void fr_web_view_pool_drain(FRWebViewPool *pool);
+
+#endif // VIEWPOOL_H
@@ -0,0 +1,191 @@
+#include "webcontext.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static WebKitWebsiteDataManager* web_context_data_manager_new(void) {
+    char *data_home = g_build_filename(g_get_user_data_dir(), "fr-browser", NULL);
+    char *cache_dir = fr_browser_get_cache_dir();
+    char *cache_home = g_build_filename(cache_dir, "web", NULL);
+    
+    WebKitWebsiteDataManager *manager = webkit_website_data_manager_new("base-data-directory", data_home,
+                                                                       "base-cache-directory", cache_home,
+                                                                       NULL);
+    
+    // Cookies are only kept in memory unless given a file
+    fr_browser_ensure_directory(data_home);
+    char *cookie_file = g_build_filename(data_home, "cookies.sqlite", NULL);
+    webkit_cookie_manager_set_persistent_storage(webkit_website_data_manager_get_cookie_manager(manager),
+                                                 cookie_file, WEBKIT_COOKIE_PERSISTENT_STORAGE_SQLITE);
+    
+    g_free(cookie_file);
+    g_free(cache_home);
+    g_free(cache_dir);
+    g_free(data_home);
+    return manager;
+}
+
+WebKitWebContext* fr_web_context_new(FRSettings *settings) {
+    if (!settings) return NULL;
+    
+    // Has to be set before any context exists
+    if (settings->web_process_memory_limit_mb > 0) {
+        WebKitMemoryPressureSettings *pressure = webkit_memory_pressure_settings_new();
+        webkit_memory_pressure_settings_set_memory_limit(pressure, settings->web_process_memory_limit_mb);
+        webkit_web_context_set_memory_pressure_settings(pressure);
+        webkit_memory_pressure_settings_free(pressure);
+    }
+    
+    WebKitWebsiteDataManager *manager = web_context_data_manager_new();
+    WebKitWebContext *context = webkit_web_context_new_with_website_data_manager(manager);
+    g_object_unref(manager);
+    
+    webkit_web_context_set_cache_model(context, WEBKIT_CACHE_MODEL_WEB_BROWSER);
+    
+    // The favicon database can only be enabled before the first web view exists
+    char *cache_dir = fr_browser_get_cache_dir();
+    char *favicon_dir = g_build_filename(cache_dir, "favicons", NULL);
+    fr_browser_ensure_directory(favicon_dir);
+    webkit_web_context_set_favicon_database_directory(context, favicon_dir);
+    g_free(favicon_dir);
+    g_free(cache_dir);
+    
+    // Both are no-ops from WebKit 2.26 on, which always isolates tabs
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    webkit_web_context_set_process_model(context, settings->shared_web_process
+                                                  ? WEBKIT_PROCESS_MODEL_SHARED_SECONDARY_PROCESS
+                                                  : WEBKIT_PROCESS_MODEL_MULTIPLE_SECONDARY_PROCESSES);
+    if (!settings->shared_web_process && settings->web_process_limit > 0) {
+        webkit_web_context_set_web_process_count_limit(context, settings->web_process_limit);
+    }
+    G_GNUC_END_IGNORE_DEPRECATIONS
+    
+    return context;
+}
+
+// Web processes are our children, or grandchildren when sandboxed
+static gboolean web_context_is_ours(GHashTable *parents, pid_t pid) {
+    pid_t self = getpid();
+    
+    for (int depth = 0; depth < 3 && pid > 1; depth++) {
+        pid = GPOINTER_TO_INT(g_hash_table_lookup(parents, GINT_TO_POINTER(pid)));
+        if (pid == self) return TRUE;
+    }
+    return FALSE;
+}
+
+// Fills parents (pid -> ppid) for every process and web_processes with the
+// ones running WebKit's web process
+static void web_context_scan_processes(GHashTable *parents, GArray *web_processes) {
+    GDir *dir = g_dir_open("/proc", 0, NULL);
+    if (!dir) return;
+    
+    const char *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (!g_ascii_isdigit(name[0])) continue;
+        
+        char *path = g_build_filename("/proc", name, "stat", NULL);
+        char *contents = NULL;
+        if (g_file_get_contents(path, &contents, NULL, NULL)) {
+            // pid (comm) state ppid ...; comm may itself hold spaces and parentheses
+            char *open = strchr(contents, '(');
+            char *close = strrchr(contents, ')');
+            int ppid = 0;
+            if (open && close && close > open && sscanf(close + 1, " %*c %d", &ppid) == 1) {
+                pid_t pid = (pid_t)atoi(name);
+                g_hash_table_insert(parents, GINT_TO_POINTER(pid), GINT_TO_POINTER(ppid));
+                
+                *close = '\0';
+                if (g_str_has_prefix(open + 1, "WebKitWebProces")) {
+                    g_array_append_val(web_processes, pid);
+                }
+            }
+        }
+        g_free(contents);
+        g_free(path);
+    }
+    g_dir_close(dir);
+}
+
+static gsize web_context_process_rss(pid_t pid) {
+    char *path = g_strdup_printf("/proc/%d/statm", (int)pid);
+    char *contents = NULL;
+    unsigned long pages = 0;
+    
+    if (g_file_get_contents(path, &contents, NULL, NULL)) {
+        sscanf(contents, "%*lu %lu", &pages);
+    }
+    g_free(contents);
+    g_free(path);
+    
+    return (gsize)pages * (gsize)sysconf(_SC_PAGESIZE);
+}
+
+gsize fr_web_context_get_memory_usage(void) {
+    GHashTable *parents = g_hash_table_new(NULL, NULL);
+    GArray *web_processes = g_array_new(FALSE, FALSE, sizeof(pid_t));
+    web_context_scan_processes(parents, web_processes);
+    
+    gsize total_rss = 0;
+    for (guint i = 0; i < web_processes->len; i++) {
+        pid_t pid = g_array_index(web_processes, pid_t, i);
+        if (web_context_is_ours(parents, pid)) {
+            total_rss += web_context_process_rss(pid);
+        }
+    }
+    
+    g_array_unref(web_processes);
+    g_hash_table_destroy(parents);
+    return total_rss;
+}
+
+void fr_web_context_log_processes(WebKitWebContext *context, FRTabModel *tabs) {
+    if (!context || !tabs) return;
+    
+    // Reading /proc is only worth it when someone is looking
+    if (g_log_writer_default_would_drop(G_LOG_LEVEL_DEBUG, G_LOG_DOMAIN)) return;
+    
+    GHashTable *parents = g_hash_table_new(NULL, NULL);
+    GArray *web_processes = g_array_new(FALSE, FALSE, sizeof(pid_t));
+    web_context_scan_processes(parents, web_processes);
+    
+    guint views = 0;
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, tabs->tabs);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        FRTab *tab = (FRTab*)value;
+        if (!tab->web_view) continue;
+        
+        // Page ids are unique per view, not per process
+        views++;
+        g_debug("Tab %u: page %" G_GUINT64_FORMAT ", %s", tab->id,
+                webkit_web_view_get_page_id(tab->web_view), tab->url ? tab->url : "");
+    }
+    
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    WebKitProcessModel model = webkit_web_context_get_process_model(context);
+    guint limit = webkit_web_context_get_web_process_count_limit(context);
+    G_GNUC_END_IGNORE_DEPRECATIONS
+    
+    guint ours = 0;
+    gsize total_rss = 0;
+    for (guint i = 0; i < web_processes->len; i++) {
+        pid_t pid = g_array_index(web_processes, pid_t, i);
+        if (!web_context_is_ours(parents, pid)) continue;
+        
+        gsize rss = web_context_process_rss(pid);
+        g_debug("Web process %d: %" G_GSIZE_FORMAT " KiB", (int)pid, rss / 1024);
+        total_rss += rss;
+        ours++;
+    }
+    
+    g_debug("%u of %u tabs have a web view, in %u web processes using %" G_GSIZE_FORMAT " MiB "
+            "(%s model, limit %u)", views, fr_tab_model_get_count(tabs), ours, total_rss / (1024 * 1024),
+            model == WEBKIT_PROCESS_MODEL_SHARED_SECONDARY_PROCESS ? "shared" : "multiple", limit);
+    
+    g_array_unref(web_processes);
+    g_hash_table_destroy(parents);
+}
@@ -0,0 +1,26 @@
+#ifndef WEBCONTEXT_H
+#define WEBCONTEXT_H
+
+#include <gtk/gtk.h>
+#include <webkit2/webkit2.h>
+#include "settings.h"
+#include "tabs.h"
+
+// The one web context every tab is created in. Website data, favicons
+// included, lives under the browser's own data and cache directories, and the
+// [web] settings choose between one web process for all tabs (least memory)
+// and a process per tab, optionally capped (more isolation, a crash takes
+// down fewer tabs). Newer WebKit always runs a process per tab and ignores
+// both; the per-process memory limit is what still trades footprint there.
+WebKitWebContext* fr_web_context_new(FRSettings *settings);
+
+// Resident memory of all our web processes together, in bytes
+gsize fr_web_context_get_memory_usage(void);
+// Logs at debug level the tabs that have a web view and, separately, each of
+// our web processes with its resident memory, then the totals; set
+// G_MESSAGES_DEBUG=all to see it. WebKitGTK does not tell the UI process
+// which web process renders a given view, so tabs are not matched to
+// processes; only the counts and totals can be compared.
+void fr_web_context_log_processes(WebKitWebContext *context, FRTabModel *tabs);
+
+#endif // WEBCONTEXT_H
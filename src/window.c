@@ -1,6 +1,8 @@
 #include "window.h"
 #include "bookmarks.h"
 #include "history.h"
+#include "historymodel.h"
+#include "import.h"
 #include <string.h>
 
 void fr_window_setup_menu(FRBrowser *browser) {
@@ -16,22 +18,38 @@ void fr_window_setup_menu(FRBrowser *browser) {
     
     GtkWidget *new_tab_item = gtk_menu_item_new_with_label("New Tab");
     GtkWidget *close_tab_item = gtk_menu_item_new_with_label("Close Tab");
+    GtkWidget *reopen_tab_item = gtk_menu_item_new_with_label("Reopen Closed Tab");
+    GtkWidget *tab_overview_item = gtk_menu_item_new_with_label("Tab Overview");
     GtkWidget *quit_item = gtk_menu_item_new_with_label("Quit");
     
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), new_tab_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), gtk_separator_menu_item_new());
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), close_tab_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), reopen_tab_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), tab_overview_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), gtk_separator_menu_item_new());
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), quit_item);
     
+    GtkAccelGroup *accel_group = gtk_accel_group_new();
+    gtk_window_add_accel_group(GTK_WINDOW(browser->main_window), accel_group);
+    gtk_widget_add_accelerator(reopen_tab_item, "activate", accel_group, GDK_KEY_t,
+                               GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+    gtk_widget_add_accelerator(tab_overview_item, "activate", accel_group, GDK_KEY_e,
+                               GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+    g_object_unref(accel_group);
+    
     // Bookmarks menu
     GtkWidget *bookmarks_item = gtk_menu_item_new_with_label("Bookmarks");
     browser->bookmarks_menu = gtk_menu_new();
     gtk_menu_item_set_submenu(GTK_MENU_ITEM(bookmarks_item), browser->bookmarks_menu);
     
     GtkWidget *add_bookmark_item = gtk_menu_item_new_with_label("Add Bookmark");
+    GtkWidget *import_bookmarks_item = gtk_menu_item_new_with_label("Import Bookmarks...");
     gtk_menu_shell_append(GTK_MENU_SHELL(browser->bookmarks_menu), add_bookmark_item);
+    gtk_menu_shell_append(GTK_MENU_SHELL(browser->bookmarks_menu), import_bookmarks_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(browser->bookmarks_menu), gtk_separator_menu_item_new());
+    fr_bookmark_menu_attach(browser->bookmarks_menu, browser->bookmark_manager, browser->favicons,
+                            G_CALLBACK(on_menu_bookmarks), browser);
     
     // History menu
     GtkWidget *history_item = gtk_menu_item_new_with_label("History");
@@ -41,6 +59,8 @@ void fr_window_setup_menu(FRBrowser *browser) {
     GtkWidget *show_history_item = gtk_menu_item_new_with_label("Show All History");
     gtk_menu_shell_append(GTK_MENU_SHELL(browser->history_menu), show_history_item);
     gtk_menu_shell_append(GTK_MENU_SHELL(browser->history_menu), gtk_separator_menu_item_new());
+    fr_history_menu_attach(browser->history_menu, browser->history_manager, browser->favicons,
+                           G_CALLBACK(on_menu_history_item), browser);
     
     // Help menu
     GtkWidget *help_menu = gtk_menu_new();
@@ -59,8 +79,11 @@ void fr_window_setup_menu(FRBrowser *browser) {
     // Connect signals
     g_signal_connect(new_tab_item, "activate", G_CALLBACK(on_menu_new_tab), browser);
     g_signal_connect(close_tab_item, "activate", G_CALLBACK(on_menu_close_tab), browser);
+    g_signal_connect(reopen_tab_item, "activate", G_CALLBACK(on_menu_reopen_closed_tab), browser);
+    g_signal_connect(tab_overview_item, "activate", G_CALLBACK(on_menu_tab_overview), browser);
     g_signal_connect(quit_item, "activate", G_CALLBACK(on_menu_quit), browser);
     g_signal_connect(add_bookmark_item, "activate", G_CALLBACK(on_menu_add_bookmark), browser);
+    g_signal_connect(import_bookmarks_item, "activate", G_CALLBACK(on_menu_import_bookmarks), browser);
     g_signal_connect(show_history_item, "activate", G_CALLBACK(on_menu_history), browser);
     g_signal_connect(about_item, "activate", G_CALLBACK(on_menu_about), browser);
     
@@ -94,11 +117,22 @@ void on_menu_new_tab(GtkMenuItem *item, gpointer user_data) {
 
 void on_menu_close_tab(GtkMenuItem *item, gpointer user_data) {
     FRBrowser *browser = (FRBrowser*)user_data;
-    if (browser->current_tab >= 0) {
-        fr_browser_close_tab(browser, browser->current_tab);
+    FRTab *tab = browser->tabs->current;
+    if (tab) {
+        fr_browser_close_tab(browser, gtk_notebook_page_num(GTK_NOTEBOOK(browser->notebook), tab->page));
     }
 }
 
+void on_menu_reopen_closed_tab(GtkMenuItem *item, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    fr_browser_reopen_closed_tab(browser);
+}
+
+void on_menu_tab_overview(GtkMenuItem *item, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    fr_tab_overview_show(browser->tab_overview, GTK_WINDOW(browser->main_window));
+}
+
 void on_menu_quit(GtkMenuItem *item, gpointer user_data) {
     FRBrowser *browser = (FRBrowser*)user_data;
     if (browser->main_window) {
@@ -158,30 +192,45 @@ void on_menu_about(GtkMenuItem *item, gpointer user_data) {
 void on_menu_bookmarks(GtkMenuItem *item, gpointer user_data) {
     // This will be called when bookmark menu items are clicked
     FRBrowser *browser = (FRBrowser*)user_data;
+    FRBookmarkFolder *folder = (FRBookmarkFolder*)g_object_get_data(G_OBJECT(item), "bookmark-folder");
+    if (folder) {
+        // Background tabs load a few at a time through the tab loader
+        for (GList *l = folder->bookmarks.head; l != NULL; l = l->next) {
+            FRBookmark *bookmark = (FRBookmark*)l->data;
+            fr_browser_add_background_tab(browser, 0, bookmark->url, bookmark->title, TRUE);
+        }
+        return;
+    }
+    
     const char *url = (const char*)g_object_get_data(G_OBJECT(item), "bookmark-url");
     if (url) {
         fr_browser_navigate_to(browser, url);
     }
 }
 
+void on_menu_history_item(GtkMenuItem *item, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    const char *url = (const char*)g_object_get_data(G_OBJECT(item), "history-url");
+    if (url) {
+        fr_browser_navigate_to(browser, url);
+    }
+}
+
 void on_menu_history(GtkMenuItem *item, gpointer user_data) {
     FRBrowser *browser = (FRBrowser*)user_data;
-    // Show history dialog - this would need a history manager instance
-    // fr_history_show_dialog(GTK_WINDOW(browser->main_window), browser->history_manager);
+    fr_history_show_dialog(GTK_WINDOW(browser->main_window), browser->history_manager);
 }
 
 void on_menu_add_bookmark(GtkMenuItem *item, gpointer user_data) {
     FRBrowser *browser = (FRBrowser*)user_data;
+    FRTab *tab = browser->tabs->current;
     
-    if (browser->current_tab < 0) return;
+    if (!tab) return;
     
-    GtkWidget *current_page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(browser->notebook), browser->current_tab);
-    if (current_page) {
-        WebKitWebView *web_view = WEBKIT_WEB_VIEW(gtk_bin_get_child(GTK_BIN(current_page)));
-        const char *url = webkit_web_view_get_uri(web_view);
-        const char *title = webkit_web_view_get_title(web_view);
-        
-        // Show bookmark dialog - this would need a bookmark manager instance
-        // fr_bookmark_show_dialog(GTK_WINDOW(browser->main_window), browser->bookmark_manager, url, title);
-    }
+    fr_bookmark_show_dialog(GTK_WINDOW(browser->main_window), browser->bookmark_manager, tab->url, tab->title);
+}
+
+void on_menu_import_bookmarks(GtkMenuItem *item, gpointer user_data) {
+    FRBrowser *browser = (FRBrowser*)user_data;
+    fr_bookmark_import_show_dialog(GTK_WINDOW(browser->main_window), browser->bookmark_manager);
 }
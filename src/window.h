@@ -13,10 +13,14 @@ void fr_window_update_title(FRBrowser *browser, const char *title);
 // Menu callbacks
 void on_menu_new_tab(GtkMenuItem *item, gpointer user_data);
 void on_menu_close_tab(GtkMenuItem *item, gpointer user_data);
+void on_menu_reopen_closed_tab(GtkMenuItem *item, gpointer user_data);
+void on_menu_tab_overview(GtkMenuItem *item, gpointer user_data);
 void on_menu_quit(GtkMenuItem *item, gpointer user_data);
 void on_menu_about(GtkMenuItem *item, gpointer user_data);
 void on_menu_bookmarks(GtkMenuItem *item, gpointer user_data);
 void on_menu_history(GtkMenuItem *item, gpointer user_data);
+void on_menu_history_item(GtkMenuItem *item, gpointer user_data);
 void on_menu_add_bookmark(GtkMenuItem *item, gpointer user_data);
+void on_menu_import_bookmarks(GtkMenuItem *item, gpointer user_data);
 
 #endif // WINDOW_H